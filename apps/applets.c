@@ -6,19 +6,46 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+// enable the GNU extensions, e.g. `cpu_set_t`
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <libgen.h>
 #include <string.h>
 #include <stdbool.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <regex.h>
+#include <time.h>
 #include <sys/utsname.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+
+#include "lib/boottrace.h"
+#include "lib/checksum.h"
+#include "lib/ioengine.h"
+#include "lib/schedutil.h"
+#include "lib/swar.h"
 
 void print_usage(void)
 {
     char *text =
         "Available applets:\n"
-        "    tee, tr, uname\n"
+        "    tee, tr, uname, bootchart, cgstat, taskset, chrt, ionice, wc, grep,\n"
+        "    sort, xargs, dd, sha256sum, crc32c, xxh64\n"
         "\n"
         "Usage:\n"
         "    applets applet_name args0 args1 ...\n"
@@ -29,6 +56,22 @@ void print_usage(void)
         "    applets tr [:upper:] [:lower:]\n"
         "    applets tr [:blank:] _\n"
         "    applets uname [OPTION]...\n"
+        "    applets bootchart [-r] [/path/to/boottrace]\n"
+        "    applets cgstat [cgroup_name]...\n"
+        "    applets taskset [-c] mask|list command [args]...\n"
+        "    applets taskset -p [-c] [mask|list] pid\n"
+        "    applets chrt [-f|-r|-o|-b|-i] priority command [args]...\n"
+        "    applets chrt [-f|-r|-o|-b|-i] -p [priority] pid\n"
+        "    applets ionice [-c class] [-n level] command [args]...\n"
+        "    applets ionice [-c class] [-n level] -p pid\n"
+        "    applets wc [-l] [-w] [-m] [-c] [file]...\n"
+        "    applets grep [-F] [-i] [-v] [-n] [-c|-l] pattern [file]...\n"
+        "    applets sort [-n] [-r] [-u] [-t char] [-k start[,end]] [-S size] [-T dir] [file]...\n"
+        "    applets xargs [-0] [-n max_args|-L max_lines|-I replace] [-P jobs] [-g] [-r] [command [args]...]\n"
+        "    applets dd [if=file] [of=file] [bs=size] [count=n] [skip=n] [seek=n] [mode=rw|mmap|copy]\n"
+        "    applets sha256sum [-c [-q|-s]] [-v] [file]...\n"
+        "    applets crc32c [-c [-q|-s]] [-v] [file]...\n"
+        "    applets xxh64 [-c [-q|-s]] [-v] [file]...\n"
         "\n"
         "You can call the applet by link name by creating a link. e.g.\n"
         "\n"
@@ -47,52 +90,43 @@ void print_usage(void)
  */
 int command_tee(char *filepath)
 {
-    FILE *file = NULL;
+    int out_fds[2] = {STDOUT_FILENO, -1};
+    int out_count = 1;
 
     if (filepath != NULL)
     {
-        file = fopen(filepath, "w");
-        if (file == NULL)
+        out_fds[1] = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (out_fds[1] == -1)
         {
-            perror("fopen");
+            perror("open");
             return EXIT_FAILURE;
         }
+        out_count = 2;
     }
 
-    const int BUF_SIZE = 4096;
-    char buf[BUF_SIZE];
-
-    size_t bytes_read;
-
-    while ((bytes_read = fread(buf, 1, BUF_SIZE, stdin)) > 0)
+    struct IoEngine engine;
+    if (!ioengine_init(&engine, 0, 0))
     {
-        // write to stdout
-        fwrite(buf, 1, bytes_read, stdout);
-
-        // write to the specified file
-        if (file != NULL)
-        {
-            size_t bytes_write = fwrite(buf, 1, bytes_read, file);
-            if (bytes_write < bytes_read)
-            {
-                perror("fwrite");
-                fclose(file);
-                return EXIT_FAILURE;
-            }
-        }
+        perror("ioengine_init");
+        return EXIT_FAILURE;
+    }
 
-        if (feof(stdin) != 0)
-        {
-            // Ctrl+D is pressed.
-            break;
-        }
+    // the stdin is read until Ctrl+D is pressed (or the end of the pipe)
+    int error_number = ioengine_copy(&engine, STDIN_FILENO, out_fds, out_count, NULL, NULL);
+    if (error_number != 0)
+    {
+        fprintf(stderr, "tee: %s: %s\n",
+                engine.error_fd == STDIN_FILENO ? "stdin" : (engine.error_fd == STDOUT_FILENO ? "stdout" : filepath),
+                strerror(error_number));
     }
 
-    if (file != NULL)
+    ioengine_destroy(&engine);
+
+    if (filepath != NULL)
     {
-        fclose(file);
+        close(out_fds[1]);
     }
-    return EXIT_SUCCESS;
+    return (error_number == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 bool is_valid_pattern(char *pattern)
@@ -133,6 +167,16 @@ char convert_to(char *pattern, char ch)
     exit(EXIT_FAILURE);
 }
 
+size_t translate_block(void *context, unsigned char *data, size_t length)
+{
+    const unsigned char *table = context;
+    for (size_t idx = 0; idx < length; idx++)
+    {
+        data[idx] = table[data[idx]];
+    }
+    return length;
+}
+
 /**
  * @brief Find and replace string
  *
@@ -158,30 +202,32 @@ int command_tr(char *find, char *replace)
         return EXIT_FAILURE;
     }
 
-    char ch;
-    while ((ch = getchar()) != EOF)
+    // the patterns are compiled to a table, then the blocks are translated
+    // by looking up the table.
+    unsigned char table[256];
+    for (int ch = 0; ch < 256; ch++)
     {
-        char result;
-
-        if (is_match_pattern(find, ch))
-        {
-            result = convert_to(replace, ch);
-        }
-        else
-        {
-            result = ch;
-        }
+        table[ch] = is_match_pattern(find, ch) ? convert_to(replace, ch) : ch;
+    }
 
-        putchar(result);
+    struct IoEngine engine;
+    if (!ioengine_init(&engine, 0, 0))
+    {
+        perror("ioengine_init");
+        return EXIT_FAILURE;
+    }
 
-        // fix QEMU terminate buffer
-        if (feof(stdin) != 0)
-        {
-            break;
-        }
+    int out_fd = STDOUT_FILENO;
+    int error_number = ioengine_copy(&engine, STDIN_FILENO, &out_fd, 1, translate_block, table);
+    if (error_number != 0)
+    {
+        fprintf(stderr, "tr: %s: %s\n",
+                engine.error_fd == STDIN_FILENO ? "stdin" : "stdout",
+                strerror(error_number));
     }
 
-    return EXIT_SUCCESS;
+    ioengine_destroy(&engine);
+    return (error_number == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 void print_uname_usage(void)
@@ -345,83 +391,5081 @@ int command_uname(int argc, char **argv)
     return EXIT_SUCCESS;
 }
 
-int main(int argc, char **argv)
+#define MAX_CHART_SERVICES 64
+#define CHART_WIDTH 40
+
+struct ChartService
 {
-    char *filepath = argv[0];
-    char *command = basename(filepath);
+    char name[BOOTTRACE_NAME_LENGTH];
+    uint64_t fork_ns; // 0 for not occurred
+    uint64_t exec_ns;
+    uint64_t ready_ns;
+    uint64_t exit_ns;
+    bool is_failed;
+};
 
-    if (strcmp(command, "applets") == 0)
+void print_ms(uint64_t ns)
+{
+    if (ns == 0)
     {
-        if (argc == 1)
+        printf(" %10s", "-");
+    }
+    else
+    {
+        printf(" %10.3f", ns / 1e6);
+    }
+}
+
+int get_chart_column(uint64_t ns, uint64_t start_ns, uint64_t span_ns)
+{
+    int col = (ns - start_ns) * CHART_WIDTH / span_ns;
+    return col < CHART_WIDTH ? col : CHART_WIDTH - 1;
+}
+
+/**
+ * @brief Print the timeline of the boot trace which is recorded by `init`.
+ *
+ * @param filepath
+ * @param is_raw print all records instead of the chart
+ * @return int
+ */
+int command_bootchart(char *filepath, bool is_raw)
+{
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1)
+    {
+        perror("open");
+        return EXIT_FAILURE;
+    }
+
+    struct stat s;
+    if (fstat(fd, &s) == -1)
+    {
+        perror("fstat");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    if ((size_t)s.st_size < sizeof(struct BootTraceHeader))
+    {
+        fprintf(stderr, "%s is not a boot trace file.\n", filepath);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    struct BootTraceHeader *header = mmap(NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (header == MAP_FAILED)
+    {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+
+    if (memcmp(header->magic, BOOTTRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->record_size != sizeof(struct BootTraceRecord) ||
+        header->capacity == 0 ||
+        sizeof(struct BootTraceHeader) + (uint64_t)header->capacity * header->record_size > (uint64_t)s.st_size)
+    {
+        fprintf(stderr, "%s is not a boot trace file.\n", filepath);
+        munmap(header, s.st_size);
+        return EXIT_FAILURE;
+    }
+
+    // `init` may be appending records, only the published ones are read.
+    uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    uint64_t first = (count > header->capacity) ? count - header->capacity : 0;
+    struct BootTraceRecord *records = (struct BootTraceRecord *)(header + 1);
+
+    uint64_t init_ns = 0;
+    uint64_t boot_done_ns = 0;
+    uint64_t shell_ns = 0;
+    uint64_t last_ns = 0;
+
+    struct ChartService chart_services[MAX_CHART_SERVICES];
+    int number_of_chart_services = 0;
+
+    if (is_raw)
+    {
+        printf("%11s %11s %9s  %-9s %6s %6s  %s\n",
+               "boottime", "monotonic", "delta", "event", "pid", "status", "name");
+    }
+
+    for (uint64_t idx = first; idx < count; idx++)
+    {
+        struct BootTraceRecord *record = &records[idx % header->capacity];
+        uint64_t ns = record->boottime_ns;
+
+        if (is_raw)
         {
-            print_usage();
-            return EXIT_FAILURE;
+            // the times are in milliseconds
+            printf("%11.3f %11.3f %9.3f  %-9s %6d %6d  %.*s\n",
+                   ns / 1e6,
+                   record->monotonic_ns / 1e6,
+                   (last_ns == 0 ? 0 : ns - last_ns) / 1e6,
+                   boottrace_event_name(record->event),
+                   record->pid,
+                   record->status,
+                   BOOTTRACE_NAME_LENGTH, record->name);
+            last_ns = ns;
+            continue;
         }
 
-        // convert:
-        //
-        // argv[0] argv[1] argv[2] argv[3]
-        // applets command arg0    arg1
-        //
-        //    |
-        //    to
-        //    V
-        //
-        // argv[0]  argv[1] argv[2]
-        // command  arg0    arg1
+        last_ns = ns;
 
-        argv++;
-        argc--;
-        command = argv[0];
+        if (record->event == BOOTTRACE_INIT)
+        {
+            init_ns = ns;
+            continue;
+        }
+        else if (record->event == BOOTTRACE_BOOT_DONE)
+        {
+            boot_done_ns = ns;
+            continue;
+        }
+        else if (record->event == BOOTTRACE_SHELL && shell_ns == 0)
+        {
+            shell_ns = ns;
+        }
+
+        struct ChartService *service = NULL;
+        for (int i = 0; i < number_of_chart_services; i++)
+        {
+            if (strncmp(chart_services[i].name, record->name, BOOTTRACE_NAME_LENGTH) == 0)
+            {
+                service = &chart_services[i];
+                break;
+            }
+        }
+
+        if (service == NULL)
+        {
+            if (number_of_chart_services == MAX_CHART_SERVICES)
+            {
+                continue;
+            }
+
+            service = &chart_services[number_of_chart_services];
+            number_of_chart_services++;
+
+            memset(service, 0, sizeof(*service));
+            memcpy(service->name, record->name, BOOTTRACE_NAME_LENGTH);
+            service->name[BOOTTRACE_NAME_LENGTH - 1] = '\0';
+        }
+
+        // only the first start of a service is charted, the
+        // respawned ones are listed by the raw mode.
+        switch (record->event)
+        {
+        case BOOTTRACE_FORK:
+            if (service->fork_ns == 0)
+            {
+                service->fork_ns = ns;
+            }
+            break;
+        case BOOTTRACE_EXEC:
+            if (service->exec_ns == 0)
+            {
+                service->exec_ns = ns;
+            }
+            break;
+        case BOOTTRACE_READY:
+            if (service->ready_ns == 0)
+            {
+                service->ready_ns = ns;
+            }
+            break;
+        case BOOTTRACE_EXIT:
+            if (service->exit_ns == 0)
+            {
+                service->exit_ns = ns;
+            }
+            break;
+        case BOOTTRACE_FAIL:
+            service->is_failed = true;
+            break;
+        }
     }
 
-    if (strcmp(command, "tee") == 0)
+    munmap(header, s.st_size);
+
+    if (is_raw)
     {
-        if (argc > 2)
+        return EXIT_SUCCESS;
+    }
+
+    // the times are in milliseconds since the kernel booted
+    printf("init  %10.3f ms\n", init_ns / 1e6);
+    if (boot_done_ns != 0)
+    {
+        printf("done  %10.3f ms (+%.3f ms)\n", boot_done_ns / 1e6, (boot_done_ns - init_ns) / 1e6);
+    }
+    if (shell_ns != 0)
+    {
+        printf("shell %10.3f ms (+%.3f ms)\n", shell_ns / 1e6, (shell_ns - init_ns) / 1e6);
+    }
+    printf("\n");
+
+    // chart:
+    // '=' from fork to ready, '-' from ready to exit, 'x' marks failure.
+    uint64_t span_ns = (last_ns > init_ns) ? last_ns - init_ns : 1;
+
+    printf("%-16s %10s %10s %10s %10s  |%.3f ms .. %.3f ms\n",
+           "service", "fork", "exec", "ready", "exit", init_ns / 1e6, last_ns / 1e6);
+
+    for (int i = 0; i < number_of_chart_services; i++)
+    {
+        struct ChartService *service = &chart_services[i];
+        printf("%-16s", service->name);
+        print_ms(service->fork_ns);
+        print_ms(service->exec_ns);
+        print_ms(service->ready_ns);
+        print_ms(service->exit_ns);
+
+        char bar[CHART_WIDTH + 1];
+        memset(bar, ' ', CHART_WIDTH);
+        bar[CHART_WIDTH] = '\0';
+
+        if (service->fork_ns != 0)
         {
-            fputs("Usage:\n", stderr);
-            fputs("    applets tee\n", stderr);
-            fputs("    applets tee /path/to/name\n", stderr);
-            fputs("or\n", stderr);
-            fputs("    tee\n", stderr);
-            fputs("    tee /path/to/name\n", stderr);
-            return EXIT_FAILURE;
+            uint64_t ready_ns = service->ready_ns != 0 ? service->ready_ns : last_ns;
+            uint64_t exit_ns = service->exit_ns != 0 ? service->exit_ns : last_ns;
+
+            int start_col = get_chart_column(service->fork_ns, init_ns, span_ns);
+            int ready_col = get_chart_column(ready_ns, init_ns, span_ns);
+            int exit_col = get_chart_column(exit_ns, init_ns, span_ns);
+
+            for (int col = start_col; col <= exit_col; col++)
+            {
+                bar[col] = (col == start_col || col < ready_col) ? '=' : '-';
+            }
+
+            if (service->is_failed)
+            {
+                bar[exit_col] = 'x';
+            }
+        }
+        else if (service->is_failed)
+        {
+            bar[0] = 'x';
         }
 
-        // usage:
-        //
-        // tee
-        // tee filename
-        return command_tee(argv[1]);
+        printf("  |%s|\n", bar);
     }
-    else if (strcmp(command, "tr") == 0)
+
+    return EXIT_SUCCESS;
+}
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+/**
+ * @brief Read the value of the key from a "flat keyed" cgroup file, e.g. `cpu.stat`.
+ *
+ * @param filepath
+ * @param key
+ * @param value
+ * @return bool false if the file or the key does not exist
+ */
+bool read_cgroup_key(const char *filepath, const char *key, unsigned long long *value)
+{
+    FILE *file = fopen(filepath, "r");
+    if (file == NULL)
     {
-        if (argc != 3)
+        return false;
+    }
+
+    char name[64];
+    unsigned long long number;
+    bool is_found = false;
+
+    while (fscanf(file, "%63s %llu", name, &number) == 2)
+    {
+        if (strcmp(name, key) == 0)
         {
+            *value = number;
+            is_found = true;
+            break;
+        }
+    }
 
-            fputs("Usages:\n", stderr);
-            fputs("    applets tr [:upper:] [:lower:]\n", stderr);
-            fputs("    applets tr [:blank:] _\n", stderr);
-            fputs("or\n", stderr);
-            fputs("    tr [:upper:] [:lower:]\n", stderr);
-            fputs("    tr [:blank:] _\n", stderr);
-            return EXIT_FAILURE;
+    fclose(file);
+    return is_found;
+}
+
+/**
+ * @brief Read the value of a "single value" cgroup file, e.g. `memory.peak`.
+ *
+ * @param filepath
+ * @param value
+ * @return bool false if the file does not exist, or the value is not a number (e.g. "max").
+ */
+bool read_cgroup_value(const char *filepath, unsigned long long *value)
+{
+    FILE *file = fopen(filepath, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    bool is_number = fscanf(file, "%llu", value) == 1;
+    fclose(file);
+    return is_number;
+}
+
+void print_cgroup_number(unsigned long long value, bool is_valid, double divisor)
+{
+    if (is_valid && divisor == 1)
+    {
+        printf(" %12llu", value);
+    }
+    else if (is_valid)
+    {
+        printf(" %12.1f", value / divisor);
+    }
+    else
+    {
+        printf(" %12s", "-");
+    }
+}
+
+void print_cgroup_stat(char *name)
+{
+    char filepath[1024];
+    unsigned long long value;
+    bool is_valid;
+
+    printf("%-16s", name);
+
+    // the times of `cpu.stat` are in microseconds
+    snprintf(filepath, sizeof(filepath), "%s/%s/cpu.stat", CGROUP_ROOT, name);
+    is_valid = read_cgroup_key(filepath, "usage_usec", &value);
+    print_cgroup_number(value, is_valid, 1000);
+    is_valid = read_cgroup_key(filepath, "user_usec", &value);
+    print_cgroup_number(value, is_valid, 1000);
+    is_valid = read_cgroup_key(filepath, "system_usec", &value);
+    print_cgroup_number(value, is_valid, 1000);
+    is_valid = read_cgroup_key(filepath, "nr_throttled", &value);
+    print_cgroup_number(value, is_valid, 1);
+    is_valid = read_cgroup_key(filepath, "throttled_usec", &value);
+    print_cgroup_number(value, is_valid, 1000);
+
+    // the memory sizes are in bytes
+    snprintf(filepath, sizeof(filepath), "%s/%s/memory.current", CGROUP_ROOT, name);
+    is_valid = read_cgroup_value(filepath, &value);
+    print_cgroup_number(value, is_valid, 1024);
+
+    snprintf(filepath, sizeof(filepath), "%s/%s/memory.peak", CGROUP_ROOT, name);
+    is_valid = read_cgroup_value(filepath, &value);
+    print_cgroup_number(value, is_valid, 1024);
+
+    snprintf(filepath, sizeof(filepath), "%s/%s/memory.max", CGROUP_ROOT, name);
+    is_valid = read_cgroup_value(filepath, &value);
+    print_cgroup_number(value, is_valid, 1024);
+
+    printf("\n");
+}
+
+int compare_strings(const void *left, const void *right)
+{
+    return strcmp(*(char *const *)left, *(char *const *)right);
+}
+
+/**
+ * @brief Print the CPU and memory usage of the cgroups of services.
+ *
+ * @param argc
+ * @param argv the names of cgroups, all child cgroups of the root cgroup are printed if omitted.
+ * @return int
+ */
+int command_cgstat(int argc, char **argv)
+{
+    printf("%-16s %12s %12s %12s %12s %12s %12s %12s %12s\n",
+           "cgroup", "cpu(ms)", "user(ms)", "sys(ms)", "throttled",
+           "thr(ms)", "mem(KiB)", "peak(KiB)", "max(KiB)");
+
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            print_cgroup_stat(argv[i]);
         }
 
-        // usage:
-        //
-        // tr pattern1 pattern2
-        return command_tr(argv[1], argv[2]);
+        return EXIT_SUCCESS;
     }
-    else if (strcmp(command, "uname") == 0)
+
+    DIR *dir = opendir(CGROUP_ROOT);
+    if (dir == NULL)
     {
-        // usage:
-        //
-        // uname
-        // uname -a[-s,-n,-r,-v,-m]
-        // uname --all[--kernel-name,--nodename,--kernel-release,--kernel-version,--machine]
-        // uname --help[--version]
-        return command_uname(argc, argv);
+        perror("opendir");
+        return EXIT_FAILURE;
+    }
+
+    const int MAX_CGROUPS = 256;
+    char *names[MAX_CGROUPS];
+    int count = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL && count < MAX_CGROUPS)
+    {
+        if (entry->d_type == DT_DIR && entry->d_name[0] != '.')
+        {
+            names[count] = strdup(entry->d_name);
+            count++;
+        }
+    }
+
+    closedir(dir);
+
+    qsort(names, count, sizeof(char *), compare_strings);
+
+    for (int i = 0; i < count; i++)
+    {
+        print_cgroup_stat(names[i]);
+        free(names[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Parse the process id, the text must be a non-negative decimal number.
+ *
+ * @param text
+ * @param pid
+ * @return bool
+ */
+bool parse_pid(const char *text, pid_t *pid)
+{
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0)
+    {
+        fprintf(stderr, "invalid pid: %s\n", text);
+        return false;
+    }
+
+    *pid = value;
+    return true;
+}
+
+/**
+ * @brief Execute the command with the current attributes,
+ * it returns only when error occurred.
+ *
+ * @param argv
+ * @return int
+ */
+int execute_command(char **argv)
+{
+    execvp(argv[0], argv);
+
+    // `perror` may change `errno`
+    int error_number = errno;
+    perror("execvp");
+
+    // the same exit code as the shell uses for the command not found
+    return (error_number == ENOENT) ? 127 : 126;
+}
+
+void print_cpu_mask(const cpu_set_t *set)
+{
+    // find the highest CPU to omit the leading zero digits
+    int highest = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, set))
+        {
+            highest = cpu;
+        }
+    }
+
+    for (int digit_idx = highest / 4; digit_idx >= 0; digit_idx--)
+    {
+        int digit = 0;
+        for (int bit = 0; bit < 4; bit++)
+        {
+            if (CPU_ISSET(digit_idx * 4 + bit, set))
+            {
+                digit |= (1 << bit);
+            }
+        }
+
+        putchar("0123456789abcdef"[digit]);
+    }
+}
+
+void print_affinity(pid_t pid, bool is_list, char *state)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(pid, sizeof(set), &set) != 0)
+    {
+        perror("sched_getaffinity");
+        return;
+    }
+
+    if (is_list)
+    {
+        char buf[1024];
+        format_cpu_list(&set, buf, sizeof(buf));
+        printf("pid %d's %s affinity list: %s\n", pid, state, buf);
+    }
+    else
+    {
+        printf("pid %d's %s affinity mask: ", pid, state);
+        print_cpu_mask(&set);
+        putchar('\n');
+    }
+}
+
+/**
+ * @brief Show or set the CPU affinity of a process, or execute a command
+ * with the specified CPU affinity.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_taskset(int argc, char **argv)
+{
+    bool is_pid = false;
+    bool is_list = false;
+
+    // "+" stops at the first non-option argument, so that the options
+    // of the command are not parsed.
+    int opt;
+    while ((opt = getopt(argc, argv, "+pc")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            is_pid = true;
+            break;
+        case 'c':
+            is_list = true;
+            break;
+        default:
+            return EXIT_FAILURE;
+        }
+    }
+
+    int remain = argc - optind;
+    char **args = argv + optind;
+
+    if (is_pid && remain == 1)
+    {
+        // show the affinity only
+        pid_t pid;
+        if (!parse_pid(args[0], &pid))
+        {
+            return EXIT_FAILURE;
+        }
+
+        print_affinity(pid, is_list, "current");
+        return EXIT_SUCCESS;
+    }
+
+    if ((is_pid && remain != 2) || (!is_pid && remain < 2))
+    {
+        fputs("Usage:\n", stderr);
+        fputs("    taskset [-c] mask|list command [args]...\n", stderr);
+        fputs("    taskset -p [-c] [mask|list] pid\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    cpu_set_t set;
+    bool is_valid = is_list ? parse_cpu_list(args[0], &set) : parse_cpu_mask(args[0], &set);
+    if (!is_valid)
+    {
+        fprintf(stderr, "invalid cpu %s: %s\n", is_list ? "list" : "mask", args[0]);
+        return EXIT_FAILURE;
+    }
+
+    pid_t pid = 0;
+    if (is_pid)
+    {
+        if (!parse_pid(args[1], &pid))
+        {
+            return EXIT_FAILURE;
+        }
+
+        print_affinity(pid, is_list, "current");
+    }
+
+    if (sched_setaffinity(pid, sizeof(set), &set) != 0)
+    {
+        perror("sched_setaffinity");
+        return EXIT_FAILURE;
+    }
+
+    if (is_pid)
+    {
+        print_affinity(pid, is_list, "new");
+        return EXIT_SUCCESS;
+    }
+
+    return execute_command(args + 1);
+}
+
+void print_scheduler(pid_t pid)
+{
+    int policy = sched_getscheduler(pid);
+    if (policy == -1)
+    {
+        perror("sched_getscheduler");
+        return;
+    }
+
+    struct sched_param param;
+    if (sched_getparam(pid, &param) != 0)
+    {
+        perror("sched_getparam");
+        return;
+    }
+
+    printf("pid %d's current scheduling policy: %s\n", pid, get_sched_policy_name(policy));
+    printf("pid %d's current scheduling priority: %d\n", pid, param.sched_priority);
+}
+
+/**
+ * @brief Show or set the scheduling policy and priority of a process, or
+ * execute a command with the specified scheduling policy and priority.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_chrt(int argc, char **argv)
+{
+    bool is_pid = false;
+    bool is_policy_specified = false;
+    int policy = SCHED_RR; // the default policy of `chrt` of util-linux
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+pfrobim")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            is_pid = true;
+            break;
+        case 'f':
+            policy = SCHED_FIFO;
+            is_policy_specified = true;
+            break;
+        case 'r':
+            policy = SCHED_RR;
+            is_policy_specified = true;
+            break;
+        case 'o':
+            policy = SCHED_OTHER;
+            is_policy_specified = true;
+            break;
+        case 'b':
+            policy = SCHED_BATCH;
+            is_policy_specified = true;
+            break;
+        case 'i':
+            policy = SCHED_IDLE;
+            is_policy_specified = true;
+            break;
+        case 'm':
+        {
+            // show the valid priority range of each policy
+            int policies[] = {SCHED_OTHER, SCHED_FIFO, SCHED_RR, SCHED_BATCH, SCHED_IDLE};
+            for (size_t i = 0; i < sizeof(policies) / sizeof(int); i++)
+            {
+                printf("%s min/max priority\t: %d/%d\n",
+                       get_sched_policy_name(policies[i]),
+                       sched_get_priority_min(policies[i]),
+                       sched_get_priority_max(policies[i]));
+            }
+            return EXIT_SUCCESS;
+        }
+        default:
+            return EXIT_FAILURE;
+        }
+    }
+
+    int remain = argc - optind;
+    char **args = argv + optind;
+
+    if (is_pid && remain == 1 && !is_policy_specified)
+    {
+        // show the policy only
+        pid_t pid;
+        if (!parse_pid(args[0], &pid))
+        {
+            return EXIT_FAILURE;
+        }
+
+        print_scheduler(pid);
+        return EXIT_SUCCESS;
+    }
+
+    // the priority can be omitted by `-p` for the non-realtime policies
+    int priority = 0;
+    if ((is_pid && remain == 2) || (!is_pid && remain >= 2))
+    {
+        char *end;
+        priority = strtol(args[0], &end, 10);
+        if (end == args[0] || *end != '\0')
+        {
+            fprintf(stderr, "invalid priority: %s\n", args[0]);
+            return EXIT_FAILURE;
+        }
+
+        args++;
+        remain--;
+    }
+
+    if ((is_pid && remain != 1) || (!is_pid && remain < 1))
+    {
+        fputs("Usage:\n", stderr);
+        fputs("    chrt [-f|-r|-o|-b|-i] priority command [args]...\n", stderr);
+        fputs("    chrt [-f|-r|-o|-b|-i] -p [priority] pid\n", stderr);
+        fputs("    chrt -p pid\n", stderr);
+        fputs("    chrt -m\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    pid_t pid = 0;
+    if (is_pid && !parse_pid(args[0], &pid))
+    {
+        return EXIT_FAILURE;
+    }
+
+    struct sched_param param = {.sched_priority = priority};
+    if (sched_setscheduler(pid, policy, &param) != 0)
+    {
+        perror("sched_setscheduler");
+        return EXIT_FAILURE;
+    }
+
+    if (is_pid)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    return execute_command(args);
+}
+
+void print_ioprio(pid_t pid)
+{
+    int ioprio = ioprio_get(IOPRIO_WHO_PROCESS, pid);
+    if (ioprio == -1)
+    {
+        perror("ioprio_get");
+        return;
+    }
+
+    int class = IOPRIO_PRIO_CLASS(ioprio);
+    if (class == IOPRIO_CLASS_IDLE)
+    {
+        printf("%s\n", get_ioprio_class_name(class));
+    }
+    else
+    {
+        printf("%s: prio %d\n", get_ioprio_class_name(class), IOPRIO_PRIO_DATA(ioprio));
+    }
+}
+
+/**
+ * @brief Show or set the I/O scheduling class and level of a process, or
+ * execute a command with the specified I/O scheduling class and level.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_ionice(int argc, char **argv)
+{
+    bool is_pid = false;
+    bool is_class_specified = false;
+    int class = IOPRIO_CLASS_BE;
+    int level = 4;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+pc:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            is_pid = true;
+            break;
+        case 'c':
+        {
+            // accept both the number and the name, e.g. `-c 1` and `-c rt`
+            int ioprio = isdigit((unsigned char)optarg[0]) ? IOPRIO_PRIO_VALUE(atoi(optarg), 0) : parse_ioprio(optarg);
+            class = IOPRIO_PRIO_CLASS(ioprio);
+            if (ioprio == -1 || class > IOPRIO_CLASS_IDLE)
+            {
+                fprintf(stderr, "invalid class: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            if (strchr(optarg, ':') != NULL)
+            {
+                level = IOPRIO_PRIO_DATA(ioprio);
+            }
+            is_class_specified = true;
+            break;
+        }
+        case 'n':
+            level = atoi(optarg);
+            if (level < 0 || level > 7)
+            {
+                fprintf(stderr, "invalid level: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            is_class_specified = true;
+            break;
+        default:
+            return EXIT_FAILURE;
+        }
+    }
+
+    int remain = argc - optind;
+    char **args = argv + optind;
+
+    if (remain == 0 && !is_pid)
+    {
+        // show the I/O priority of the current process
+        print_ioprio(0);
+        return EXIT_SUCCESS;
+    }
+
+    if (is_pid && remain != 1)
+    {
+        fputs("Usage:\n", stderr);
+        fputs("    ionice [-c class] [-n level] command [args]...\n", stderr);
+        fputs("    ionice [-c class] [-n level] -p pid\n", stderr);
+        fputs("    ionice -p pid\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    pid_t pid = 0;
+    if (is_pid)
+    {
+        if (!parse_pid(args[0], &pid))
+        {
+            return EXIT_FAILURE;
+        }
+
+        if (!is_class_specified)
+        {
+            print_ioprio(pid);
+            return EXIT_SUCCESS;
+        }
+    }
+
+    if (class == IOPRIO_CLASS_IDLE || class == IOPRIO_CLASS_NONE)
+    {
+        level = 0;
+    }
+
+    if (ioprio_set(IOPRIO_WHO_PROCESS, pid, IOPRIO_PRIO_VALUE(class, level)) != 0)
+    {
+        perror("ioprio_set");
+        return EXIT_FAILURE;
+    }
+
+    if (is_pid)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    return execute_command(args);
+}
+
+// the block size of reading the pipes and the other non-mmap-able files
+#define READ_BLOCK_SIZE (256 * 1024)
+
+struct WordCount
+{
+    uint64_t lines;
+    uint64_t words;
+    uint64_t chars; // the UTF-8 characters
+    uint64_t bytes;
+};
+
+// the selected counts of `wc`
+bool is_count_lines = false;
+bool is_count_words = false;
+bool is_count_chars = false;
+bool is_count_bytes = false;
+
+/**
+ * @brief Count the newlines of a block, it is the fast path of `wc -l`.
+ *
+ * @param data
+ * @param length
+ * @return uint64_t
+ */
+uint64_t count_newlines(const unsigned char *data, size_t length)
+{
+    const uint64_t newline = swar_broadcast('\n');
+    uint64_t lines = 0;
+    size_t idx = 0;
+
+    // each round adds up to 4 to a per-byte counter, so they are summed
+    // every 63 rounds (4 * 63 = 252) before they overflow
+    while (idx + 32 <= length)
+    {
+        uint64_t counters = 0;
+        for (int round = 0; round < 63 && idx + 32 <= length; round++, idx += 32)
+        {
+            counters += swar_equal_bytes(swar_load(data + idx), newline) >> 7;
+            counters += swar_equal_bytes(swar_load(data + idx + 8), newline) >> 7;
+            counters += swar_equal_bytes(swar_load(data + idx + 16), newline) >> 7;
+            counters += swar_equal_bytes(swar_load(data + idx + 24), newline) >> 7;
+        }
+
+        // each counter is at most 252, sum the pairs as 16-bit
+        uint64_t pairs = (counters & 0x00ff00ff00ff00ffULL) + ((counters >> 8) & 0x00ff00ff00ff00ffULL);
+        lines += (pairs * 0x0001000100010001ULL) >> 48;
+    }
+
+    for (; idx < length; idx++)
+    {
+        lines += (data[idx] == '\n');
+    }
+
+    return lines;
+}
+
+/**
+ * @brief Count the lines, words and UTF-8 characters of a block, 8 bytes
+ * at a time.
+ *
+ * a word is a run of non-space bytes, i.e. the words are counted by the
+ * non-space bytes which follow a space byte (or the start of the input).
+ *
+ * @param data
+ * @param length
+ * @param count
+ * @param is_in_word the state between blocks, true if the last byte of the
+ * previous block is not a space
+ */
+void count_block(const unsigned char *data, size_t length, struct WordCount *count, bool *is_in_word)
+{
+    if (!is_count_words && !is_count_chars)
+    {
+        count->lines += count_newlines(data, length);
+        count->bytes += length;
+        return;
+    }
+
+    const uint64_t newline = swar_broadcast('\n');
+
+    uint64_t lines = 0;
+    uint64_t words = 0;
+    uint64_t continuations = 0;
+    uint64_t previous = *is_in_word ? 0 : 0x80; // the space mask of the previous byte
+
+    size_t idx = 0;
+    for (; idx + 8 <= length; idx += 8)
+    {
+        uint64_t word = swar_load(data + idx);
+        uint64_t spaces = swar_space_bytes(word);
+
+        // the space mask of the previous byte of each byte
+        uint64_t previous_spaces = (spaces << 8) | previous;
+        previous = spaces >> 56;
+
+        lines += swar_count(swar_equal_bytes(word, newline));
+        words += swar_count(~spaces & previous_spaces & SWAR_HIGH_BITS);
+        continuations += swar_count(swar_continuation_bytes(word));
+    }
+
+    bool is_space = (previous != 0);
+    for (; idx < length; idx++)
+    {
+        unsigned char ch = data[idx];
+        bool is_current_space = (ch == ' ' || (ch >= '\t' && ch <= '\r'));
+
+        lines += (ch == '\n');
+        words += (is_space && !is_current_space);
+        continuations += ((ch & 0xc0) == 0x80);
+        is_space = is_current_space;
+    }
+
+    *is_in_word = !is_space;
+
+    count->lines += lines;
+    count->words += words;
+    count->chars += length - continuations;
+    count->bytes += length;
+}
+
+/**
+ * @brief Count a file, the regular file is mapped into memory, the others
+ * are read by large blocks.
+ *
+ * @param fd
+ * @param count
+ * @return int 0, or the error number
+ */
+int count_file(int fd, struct WordCount *count)
+{
+    struct stat s;
+    if (fstat(fd, &s) != 0)
+    {
+        return errno;
+    }
+
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+
+    if (S_ISREG(s.st_mode) && offset >= 0)
+    {
+        if (!is_count_lines && !is_count_words && !is_count_chars)
+        {
+            // `wc -c` requires the size only.
+            // note that some files in `/proc` and `/sys` report size 0, they
+            // are read as usual.
+            if (s.st_size > 0)
+            {
+                count->bytes += (s.st_size > offset) ? s.st_size - offset : 0;
+                return 0;
+            }
+        }
+        else if (s.st_size > 0 && offset == 0)
+        {
+            void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                madvise(data, s.st_size, MADV_SEQUENTIAL);
+
+                bool is_in_word = false;
+                count_block(data, s.st_size, count, &is_in_word);
+
+                munmap(data, s.st_size);
+                return 0;
+            }
+        }
+    }
+
+    static unsigned char *buffer = NULL;
+    if (buffer == NULL)
+    {
+        buffer = malloc(READ_BLOCK_SIZE);
+        if (buffer == NULL)
+        {
+            return ENOMEM;
+        }
+    }
+
+    bool is_in_word = false;
+    while (true)
+    {
+        ssize_t nread = read(fd, buffer, READ_BLOCK_SIZE);
+        if (nread == 0)
+        {
+            break;
+        }
+
+        if (nread == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+
+        count_block(buffer, nread, count, &is_in_word);
+    }
+
+    return 0;
+}
+
+void print_word_count(const struct WordCount *count, int width, const char *name)
+{
+    const char *separator = "";
+    if (is_count_lines)
+    {
+        printf("%*llu", width, (unsigned long long)count->lines);
+        separator = " ";
+    }
+    if (is_count_words)
+    {
+        printf("%s%*llu", separator, width, (unsigned long long)count->words);
+        separator = " ";
+    }
+    if (is_count_chars)
+    {
+        printf("%s%*llu", separator, width, (unsigned long long)count->chars);
+        separator = " ";
+    }
+    if (is_count_bytes)
+    {
+        printf("%s%*llu", separator, width, (unsigned long long)count->bytes);
+    }
+
+    if (name != NULL)
+    {
+        printf(" %s", name);
+    }
+    putchar('\n');
+}
+
+/**
+ * @brief Count the lines, words, characters and bytes of the files.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_wc(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "lwmc")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            is_count_lines = true;
+            break;
+        case 'w':
+            is_count_words = true;
+            break;
+        case 'm':
+            is_count_chars = true;
+            break;
+        case 'c':
+            is_count_bytes = true;
+            break;
+        default:
+            fputs("Usage:\n", stderr);
+            fputs("    wc [-l] [-w] [-m] [-c] [file]...\n", stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!is_count_lines && !is_count_words && !is_count_chars && !is_count_bytes)
+    {
+        is_count_lines = true;
+        is_count_words = true;
+        is_count_bytes = true;
+    }
+
+    char *current[] = {"-"};
+    char **paths = (optind == argc) ? current : argv + optind;
+    int count = (optind == argc) ? 1 : argc - optind;
+
+    // the column width is the digits of the total size of the regular files,
+    // (like GNU wc) so that the columns are aligned without buffering.
+    int columns = is_count_lines + is_count_words + is_count_chars + is_count_bytes;
+    int width = 1;
+    if (columns > 1 || count > 1)
+    {
+        uint64_t total_size = 0;
+        bool is_size_unknown = false;
+        for (int idx = 0; idx < count; idx++)
+        {
+            struct stat s;
+            bool is_stdin = (strcmp(paths[idx], "-") == 0);
+            if ((is_stdin ? fstat(STDIN_FILENO, &s) : stat(paths[idx], &s)) == 0 &&
+                S_ISREG(s.st_mode))
+            {
+                total_size += s.st_size;
+            }
+            else
+            {
+                // e.g. a pipe
+                is_size_unknown = true;
+            }
+        }
+
+        while (total_size >= 10)
+        {
+            total_size /= 10;
+            width++;
+        }
+
+        if (is_size_unknown && width < 7)
+        {
+            width = 7;
+        }
+    }
+
+    int result = EXIT_SUCCESS;
+    struct WordCount total = {0};
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        bool is_stdin = (strcmp(paths[idx], "-") == 0);
+        int fd = is_stdin ? STDIN_FILENO : open(paths[idx], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "wc: %s: %s\n", paths[idx], strerror(errno));
+            result = EXIT_FAILURE;
+            continue;
+        }
+
+        struct WordCount file_count = {0};
+        int error_number = count_file(fd, &file_count);
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+
+        if (error_number != 0)
+        {
+            fprintf(stderr, "wc: %s: %s\n", paths[idx], strerror(error_number));
+            result = EXIT_FAILURE;
+        }
+
+        print_word_count(&file_count, width, (optind == argc) ? NULL : paths[idx]);
+
+        total.lines += file_count.lines;
+        total.words += file_count.words;
+        total.chars += file_count.chars;
+        total.bytes += file_count.bytes;
+    }
+
+    if (count > 1)
+    {
+        print_word_count(&total, width, "total");
+    }
+
+    return result;
+}
+
+// the size of the windows which are tested by a single `regexec`, the
+// lines of a window are matched one by one only if the window matches.
+#define REGEX_WINDOW_SIZE (64 * 1024)
+
+struct GrepPattern
+{
+    bool is_fixed;
+    regex_t regex;
+
+    // the fixed string, it is lowercase for `-i`
+    const unsigned char *text;
+    size_t length;
+
+    // the byte masks of the first and the last byte of the fixed string,
+    // both cases are included for `-i`
+    uint64_t first_bytes[2];
+    uint64_t last_bytes[2];
+};
+
+struct GrepState
+{
+    const char *name; // NULL if there is only one input
+    uint64_t line_number;
+    uint64_t selected;
+    bool is_done; // `-l` stops at the first selected line
+};
+
+bool is_grep_fixed = false;
+bool is_grep_ignore_case = false;
+bool is_grep_invert = false;
+bool is_grep_line_number = false;
+bool is_grep_count = false;
+bool is_grep_list_files = false;
+
+struct GrepPattern grep_pattern;
+
+bool is_fixed_pattern(const char *pattern)
+{
+    // the special characters of the POSIX basic regular expression
+    return strpbrk(pattern, ".[]*^$\\") == NULL;
+}
+
+bool compile_pattern(const char *pattern, struct GrepPattern *compiled)
+{
+    if (is_grep_fixed || is_fixed_pattern(pattern))
+    {
+        size_t length = strlen(pattern);
+        unsigned char *text = malloc(length + 1);
+        if (text == NULL)
+        {
+            perror("malloc");
+            return false;
+        }
+
+        for (size_t idx = 0; idx <= length; idx++)
+        {
+            unsigned char ch = pattern[idx];
+            text[idx] = is_grep_ignore_case ? tolower(ch) : ch;
+        }
+
+        compiled->is_fixed = true;
+        compiled->text = text;
+        compiled->length = length;
+
+        if (length > 0)
+        {
+            unsigned char first = text[0];
+            unsigned char last = text[length - 1];
+            compiled->first_bytes[0] = swar_broadcast(first);
+            compiled->first_bytes[1] = swar_broadcast(is_grep_ignore_case ? toupper(first) : first);
+            compiled->last_bytes[0] = swar_broadcast(last);
+            compiled->last_bytes[1] = swar_broadcast(is_grep_ignore_case ? toupper(last) : last);
+        }
+        return true;
+    }
+
+    // REG_NEWLINE: `^`, `$` and `.` never cross the line boundaries, so a
+    // window of multiple lines can be tested at once
+    int flags = REG_NOSUB | REG_NEWLINE | (is_grep_ignore_case ? REG_ICASE : 0);
+    int error_code = regcomp(&compiled->regex, pattern, flags);
+    if (error_code != 0)
+    {
+        char message[256];
+        regerror(error_code, &compiled->regex, message, sizeof(message));
+        fprintf(stderr, "grep: %s\n", message);
+        return false;
+    }
+
+    compiled->is_fixed = false;
+    return true;
+}
+
+bool is_fixed_match(const unsigned char *data)
+{
+    const unsigned char *text = grep_pattern.text;
+    size_t length = grep_pattern.length;
+
+    if (!is_grep_ignore_case)
+    {
+        return memcmp(data, text, length) == 0;
+    }
+
+    for (size_t idx = 0; idx < length; idx++)
+    {
+        if (tolower(data[idx]) != text[idx])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find the fixed string.
+ *
+ * the candidates are the positions where both the first byte and the
+ * last byte of the string match, they are tested 8 positions at a time,
+ * and only the candidates are compared.
+ *
+ * @param start
+ * @param end
+ * @return const unsigned char* the start of the match, or NULL
+ */
+const unsigned char *find_fixed(const unsigned char *start, const unsigned char *end)
+{
+    size_t length = grep_pattern.length;
+    if (length == 0)
+    {
+        return start;
+    }
+
+    if ((size_t)(end - start) < length)
+    {
+        return NULL;
+    }
+
+    if (length == 1 && !is_grep_ignore_case)
+    {
+        return memchr(start, grep_pattern.text[0], end - start);
+    }
+
+    const uint64_t *first_bytes = grep_pattern.first_bytes;
+    const uint64_t *last_bytes = grep_pattern.last_bytes;
+
+    const unsigned char *ptr = start;
+    for (; ptr + length - 1 + 8 <= end; ptr += 8)
+    {
+        uint64_t first = swar_load(ptr);
+        uint64_t last = swar_load(ptr + length - 1);
+
+        uint64_t mask = (swar_equal_bytes(first, first_bytes[0]) | swar_equal_bytes(first, first_bytes[1])) &
+                        (swar_equal_bytes(last, last_bytes[0]) | swar_equal_bytes(last, last_bytes[1]));
+
+        while (mask != 0)
+        {
+            const unsigned char *candidate = ptr + swar_first_index(mask);
+            if (is_fixed_match(candidate))
+            {
+                return candidate;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    for (; ptr + length <= end; ptr++)
+    {
+        if (is_fixed_match(ptr))
+        {
+            return ptr;
+        }
+    }
+
+    return NULL;
+}
+
+bool is_regex_match(const unsigned char *start, const unsigned char *end)
+{
+    // REG_STARTEND: the data is not NULL terminated
+    regmatch_t match = {.rm_so = 0, .rm_eo = end - start};
+    return regexec(&grep_pattern.regex, (const char *)start, 1, &match, REG_STARTEND) == 0;
+}
+
+/**
+ * @brief Find the regular expression.
+ *
+ * @param start the start of a line
+ * @param end the end of the last line, which may be empty
+ * @return const unsigned char* the start of the matched line, or NULL
+ */
+const unsigned char *find_regex(const unsigned char *start, const unsigned char *end)
+{
+    while (start <= end)
+    {
+        // a window consists of whole lines
+        const unsigned char *window_end = end;
+        if ((size_t)(end - start) > REGEX_WINDOW_SIZE)
+        {
+            window_end = memchr(start + REGEX_WINDOW_SIZE, '\n', end - start - REGEX_WINDOW_SIZE);
+            window_end = (window_end == NULL) ? end : window_end;
+        }
+
+        if (is_regex_match(start, window_end))
+        {
+            while (start <= window_end)
+            {
+                const unsigned char *line_end = memchr(start, '\n', window_end - start);
+                line_end = (line_end == NULL) ? window_end : line_end;
+
+                if (is_regex_match(start, line_end))
+                {
+                    return start;
+                }
+                start = line_end + 1;
+            }
+        }
+
+        start = window_end + 1;
+    }
+
+    return NULL;
+}
+
+void print_grep_line(struct GrepState *state, const unsigned char *start, const unsigned char *end)
+{
+    state->selected++;
+
+    if (is_grep_list_files)
+    {
+        puts(state->name != NULL ? state->name : "(standard input)");
+        state->is_done = true;
+        return;
+    }
+
+    if (is_grep_count)
+    {
+        return;
+    }
+
+    if (state->name != NULL)
+    {
+        fputs(state->name, stdout);
+        putchar(':');
+    }
+
+    if (is_grep_line_number)
+    {
+        printf("%llu:", (unsigned long long)state->line_number);
+    }
+
+    fwrite(start, 1, end - start, stdout);
+    putchar('\n');
+}
+
+/**
+ * @brief Search the lines of a block, the lines are found around the matches
+ * only, except `-v`.
+ *
+ * @param data the lines are separated by newline, i.e. there is no newline
+ * after the last line, so an empty block is an empty line
+ * @param length
+ * @param state
+ */
+void grep_block(const unsigned char *data, size_t length, struct GrepState *state)
+{
+    const unsigned char *ptr = data;
+    const unsigned char *end = data + length;
+
+    while (ptr <= end && !state->is_done)
+    {
+        const unsigned char *match = grep_pattern.is_fixed ? find_fixed(ptr, end) : find_regex(ptr, end);
+
+        const unsigned char *line_start = end;
+        const unsigned char *line_end = end;
+        if (match != NULL)
+        {
+            const unsigned char *newline = memrchr(ptr, '\n', match - ptr);
+            line_start = (newline == NULL) ? ptr : newline + 1;
+
+            line_end = memchr(match, '\n', end - match);
+            line_end = (line_end == NULL) ? end : line_end;
+        }
+
+        if (is_grep_invert)
+        {
+            // all lines before the matched line are selected, or all the
+            // remaining lines if there is no match
+            while ((ptr < line_start || (match == NULL && ptr == end)) && !state->is_done)
+            {
+                const unsigned char *next = memchr(ptr, '\n', line_start - ptr);
+                next = (next == NULL) ? line_start : next;
+
+                state->line_number++;
+                print_grep_line(state, ptr, next);
+                ptr = next + 1;
+            }
+
+            // the matched line, which is not selected
+            if (match != NULL)
+            {
+                state->line_number++;
+            }
+        }
+        else if (match != NULL)
+        {
+            if (is_grep_line_number)
+            {
+                state->line_number += count_newlines(ptr, line_start - ptr) + 1;
+            }
+            print_grep_line(state, line_start, line_end);
+        }
+        else if (is_grep_line_number)
+        {
+            // the remaining lines of the block, the next block continues
+            // with the following line
+            state->line_number += count_newlines(ptr, end - ptr) + 1;
+        }
+
+        ptr = line_end + 1;
+    }
+}
+
+/**
+ * @brief Search a file, the regular file is mapped into memory, the others
+ * are read by large blocks.
+ *
+ * @param fd
+ * @param state
+ * @return int 0, or the error number
+ */
+int grep_file(int fd, struct GrepState *state)
+{
+    struct stat s;
+    if (fstat(fd, &s) != 0)
+    {
+        return errno;
+    }
+
+    if (S_ISREG(s.st_mode) && s.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0)
+    {
+        void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, s.st_size, MADV_SEQUENTIAL);
+
+            size_t length = s.st_size;
+            if (((unsigned char *)data)[length - 1] == '\n')
+            {
+                // the last newline is not a separator
+                length--;
+            }
+
+            grep_block(data, length, state);
+            munmap(data, s.st_size);
+            return 0;
+        }
+    }
+
+    // the incomplete last line of a block is moved to the front of the
+    // buffer, the buffer grows if a line is longer than it.
+    size_t capacity = READ_BLOCK_SIZE;
+    unsigned char *buffer = malloc(capacity);
+    if (buffer == NULL)
+    {
+        return ENOMEM;
+    }
+
+    size_t length = 0;
+    int error_number = 0;
+
+    while (!state->is_done)
+    {
+        if (length == capacity)
+        {
+            unsigned char *new_buffer = realloc(buffer, capacity * 2);
+            if (new_buffer == NULL)
+            {
+                error_number = ENOMEM;
+                break;
+            }
+            buffer = new_buffer;
+            capacity *= 2;
+        }
+
+        ssize_t nread = read(fd, buffer + length, capacity - length);
+        if (nread == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            error_number = errno;
+            break;
+        }
+
+        if (nread == 0)
+        {
+            // the last line
+            if (length > 0)
+            {
+                grep_block(buffer, length, state);
+            }
+            break;
+        }
+
+        unsigned char *last_newline = memrchr(buffer + length, '\n', nread);
+        length += nread;
+
+        if (last_newline != NULL)
+        {
+            size_t complete = last_newline - buffer;
+            grep_block(buffer, complete, state);
+
+            length -= complete + 1;
+            memmove(buffer, last_newline + 1, length);
+        }
+    }
+
+    free(buffer);
+    return error_number;
+}
+
+/**
+ * @brief Print the lines which match the pattern.
+ *
+ * @param argc
+ * @param argv
+ * @return int 0 if any line is selected, 1 if none, 2 for error
+ */
+int command_grep(int argc, char **argv)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "Fivncl")) != -1)
+    {
+        switch (opt)
+        {
+        case 'F':
+            is_grep_fixed = true;
+            break;
+        case 'i':
+            is_grep_ignore_case = true;
+            break;
+        case 'v':
+            is_grep_invert = true;
+            break;
+        case 'n':
+            is_grep_line_number = true;
+            break;
+        case 'c':
+            is_grep_count = true;
+            break;
+        case 'l':
+            is_grep_list_files = true;
+            break;
+        default:
+            fputs("Usage:\n", stderr);
+            fputs("    grep [-F] [-i] [-v] [-n] [-c|-l] pattern [file]...\n", stderr);
+            return 2;
+        }
+    }
+
+    if (optind == argc)
+    {
+        fputs("Usage:\n", stderr);
+        fputs("    grep [-F] [-i] [-v] [-n] [-c|-l] pattern [file]...\n", stderr);
+        return 2;
+    }
+
+    if (!compile_pattern(argv[optind], &grep_pattern))
+    {
+        return 2;
+    }
+    optind++;
+
+    // the lines are written by many small `fwrite`
+    if (!isatty(STDOUT_FILENO))
+    {
+        setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+    }
+
+    char *current[] = {"-"};
+    char **paths = (optind == argc) ? current : argv + optind;
+    int count = (optind == argc) ? 1 : argc - optind;
+
+    bool has_error = false;
+    bool has_selected = false;
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        bool is_stdin = (strcmp(paths[idx], "-") == 0);
+        int fd = is_stdin ? STDIN_FILENO : open(paths[idx], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "grep: %s: %s\n", paths[idx], strerror(errno));
+            has_error = true;
+            continue;
+        }
+
+        struct GrepState state = {0};
+        state.name = (count > 1 || is_grep_list_files) ? (is_stdin ? "(standard input)" : paths[idx]) : NULL;
+
+        int error_number = grep_file(fd, &state);
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+
+        if (error_number != 0)
+        {
+            fprintf(stderr, "grep: %s: %s\n", paths[idx], strerror(error_number));
+            has_error = true;
+        }
+
+        if (is_grep_count && !is_grep_list_files)
+        {
+            if (count > 1)
+            {
+                printf("%s:", state.name);
+            }
+            printf("%llu\n", (unsigned long long)state.selected);
+        }
+
+        has_selected = has_selected || state.selected > 0;
+    }
+
+    fflush(stdout);
+    return has_error ? 2 : (has_selected ? 0 : 1);
+}
+
+#define SORT_MAX_THREADS 32
+#define SORT_MIN_LINES_PER_THREAD 16384
+#define SORT_MAX_MERGE_RUNS 64
+#define SORT_MIN_READER_SIZE (64 * 1024)
+
+// a line of a chunk, the chunk is an arena of the lines which are read
+// into memory, the lines are sorted by sorting the records.
+struct SortLine
+{
+    uint64_t key_prefix; // the first 8 bytes of the key, big endian, zero padded
+    size_t offset;       // the offset of the line in the text of the chunk
+    uint32_t length;     // the newline is excluded
+    uint32_t key_start;  // relative to the line
+    uint32_t key_length;
+};
+
+struct SortChunk
+{
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t parsed; // the lines before it have been added to the records
+
+    struct SortLine *lines;
+    struct SortLine *merge_lines; // the buffer of merging the sorted parts
+    size_t count;
+    size_t line_capacity;
+};
+
+// a sorted run which has been spilled to a temporary file
+struct RunReader
+{
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t start; // the start of the next line
+    size_t end;
+    bool is_eof;
+    struct SortLine line; // the current line, the offset is relative to the buffer
+};
+
+// the last written line of `sort -u`
+struct UniqueFilter
+{
+    char *text;
+    size_t capacity;
+    struct SortLine line;
+    bool has_line;
+};
+
+struct SortPart
+{
+    const char *text;
+    struct SortLine *source;
+    struct SortLine *target;
+    size_t start;
+    size_t middle; // the end of the first part when merging
+    size_t end;
+};
+
+bool is_sort_numeric = false;
+bool is_sort_reverse = false;
+bool is_sort_unique = false;
+
+// the ordering of the key, they are the global options unless the key has
+// its own modifiers, e.g. `-k 3n`
+bool has_sort_key_options = false;
+bool is_sort_key_numeric = false;
+bool is_sort_key_reverse = false;
+int sort_key_start = 0; // the field number, 0 if the key is the whole line
+int sort_key_end = 0;   // the field number, 0 if the key ends at the end of line
+int sort_separator = -1; // -1 if the fields are separated by blanks
+size_t sort_buffer_size = 0;
+const char *sort_temp_dir = "/tmp";
+int sort_threads = 1;
+
+FILE **sort_runs = NULL;
+size_t sort_run_count = 0;
+size_t sort_run_capacity = 0;
+
+size_t find_field_start(const char *line, size_t length, int field)
+{
+    size_t pos = 0;
+    for (int idx = 1; idx < field && pos < length; idx++)
+    {
+        if (sort_separator != -1)
+        {
+            const char *separator = memchr(line + pos, sort_separator, length - pos);
+            pos = (separator == NULL) ? length : (size_t)(separator - line) + 1;
+        }
+        else
+        {
+            // the leading blanks belong to the field
+            while (pos < length && (line[pos] == ' ' || line[pos] == '\t'))
+            {
+                pos++;
+            }
+            while (pos < length && line[pos] != ' ' && line[pos] != '\t')
+            {
+                pos++;
+            }
+        }
+    }
+
+    return pos;
+}
+
+size_t find_field_end(const char *line, size_t length, int field)
+{
+    size_t pos = find_field_start(line, length, field);
+
+    if (sort_separator != -1)
+    {
+        const char *separator = memchr(line + pos, sort_separator, length - pos);
+        return (separator == NULL) ? length : (size_t)(separator - line);
+    }
+
+    while (pos < length && (line[pos] == ' ' || line[pos] == '\t'))
+    {
+        pos++;
+    }
+    while (pos < length && line[pos] != ' ' && line[pos] != '\t')
+    {
+        pos++;
+    }
+    return pos;
+}
+
+void make_sort_line(const char *line, size_t length, size_t offset, struct SortLine *record)
+{
+    size_t key_start = 0;
+    size_t key_end = length;
+
+    if (sort_key_start > 0)
+    {
+        key_start = find_field_start(line, length, sort_key_start);
+        if (sort_key_end > 0)
+        {
+            key_end = find_field_end(line, length, sort_key_end);
+            key_end = (key_end < key_start) ? key_start : key_end;
+        }
+    }
+
+    const unsigned char *key = (const unsigned char *)line + key_start;
+    size_t key_length = key_end - key_start;
+
+    uint64_t prefix = 0;
+    for (size_t idx = 0; idx < 8; idx++)
+    {
+        prefix = (prefix << 8) | (idx < key_length ? key[idx] : 0);
+    }
+
+    record->key_prefix = prefix;
+    record->offset = offset;
+    record->length = length;
+    record->key_start = key_start;
+    record->key_length = key_length;
+}
+
+/**
+ * @brief Compare two numbers in text, e.g. "-12.50" and "3", the numbers
+ * are compared digit by digit, so there is no limit of the length and
+ * the precision. the text which is not a number is 0.
+ */
+int compare_numbers(const char *left, size_t left_length, const char *right, size_t right_length)
+{
+    struct
+    {
+        bool is_negative;
+        const char *integer; // without the leading zeros
+        size_t integer_length;
+        const char *fraction; // without the trailing zeros
+        size_t fraction_length;
+    } numbers[2];
+
+    const char *texts[2] = {left, right};
+    size_t lengths[2] = {left_length, right_length};
+
+    for (int side = 0; side < 2; side++)
+    {
+        const char *ptr = texts[side];
+        const char *end = ptr + lengths[side];
+
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+        {
+            ptr++;
+        }
+
+        bool is_negative = (ptr < end && *ptr == '-');
+        ptr += is_negative;
+
+        while (ptr < end && *ptr == '0')
+        {
+            ptr++;
+        }
+
+        const char *integer = ptr;
+        while (ptr < end && isdigit((unsigned char)*ptr))
+        {
+            ptr++;
+        }
+        numbers[side].integer = integer;
+        numbers[side].integer_length = ptr - integer;
+
+        numbers[side].fraction = ptr;
+        numbers[side].fraction_length = 0;
+        if (ptr < end && *ptr == '.')
+        {
+            const char *fraction = ++ptr;
+            while (ptr < end && isdigit((unsigned char)*ptr))
+            {
+                ptr++;
+            }
+            while (ptr > fraction && ptr[-1] == '0')
+            {
+                ptr--;
+            }
+            numbers[side].fraction = fraction;
+            numbers[side].fraction_length = ptr - fraction;
+        }
+
+        // "-0" is 0
+        numbers[side].is_negative = is_negative &&
+                                    (numbers[side].integer_length > 0 || numbers[side].fraction_length > 0);
+    }
+
+    if (numbers[0].is_negative != numbers[1].is_negative)
+    {
+        return numbers[0].is_negative ? -1 : 1;
+    }
+
+    int sign = numbers[0].is_negative ? -1 : 1;
+
+    if (numbers[0].integer_length != numbers[1].integer_length)
+    {
+        return (numbers[0].integer_length < numbers[1].integer_length) ? -sign : sign;
+    }
+
+    int result = memcmp(numbers[0].integer, numbers[1].integer, numbers[0].integer_length);
+    if (result != 0)
+    {
+        return (result < 0) ? -sign : sign;
+    }
+
+    size_t common = (numbers[0].fraction_length < numbers[1].fraction_length) ? numbers[0].fraction_length : numbers[1].fraction_length;
+    result = memcmp(numbers[0].fraction, numbers[1].fraction, common);
+    if (result != 0)
+    {
+        return (result < 0) ? -sign : sign;
+    }
+
+    if (numbers[0].fraction_length != numbers[1].fraction_length)
+    {
+        return (numbers[0].fraction_length < numbers[1].fraction_length) ? -sign : sign;
+    }
+
+    return 0;
+}
+
+int compare_bytes(const char *left, size_t left_length, const char *right, size_t right_length)
+{
+    size_t common = (left_length < right_length) ? left_length : right_length;
+    int result = memcmp(left, right, common);
+    if (result != 0)
+    {
+        return result;
+    }
+
+    return (left_length > right_length) - (left_length < right_length);
+}
+
+/**
+ * @brief Compare two lines by the key, and then by the whole line (the last
+ * resort comparison) unless `-u`.
+ *
+ * @param left_text the start of the left line
+ * @param left
+ * @param right_text
+ * @param right
+ * @return int
+ */
+int compare_sort_lines(const char *left_text, const struct SortLine *left,
+                       const char *right_text, const struct SortLine *right)
+{
+    int result;
+
+    if (is_sort_key_numeric)
+    {
+        result = compare_numbers(left_text + left->key_start, left->key_length,
+                                 right_text + right->key_start, right->key_length);
+    }
+    else if (left->key_prefix != right->key_prefix)
+    {
+        result = (left->key_prefix < right->key_prefix) ? -1 : 1;
+    }
+    else
+    {
+        result = compare_bytes(left_text + left->key_start, left->key_length,
+                               right_text + right->key_start, right->key_length);
+    }
+
+    if (result != 0)
+    {
+        return is_sort_key_reverse ? -result : result;
+    }
+
+    if (!is_sort_unique)
+    {
+        result = compare_bytes(left_text, left->length, right_text, right->length);
+    }
+
+    return is_sort_reverse ? -result : result;
+}
+
+int compare_chunk_lines(const void *left_ptr, const void *right_ptr, void *arg)
+{
+    const struct SortLine *left = left_ptr;
+    const struct SortLine *right = right_ptr;
+    const char *text = arg;
+
+    int result = compare_sort_lines(text + left->offset, left, text + right->offset, right);
+    if (result != 0)
+    {
+        return result;
+    }
+
+    // keep the input order of the equal lines, so that `-u` outputs the first one
+    return (left->offset > right->offset) - (left->offset < right->offset);
+}
+
+void *sort_part(void *arg)
+{
+    struct SortPart *part = arg;
+    qsort_r(part->source + part->start, part->end - part->start, sizeof(struct SortLine),
+            compare_chunk_lines, (void *)part->text);
+    return NULL;
+}
+
+void *merge_parts(void *arg)
+{
+    struct SortPart *part = arg;
+    size_t left = part->start;
+    size_t right = part->middle;
+    size_t target = part->start;
+
+    while (left < part->middle && right < part->end)
+    {
+        if (compare_chunk_lines(&part->source[right], &part->source[left], (void *)part->text) < 0)
+        {
+            part->target[target++] = part->source[right++];
+        }
+        else
+        {
+            part->target[target++] = part->source[left++];
+        }
+    }
+
+    memcpy(part->target + target, part->source + left, (part->middle - left) * sizeof(struct SortLine));
+    target += part->middle - left;
+    memcpy(part->target + target, part->source + right, (part->end - right) * sizeof(struct SortLine));
+    return NULL;
+}
+
+/**
+ * @brief Run the tasks by threads, the first task is run by the current thread.
+ */
+void run_sort_tasks(void *(*routine)(void *), struct SortPart *parts, size_t count)
+{
+    pthread_t threads[SORT_MAX_THREADS];
+    bool is_created[SORT_MAX_THREADS] = {false};
+
+    for (size_t idx = 1; idx < count; idx++)
+    {
+        is_created[idx] = (pthread_create(&threads[idx], NULL, routine, &parts[idx]) == 0);
+        if (!is_created[idx])
+        {
+            routine(&parts[idx]);
+        }
+    }
+
+    routine(&parts[0]);
+
+    for (size_t idx = 1; idx < count; idx++)
+    {
+        if (is_created[idx])
+        {
+            pthread_join(threads[idx], NULL);
+        }
+    }
+}
+
+/**
+ * @brief Sort the lines of a chunk, the lines are divided into parts which
+ * are sorted by threads, and then the sorted parts are merged in pairs,
+ * the pairs of a round are merged by threads too.
+ *
+ * @param chunk
+ */
+void sort_chunk(struct SortChunk *chunk)
+{
+    size_t parts_count = chunk->count / SORT_MIN_LINES_PER_THREAD;
+    parts_count = (parts_count > (size_t)sort_threads) ? (size_t)sort_threads : parts_count;
+
+    if (parts_count <= 1)
+    {
+        qsort_r(chunk->lines, chunk->count, sizeof(struct SortLine), compare_chunk_lines, chunk->text);
+        return;
+    }
+
+    size_t bounds[SORT_MAX_THREADS + 1];
+    for (size_t idx = 0; idx <= parts_count; idx++)
+    {
+        bounds[idx] = chunk->count * idx / parts_count;
+    }
+
+    struct SortPart parts[SORT_MAX_THREADS];
+    for (size_t idx = 0; idx < parts_count; idx++)
+    {
+        parts[idx] = (struct SortPart){
+            .text = chunk->text,
+            .source = chunk->lines,
+            .start = bounds[idx],
+            .end = bounds[idx + 1]};
+    }
+    run_sort_tasks(sort_part, parts, parts_count);
+
+    struct SortLine *source = chunk->lines;
+    struct SortLine *target = chunk->merge_lines;
+
+    while (parts_count > 1)
+    {
+        size_t pairs = parts_count / 2;
+        for (size_t idx = 0; idx < pairs; idx++)
+        {
+            parts[idx] = (struct SortPart){
+                .text = chunk->text,
+                .source = source,
+                .target = target,
+                .start = bounds[idx * 2],
+                .middle = bounds[idx * 2 + 1],
+                .end = bounds[idx * 2 + 2]};
+        }
+
+        if (parts_count % 2 == 1)
+        {
+            // the last part has no pair, it is copied as it is
+            size_t start = bounds[parts_count - 1];
+            memcpy(target + start, source + start, (chunk->count - start) * sizeof(struct SortLine));
+        }
+
+        run_sort_tasks(merge_parts, parts, pairs);
+
+        // the bounds of the merged parts
+        size_t merged_count = (parts_count + 1) / 2;
+        for (size_t idx = 0; idx < merged_count; idx++)
+        {
+            bounds[idx] = bounds[idx * 2];
+        }
+        bounds[merged_count] = chunk->count;
+        parts_count = merged_count;
+
+        struct SortLine *temp = source;
+        source = target;
+        target = temp;
+    }
+
+    chunk->lines = source;
+    chunk->merge_lines = target;
+}
+
+/**
+ * @brief Write a line, the line is skipped if it is equal to the previous
+ * one for `-u`.
+ *
+ * @param out
+ * @param text the start of the line
+ * @param line
+ * @param filter
+ */
+void write_sort_line(FILE *out, const char *text, const struct SortLine *line, struct UniqueFilter *filter)
+{
+    if (is_sort_unique)
+    {
+        if (filter->has_line && compare_sort_lines(filter->text, &filter->line, text, line) == 0)
+        {
+            return;
+        }
+
+        if (line->length > filter->capacity)
+        {
+            size_t capacity = (line->length < 256) ? 256 : line->length * 2;
+            char *new_text = realloc(filter->text, capacity);
+            if (new_text == NULL)
+            {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            filter->text = new_text;
+            filter->capacity = capacity;
+        }
+
+        memcpy(filter->text, text, line->length);
+        filter->line = *line;
+        filter->line.offset = 0;
+        filter->has_line = true;
+    }
+
+    fwrite(text, 1, line->length, out);
+    putc('\n', out);
+}
+
+bool write_chunk(struct SortChunk *chunk, FILE *out)
+{
+    struct UniqueFilter filter = {0};
+    for (size_t idx = 0; idx < chunk->count; idx++)
+    {
+        const struct SortLine *line = &chunk->lines[idx];
+        write_sort_line(out, chunk->text + line->offset, line, &filter);
+    }
+    free(filter.text);
+
+    if (fflush(out) != 0)
+    {
+        perror("sort: write");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Create an anonymous temporary file in the temporary directory.
+ *
+ * @return FILE* NULL if failed
+ */
+FILE *create_run_file(void)
+{
+    int fd = open(sort_temp_dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1)
+    {
+        // O_TMPFILE is not supported by some filesystems
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/sort.XXXXXX", sort_temp_dir);
+        fd = mkostemp(path, O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "sort: %s: %s\n", sort_temp_dir, strerror(errno));
+            return NULL;
+        }
+        unlink(path);
+    }
+
+    FILE *file = fdopen(fd, "w+");
+    if (file == NULL)
+    {
+        perror("fdopen");
+        close(fd);
+        return NULL;
+    }
+
+    setvbuf(file, NULL, _IOFBF, 256 * 1024);
+    return file;
+}
+
+bool add_run(FILE *file, bool is_first)
+{
+    if (sort_run_count == sort_run_capacity)
+    {
+        size_t capacity = (sort_run_capacity == 0) ? 16 : sort_run_capacity * 2;
+        FILE **runs = realloc(sort_runs, capacity * sizeof(FILE *));
+        if (runs == NULL)
+        {
+            perror("realloc");
+            return false;
+        }
+        sort_runs = runs;
+        sort_run_capacity = capacity;
+    }
+
+    if (is_first)
+    {
+        // the runs are kept in the input order, the earlier run wins the ties
+        memmove(sort_runs + 1, sort_runs, sort_run_count * sizeof(FILE *));
+        sort_runs[0] = file;
+    }
+    else
+    {
+        sort_runs[sort_run_count] = file;
+    }
+
+    sort_run_count++;
+    return true;
+}
+
+/**
+ * @brief Sort the complete lines of the chunk and write them to a new run,
+ * the incomplete last line is moved to the front of the chunk.
+ *
+ * @param chunk
+ * @return bool
+ */
+bool spill_chunk(struct SortChunk *chunk)
+{
+    FILE *file = create_run_file();
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    sort_chunk(chunk);
+    if (!write_chunk(chunk, file) || !add_run(file, false))
+    {
+        fclose(file);
+        return false;
+    }
+
+    chunk->length -= chunk->parsed;
+    memmove(chunk->text, chunk->text + chunk->parsed, chunk->length);
+    chunk->parsed = 0;
+    chunk->count = 0;
+    return true;
+}
+
+bool add_sort_line(struct SortChunk *chunk, size_t start, size_t end)
+{
+    if (chunk->count == chunk->line_capacity)
+    {
+        size_t capacity = (chunk->line_capacity == 0) ? 4096 : chunk->line_capacity * 2;
+        struct SortLine *lines = realloc(chunk->lines, capacity * sizeof(struct SortLine));
+        struct SortLine *merge_lines = realloc(chunk->merge_lines, capacity * sizeof(struct SortLine));
+        if (lines == NULL || merge_lines == NULL)
+        {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        chunk->lines = lines;
+        chunk->merge_lines = merge_lines;
+        chunk->line_capacity = capacity;
+    }
+
+    make_sort_line(chunk->text + start, end - start, start, &chunk->lines[chunk->count]);
+    chunk->count++;
+    return true;
+}
+
+size_t get_chunk_memory(const struct SortChunk *chunk)
+{
+    return chunk->length + chunk->count * 2 * sizeof(struct SortLine);
+}
+
+/**
+ * @brief Read the lines of a file into the chunk, the chunk is spilled to
+ * a run when it exceeds the memory budget.
+ *
+ * @param fd
+ * @param chunk
+ * @return int 0, or -1 if failed to spill, or the error number of reading
+ */
+int read_sort_input(int fd, struct SortChunk *chunk)
+{
+    while (true)
+    {
+        if (chunk->capacity - chunk->length < READ_BLOCK_SIZE)
+        {
+            if (chunk->count > 0 && get_chunk_memory(chunk) + READ_BLOCK_SIZE > sort_buffer_size)
+            {
+                if (!spill_chunk(chunk))
+                {
+                    return -1;
+                }
+                continue;
+            }
+
+            // the text grows only if the budget is not reached, or a line
+            // is longer than the budget
+            size_t capacity = (chunk->capacity == 0) ? 4 * READ_BLOCK_SIZE : chunk->capacity * 2;
+            if (capacity > sort_buffer_size && chunk->length + READ_BLOCK_SIZE <= sort_buffer_size)
+            {
+                capacity = sort_buffer_size;
+            }
+
+            char *text = realloc(chunk->text, capacity);
+            if (text == NULL)
+            {
+                return ENOMEM;
+            }
+            chunk->text = text;
+            chunk->capacity = capacity;
+        }
+
+        ssize_t nread = read(fd, chunk->text + chunk->length, chunk->capacity - chunk->length);
+        if (nread == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+
+        if (nread == 0)
+        {
+            break;
+        }
+
+        chunk->length += nread;
+
+        while (true)
+        {
+            char *newline = memchr(chunk->text + chunk->parsed, '\n', chunk->length - chunk->parsed);
+            if (newline == NULL)
+            {
+                break;
+            }
+
+            size_t end = newline - chunk->text;
+            add_sort_line(chunk, chunk->parsed, end);
+            chunk->parsed = end + 1;
+        }
+    }
+
+    // the last line of the file without the newline
+    if (chunk->parsed < chunk->length)
+    {
+        add_sort_line(chunk, chunk->parsed, chunk->length);
+        chunk->parsed = chunk->length;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read the next line of a run.
+ *
+ * @param reader
+ * @return bool false if there is no more line, or failed to read
+ */
+bool read_run_line(struct RunReader *reader)
+{
+    while (true)
+    {
+        char *newline = memchr(reader->buffer + reader->start, '\n', reader->end - reader->start);
+        if (newline != NULL)
+        {
+            size_t end = newline - reader->buffer;
+            make_sort_line(reader->buffer + reader->start, end - reader->start, reader->start, &reader->line);
+            reader->start = end + 1;
+            return true;
+        }
+
+        if (reader->is_eof)
+        {
+            // the runs always end with a newline
+            return false;
+        }
+
+        // move the incomplete line to the front, the buffer grows if the
+        // line is longer than it.
+        reader->end -= reader->start;
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end);
+        reader->start = 0;
+
+        if (reader->end == reader->capacity)
+        {
+            char *buffer = realloc(reader->buffer, reader->capacity * 2);
+            if (buffer == NULL)
+            {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            reader->buffer = buffer;
+            reader->capacity *= 2;
+        }
+
+        ssize_t nread = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+        if (nread == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("sort: read");
+            exit(EXIT_FAILURE);
+        }
+
+        reader->end += nread;
+        reader->is_eof = (nread == 0);
+    }
+}
+
+bool is_reader_less(const struct RunReader *readers, size_t left, size_t right)
+{
+    const struct RunReader *left_reader = &readers[left];
+    const struct RunReader *right_reader = &readers[right];
+
+    int result = compare_sort_lines(left_reader->buffer + left_reader->line.offset, &left_reader->line,
+                                    right_reader->buffer + right_reader->line.offset, &right_reader->line);
+
+    // the earlier run wins the ties, so the input order is kept
+    return (result != 0) ? (result < 0) : (left < right);
+}
+
+void sift_down_readers(const struct RunReader *readers, size_t *heap, size_t heap_size, size_t pos)
+{
+    while (true)
+    {
+        size_t smallest = pos;
+        size_t left = pos * 2 + 1;
+        size_t right = pos * 2 + 2;
+
+        if (left < heap_size && is_reader_less(readers, heap[left], heap[smallest]))
+        {
+            smallest = left;
+        }
+        if (right < heap_size && is_reader_less(readers, heap[right], heap[smallest]))
+        {
+            smallest = right;
+        }
+
+        if (smallest == pos)
+        {
+            return;
+        }
+
+        size_t temp = heap[pos];
+        heap[pos] = heap[smallest];
+        heap[smallest] = temp;
+        pos = smallest;
+    }
+}
+
+/**
+ * @brief Merge the sorted runs by a min-heap of the current line of each
+ * run, the runs are closed after merging.
+ *
+ * @param runs
+ * @param count
+ * @param out
+ * @return bool
+ */
+bool merge_runs(FILE **runs, size_t count, FILE *out)
+{
+    struct RunReader *readers = calloc(count, sizeof(struct RunReader));
+    size_t *heap = malloc(count * sizeof(size_t));
+    if (readers == NULL || heap == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // the memory budget is shared by the readers
+    size_t capacity = sort_buffer_size / count;
+    capacity = (capacity < SORT_MIN_READER_SIZE) ? SORT_MIN_READER_SIZE : capacity;
+
+    size_t heap_size = 0;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        struct RunReader *reader = &readers[idx];
+        reader->fd = fileno(runs[idx]);
+        reader->capacity = capacity;
+        reader->buffer = malloc(capacity);
+        if (reader->buffer == NULL)
+        {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        lseek(reader->fd, 0, SEEK_SET);
+        if (read_run_line(reader))
+        {
+            heap[heap_size] = idx;
+            heap_size++;
+        }
+    }
+
+    for (size_t pos = heap_size / 2; pos > 0; pos--)
+    {
+        sift_down_readers(readers, heap, heap_size, pos - 1);
+    }
+
+    struct UniqueFilter filter = {0};
+    while (heap_size > 0)
+    {
+        struct RunReader *reader = &readers[heap[0]];
+        write_sort_line(out, reader->buffer + reader->line.offset, &reader->line, &filter);
+
+        if (!read_run_line(reader))
+        {
+            heap_size--;
+            heap[0] = heap[heap_size];
+        }
+        sift_down_readers(readers, heap, heap_size, 0);
+    }
+
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        free(readers[idx].buffer);
+        fclose(runs[idx]);
+    }
+    free(filter.text);
+    free(readers);
+    free(heap);
+
+    if (fflush(out) != 0)
+    {
+        perror("sort: write");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parse the size of `-S`, e.g. "512K", "64M", "1G", "25%", the
+ * unit is KiB if omitted.
+ *
+ * @param text
+ * @return size_t 0 if the text is invalid
+ */
+size_t parse_sort_size(const char *text)
+{
+    char *end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if (end == text)
+    {
+        return 0;
+    }
+
+    switch (*end)
+    {
+    case 'b':
+        break;
+    case '\0':
+    case 'K':
+    case 'k':
+        value <<= 10;
+        break;
+    case 'M':
+    case 'm':
+        value <<= 20;
+        break;
+    case 'G':
+    case 'g':
+        value <<= 30;
+        break;
+    case '%':
+        value = (unsigned long long)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 100 * value;
+        break;
+    default:
+        return 0;
+    }
+
+    if (*end != '\0' && end[1] != '\0')
+    {
+        return 0;
+    }
+
+    return value;
+}
+
+/**
+ * @brief Parse the key of `-k`, i.e. "start[,end]", the field numbers
+ * start from 1, the modifiers "n" and "r" are supported.
+ *
+ * @param text
+ * @return bool
+ */
+bool parse_sort_key(const char *text)
+{
+    char *end;
+    long start = strtol(text, &end, 10);
+    if (end == text || start < 1)
+    {
+        return false;
+    }
+
+    long key_end = 0;
+    while (*end != '\0')
+    {
+        if (*end == 'n')
+        {
+            has_sort_key_options = true;
+            is_sort_key_numeric = true;
+            end++;
+        }
+        else if (*end == 'r')
+        {
+            has_sort_key_options = true;
+            is_sort_key_reverse = true;
+            end++;
+        }
+        else if (*end == ',' && key_end == 0)
+        {
+            const char *field = end + 1;
+            key_end = strtol(field, &end, 10);
+            if (end == field || key_end < 1)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // e.g. the character positions "2.3"
+            return false;
+        }
+    }
+
+    sort_key_start = start;
+    sort_key_end = key_end;
+    return true;
+}
+
+/**
+ * @brief Sort the lines of the files.
+ *
+ * the lines are read into a chunk until the memory budget (`-S`) is reached,
+ * then the chunk is sorted and spilled to a temporary file (in `-T`) as
+ * a sorted run, and the runs are merged at last. the input which fits in
+ * the budget is sorted in memory only.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_sort(int argc, char **argv)
+{
+    const char *usage =
+        "Usage:\n"
+        "    sort [-n] [-r] [-u] [-t char] [-k start[,end]] [-S size] [-T dir] [file]...\n";
+
+    // a quarter of the physical memory by default
+    sort_buffer_size = (size_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 4;
+
+    const char *temp_dir = getenv("TMPDIR");
+    if (temp_dir != NULL && temp_dir[0] != '\0')
+    {
+        sort_temp_dir = temp_dir;
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "nruk:t:S:T:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            is_sort_numeric = true;
+            break;
+        case 'r':
+            is_sort_reverse = true;
+            break;
+        case 'u':
+            is_sort_unique = true;
+            break;
+        case 'k':
+            if (!parse_sort_key(optarg))
+            {
+                fprintf(stderr, "sort: invalid key: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 't':
+            if (strlen(optarg) != 1)
+            {
+                fprintf(stderr, "sort: the separator must be a single character: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            sort_separator = (unsigned char)optarg[0];
+            break;
+        case 'S':
+            sort_buffer_size = parse_sort_size(optarg);
+            if (sort_buffer_size == 0)
+            {
+                fprintf(stderr, "sort: invalid size: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'T':
+            sort_temp_dir = optarg;
+            break;
+        default:
+            fputs(usage, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!has_sort_key_options)
+    {
+        is_sort_key_numeric = is_sort_numeric;
+        is_sort_key_reverse = is_sort_reverse;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    sort_threads = (cpus < 1) ? 1 : (cpus > SORT_MAX_THREADS ? SORT_MAX_THREADS : cpus);
+
+    char *current[] = {"-"};
+    char **paths = (optind == argc) ? current : argv + optind;
+    int count = (optind == argc) ? 1 : argc - optind;
+
+    struct SortChunk chunk = {0};
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        bool is_stdin = (strcmp(paths[idx], "-") == 0);
+        int fd = is_stdin ? STDIN_FILENO : open(paths[idx], O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "sort: %s: %s\n", paths[idx], strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        int result = read_sort_input(fd, &chunk);
+        if (!is_stdin)
+        {
+            close(fd);
+        }
+
+        if (result != 0)
+        {
+            if (result != -1)
+            {
+                fprintf(stderr, "sort: %s: %s\n", paths[idx], strerror(result));
+            }
+            return EXIT_FAILURE;
+        }
+    }
+
+    setvbuf(stdout, NULL, _IOFBF, 256 * 1024);
+
+    if (sort_run_count == 0)
+    {
+        // the input fits in memory
+        sort_chunk(&chunk);
+        return write_chunk(&chunk, stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (chunk.count > 0 && !spill_chunk(&chunk))
+    {
+        return EXIT_FAILURE;
+    }
+
+    // free the memory of the chunk for the readers of the runs
+    free(chunk.text);
+    free(chunk.lines);
+    free(chunk.merge_lines);
+
+    // the number of the open runs is limited, the earliest runs are merged
+    // into a new run first.
+    while (sort_run_count > SORT_MAX_MERGE_RUNS)
+    {
+        FILE *file = create_run_file();
+        if (file == NULL || !merge_runs(sort_runs, SORT_MAX_MERGE_RUNS, file))
+        {
+            return EXIT_FAILURE;
+        }
+
+        sort_run_count -= SORT_MAX_MERGE_RUNS;
+        memmove(sort_runs, sort_runs + SORT_MAX_MERGE_RUNS, sort_run_count * sizeof(FILE *));
+        add_run(file, true);
+    }
+
+    return merge_runs(sort_runs, sort_run_count, stdout) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#define XARGS_MAX_JOBS 1024
+
+// the result of reading an item of `xargs`
+enum XargsRead
+{
+    XARGS_END_OF_INPUT,
+    XARGS_ITEM,
+    XARGS_ERROR
+};
+
+struct XargsItem
+{
+    char *text;
+    size_t length;
+    size_t capacity;
+    // the item is followed by a newline, note that a line which ends with
+    // a blank continues on the next line (like GNU xargs)
+    bool is_end_of_line;
+};
+
+struct XargsJob
+{
+    pid_t pid;
+    int output_fd; // the memfd of stdout of `-g`, -1 if not grouped
+    int error_fd;  // the memfd of stderr
+};
+
+bool is_xargs_null = false;
+bool is_xargs_group = false;
+const char *xargs_replace = NULL;
+
+struct XargsJob xargs_jobs[XARGS_MAX_JOBS];
+int xargs_max_jobs = 1;
+int xargs_running = 0;
+int xargs_exit_code = EXIT_SUCCESS;
+bool is_xargs_aborted = false;
+sigset_t xargs_sigchld_set;
+
+void handle_sigchld(int signal_number)
+{
+    // nothing to do, SIGCHLD is blocked and received by `sigwaitinfo()`,
+    // the handler is installed to make sure it is not discarded.
+    (void)signal_number;
+}
+
+bool append_xargs_char(struct XargsItem *item, char ch)
+{
+    if (item->length + 1 >= item->capacity)
+    {
+        size_t capacity = (item->capacity == 0) ? 256 : item->capacity * 2;
+        char *text = realloc(item->text, capacity);
+        if (text == NULL)
+        {
+            perror("realloc");
+            return false;
+        }
+        item->text = text;
+        item->capacity = capacity;
+    }
+
+    item->text[item->length] = ch;
+    item->length++;
+    item->text[item->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Read an item from stdin.
+ *
+ * the items are separated by blanks and newlines, the quotes and the
+ * backslash escape the separators. with `-0` the items are separated by
+ * NULL only, and with `-I` each line is an item.
+ *
+ * @param item
+ * @return enum XargsRead
+ */
+enum XargsRead read_xargs_item(struct XargsItem *item)
+{
+    item->length = 0;
+    item->is_end_of_line = false;
+    append_xargs_char(item, '\0');
+    item->length = 0;
+
+    bool has_item = false;
+    int quote = 0;
+
+    int ch;
+    while ((ch = getc_unlocked(stdin)) != EOF)
+    {
+        if (is_xargs_null)
+        {
+            if (ch == '\0')
+            {
+                return XARGS_ITEM;
+            }
+        }
+        else if (xargs_replace != NULL)
+        {
+            if (ch == '\n')
+            {
+                if (has_item)
+                {
+                    item->is_end_of_line = true;
+                    return XARGS_ITEM;
+                }
+                continue;
+            }
+
+            if (!has_item && (ch == ' ' || ch == '\t'))
+            {
+                // skip the leading blanks
+                continue;
+            }
+        }
+        else if (quote != 0)
+        {
+            if (ch == quote)
+            {
+                quote = 0;
+                continue;
+            }
+
+            if (ch == '\n')
+            {
+                fputs("xargs: unmatched quote\n", stderr);
+                return XARGS_ERROR;
+            }
+        }
+        else if (ch == '\'' || ch == '"')
+        {
+            quote = ch;
+            has_item = true;
+            continue;
+        }
+        else if (ch == '\\')
+        {
+            ch = getc_unlocked(stdin);
+            if (ch == EOF)
+            {
+                break;
+            }
+        }
+        else if (ch == ' ' || ch == '\t' || ch == '\n')
+        {
+            if (has_item)
+            {
+                item->is_end_of_line = (ch == '\n');
+                return XARGS_ITEM;
+            }
+            continue;
+        }
+
+        if (!append_xargs_char(item, ch))
+        {
+            return XARGS_ERROR;
+        }
+        has_item = true;
+    }
+
+    if (quote != 0)
+    {
+        fputs("xargs: unmatched quote\n", stderr);
+        return XARGS_ERROR;
+    }
+
+    if (has_item)
+    {
+        item->is_end_of_line = true;
+        return XARGS_ITEM;
+    }
+
+    return XARGS_END_OF_INPUT;
+}
+
+/**
+ * @brief Copy the grouped output of a job, and close the memfd.
+ */
+void copy_job_output(int memfd, int fd)
+{
+    off_t length = lseek(memfd, 0, SEEK_END);
+    off_t offset = 0;
+
+    while (offset < length)
+    {
+        ssize_t written = sendfile(fd, memfd, &offset, length - offset);
+        if (written > 0)
+        {
+            continue;
+        }
+
+        if (written == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        // e.g. `sendfile` is not supported by the output, copy by read and write
+        char buf[4096];
+        ssize_t nread = pread(memfd, buf, sizeof(buf), offset);
+        if (nread <= 0 || write(fd, buf, nread) != nread)
+        {
+            break;
+        }
+        offset += nread;
+    }
+
+    close(memfd);
+}
+
+void finish_job(pid_t pid, int status)
+{
+    for (int idx = 0; idx < xargs_running; idx++)
+    {
+        struct XargsJob *job = &xargs_jobs[idx];
+        if (job->pid != pid)
+        {
+            continue;
+        }
+
+        if (job->output_fd != -1)
+        {
+            copy_job_output(job->output_fd, STDOUT_FILENO);
+            copy_job_output(job->error_fd, STDERR_FILENO);
+        }
+
+        // the same exit codes as GNU xargs
+        if (WIFSIGNALED(status))
+        {
+            fprintf(stderr, "xargs: the command was killed by signal %d\n", WTERMSIG(status));
+            xargs_exit_code = 125;
+            is_xargs_aborted = true;
+        }
+        else if (WEXITSTATUS(status) == 255)
+        {
+            fputs("xargs: the command exited with status 255, aborting\n", stderr);
+            xargs_exit_code = 124;
+            is_xargs_aborted = true;
+        }
+        else if (WEXITSTATUS(status) == 126 || WEXITSTATUS(status) == 127)
+        {
+            xargs_exit_code = WEXITSTATUS(status);
+            is_xargs_aborted = true;
+        }
+        else if (WEXITSTATUS(status) != 0 && xargs_exit_code == EXIT_SUCCESS)
+        {
+            xargs_exit_code = 123;
+        }
+
+        xargs_running--;
+        xargs_jobs[idx] = xargs_jobs[xargs_running];
+        return;
+    }
+}
+
+/**
+ * @brief Reap the exited children.
+ *
+ * @param is_blocking wait until at least one child exits
+ */
+void reap_jobs(bool is_blocking)
+{
+    bool has_reaped = false;
+
+    while (xargs_running > 0)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid > 0)
+        {
+            finish_job(pid, status);
+            has_reaped = true;
+            continue;
+        }
+
+        if (pid == 0 && is_blocking && !has_reaped)
+        {
+            // SIGCHLD is blocked, so the signal of a child which exits
+            // after `waitpid` is pending and it is not missed.
+            sigwaitinfo(&xargs_sigchld_set, NULL);
+            continue;
+        }
+
+        break;
+    }
+}
+
+/**
+ * @brief Close the memfds of the job which is not started.
+ *
+ * @param job
+ */
+void close_job_files(struct XargsJob *job)
+{
+    if (job->output_fd != -1)
+    {
+        close(job->output_fd);
+        job->output_fd = -1;
+    }
+
+    if (job->error_fd != -1)
+    {
+        close(job->error_fd);
+        job->error_fd = -1;
+    }
+}
+
+bool start_job(char **args)
+{
+    // wait for a free job slot
+    while (xargs_running >= xargs_max_jobs)
+    {
+        reap_jobs(true);
+    }
+
+    struct XargsJob job = {.output_fd = -1, .error_fd = -1};
+
+    if (is_xargs_group)
+    {
+        job.output_fd = memfd_create("xargs-stdout", MFD_CLOEXEC);
+        job.error_fd = memfd_create("xargs-stderr", MFD_CLOEXEC);
+        if (job.output_fd == -1 || job.error_fd == -1)
+        {
+            perror("memfd_create");
+            close_job_files(&job);
+            return false;
+        }
+    }
+
+    job.pid = fork();
+    if (job.pid == -1)
+    {
+        perror("fork");
+        close_job_files(&job);
+        return false;
+    }
+
+    if (job.pid == 0)
+    {
+        sigprocmask(SIG_UNBLOCK, &xargs_sigchld_set, NULL);
+
+        // the input of xargs is not for the commands
+        int null_fd = open("/dev/null", O_RDONLY);
+        if (null_fd != -1)
+        {
+            dup2(null_fd, STDIN_FILENO);
+            close(null_fd);
+        }
+
+        if (job.output_fd != -1)
+        {
+            dup2(job.output_fd, STDOUT_FILENO);
+            dup2(job.error_fd, STDERR_FILENO);
+        }
+
+        _exit(execute_command(args));
+    }
+
+    xargs_jobs[xargs_running] = job;
+    xargs_running++;
+    return true;
+}
+
+/**
+ * @brief Start a job of the batch, and free the arguments of the batch.
+ *
+ * @param args the command and the arguments of the batch
+ * @param args_count
+ * @param command_count
+ * @return bool
+ */
+bool run_xargs_batch(char **args, size_t args_count, size_t command_count)
+{
+    args[args_count] = NULL;
+    bool is_started = start_job(args);
+
+    for (size_t idx = command_count; idx < args_count; idx++)
+    {
+        free(args[idx]);
+    }
+
+    return is_started;
+}
+
+/**
+ * @brief Replace all the replace string in the text of `-I`.
+ *
+ * @return char* a new string
+ */
+char *replace_xargs_text(const char *text, const char *item)
+{
+    size_t replace_length = strlen(xargs_replace);
+    size_t item_length = strlen(item);
+
+    size_t count = 0;
+    for (const char *ptr = strstr(text, xargs_replace); ptr != NULL; ptr = strstr(ptr + replace_length, xargs_replace))
+    {
+        count++;
+    }
+
+    char *result = malloc(strlen(text) + count * item_length + 1);
+    if (result == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    char *target = result;
+    const char *ptr = text;
+    const char *found;
+    while ((found = strstr(ptr, xargs_replace)) != NULL)
+    {
+        memcpy(target, ptr, found - ptr);
+        target += found - ptr;
+        memcpy(target, item, item_length);
+        target += item_length;
+        ptr = found + replace_length;
+    }
+    strcpy(target, ptr);
+
+    return result;
+}
+
+/**
+ * @brief Build and execute the commands with the arguments from stdin.
+ *
+ * the arguments are batched up to the limit of `ARG_MAX`, or `-n` or `-L`,
+ * and up to `-P` commands are running at the same time. with `-g` the
+ * output of each command is kept in a memfd and written after the
+ * command exits, so the lines of the commands do not interleave.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_xargs(int argc, char **argv)
+{
+    const char *usage =
+        "Usage:\n"
+        "    xargs [-0] [-n max_args|-L max_lines|-I replace] [-P jobs] [-g] [-r] [command [args]...]\n"
+        "\n"
+        "-0    the items are separated by NULL instead of blanks and newlines\n"
+        "-n    use at most max_args arguments per command\n"
+        "-L    use at most max_lines non-blank input lines per command\n"
+        "-I    replace the string in the arguments by each input line\n"
+        "-P    run up to jobs commands at a time, 0 means as many as possible\n"
+        "-g    group the output of each command, write it after the command exits\n"
+        "-r    do not run the command if the input is empty\n";
+
+    long max_args = 0;
+    long max_lines = 0;
+    bool is_no_run_if_empty = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+0n:L:I:P:gr")) != -1)
+    {
+        switch (opt)
+        {
+        case '0':
+            is_xargs_null = true;
+            break;
+        case 'n':
+            max_args = atol(optarg);
+            max_lines = 0;
+            if (max_args < 1)
+            {
+                fprintf(stderr, "xargs: invalid number: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'L':
+            max_lines = atol(optarg);
+            max_args = 0;
+            if (max_lines < 1)
+            {
+                fprintf(stderr, "xargs: invalid number: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'I':
+            xargs_replace = optarg;
+            break;
+        case 'P':
+            xargs_max_jobs = atoi(optarg);
+            if (xargs_max_jobs < 0)
+            {
+                fprintf(stderr, "xargs: invalid number: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            if (xargs_max_jobs == 0 || xargs_max_jobs > XARGS_MAX_JOBS)
+            {
+                xargs_max_jobs = XARGS_MAX_JOBS;
+            }
+            break;
+        case 'g':
+            is_xargs_group = true;
+            break;
+        case 'r':
+            is_no_run_if_empty = true;
+            break;
+        default:
+            fputs(usage, stderr);
+            return EXIT_FAILURE;
+        }
+    }
+
+    char *default_command[] = {"echo"};
+    char **command = (optind == argc) ? default_command : argv + optind;
+    int command_count = (optind == argc) ? 1 : argc - optind;
+
+    // the size of the arguments and the environment variables is limited
+    // by ARG_MAX, both the strings and the pointers are counted.
+    extern char **environ;
+    long size_limit = sysconf(_SC_ARG_MAX);
+    size_limit = (size_limit <= 0) ? 128 * 1024 : size_limit;
+    for (char **env = environ; *env != NULL; env++)
+    {
+        size_limit -= strlen(*env) + 1 + sizeof(char *);
+    }
+    size_limit -= 2048; // the headroom like GNU xargs
+
+    size_t command_size = 0;
+    for (int idx = 0; idx < command_count; idx++)
+    {
+        command_size += strlen(command[idx]) + 1 + sizeof(char *);
+    }
+
+    // the arguments of the current batch follow the command
+    size_t args_capacity = command_count + 1024;
+    char **args = malloc(args_capacity * sizeof(char *));
+    if (args == NULL)
+    {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    memcpy(args, command, command_count * sizeof(char *));
+
+    size_t args_count = command_count;
+    size_t args_size = command_size;
+    long lines = 0;
+    bool has_run = false;
+    bool is_failed = false; // a job can not be started, or out of memory
+
+    sigemptyset(&xargs_sigchld_set);
+    sigaddset(&xargs_sigchld_set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &xargs_sigchld_set, NULL);
+    signal(SIGCHLD, handle_sigchld);
+
+    struct XargsItem item = {0};
+
+    while (!is_xargs_aborted)
+    {
+        enum XargsRead result = read_xargs_item(&item);
+        if (result == XARGS_ERROR)
+        {
+            xargs_exit_code = EXIT_FAILURE;
+            break;
+        }
+
+        if (result == XARGS_END_OF_INPUT)
+        {
+            break;
+        }
+
+        if (xargs_replace != NULL)
+        {
+            // a command per line
+            char **replaced = malloc((command_count + 1) * sizeof(char *));
+            if (replaced == NULL)
+            {
+                perror("malloc");
+                xargs_exit_code = EXIT_FAILURE;
+                is_failed = true;
+                break;
+            }
+
+            for (int idx = 0; idx < command_count; idx++)
+            {
+                replaced[idx] = replace_xargs_text(command[idx], item.text);
+            }
+            replaced[command_count] = NULL;
+
+            has_run = true;
+            bool is_started = start_job(replaced);
+
+            for (int idx = 0; idx < command_count; idx++)
+            {
+                free(replaced[idx]);
+            }
+            free(replaced);
+
+            if (!is_started)
+            {
+                xargs_exit_code = EXIT_FAILURE;
+                is_failed = true;
+                break;
+            }
+            continue;
+        }
+
+        size_t item_size = item.length + 1 + sizeof(char *);
+        if (command_size + item_size > (size_t)size_limit)
+        {
+            fprintf(stderr, "xargs: the argument is too long\n");
+            xargs_exit_code = EXIT_FAILURE;
+            break;
+        }
+
+        if (args_size + item_size > (size_t)size_limit)
+        {
+            // the batch is full
+            has_run = true;
+            if (!run_xargs_batch(args, args_count, command_count))
+            {
+                // the arguments of the batch have been freed
+                args_count = command_count;
+                xargs_exit_code = EXIT_FAILURE;
+                is_failed = true;
+                break;
+            }
+            args_count = command_count;
+            args_size = command_size;
+            lines = 0;
+        }
+
+        if (args_count + 1 >= args_capacity)
+        {
+            args_capacity *= 2;
+            char **new_args = realloc(args, args_capacity * sizeof(char *));
+            if (new_args == NULL)
+            {
+                perror("realloc");
+                xargs_exit_code = EXIT_FAILURE;
+                is_failed = true;
+                break;
+            }
+            args = new_args;
+        }
+
+        args[args_count] = strdup(item.text);
+        if (args[args_count] == NULL)
+        {
+            perror("strdup");
+            xargs_exit_code = EXIT_FAILURE;
+            is_failed = true;
+            break;
+        }
+        args_count++;
+        args_size += item_size;
+
+        lines += (max_lines > 0 && item.is_end_of_line);
+
+        bool is_batch_full = (max_args > 0 && args_count - command_count >= (size_t)max_args) ||
+                             (max_lines > 0 && lines >= max_lines);
+
+        if (is_batch_full)
+        {
+            has_run = true;
+            if (!run_xargs_batch(args, args_count, command_count))
+            {
+                // the arguments of the batch have been freed
+                args_count = command_count;
+                xargs_exit_code = EXIT_FAILURE;
+                is_failed = true;
+                break;
+            }
+            args_count = command_count;
+            args_size = command_size;
+            lines = 0;
+        }
+    }
+
+    // the last batch, the command runs once even if the input is empty (like
+    // GNU xargs) unless `-r`
+    if (!is_xargs_aborted && !is_failed &&
+        (args_count > (size_t)command_count || (!has_run && !is_no_run_if_empty && xargs_replace == NULL)))
+    {
+        if (!run_xargs_batch(args, args_count, command_count))
+        {
+            xargs_exit_code = EXIT_FAILURE;
+        }
+        args_count = command_count;
+    }
+
+    while (xargs_running > 0)
+    {
+        reap_jobs(true);
+    }
+
+    for (size_t idx = command_count; idx < args_count; idx++)
+    {
+        free(args[idx]);
+    }
+    free(args);
+    free(item.text);
+
+    return xargs_exit_code;
+}
+
+#define DD_ALIGNMENT 4096
+#define DD_OFFSET_MAX ((uint64_t)INT64_MAX) // the maximum of `off_t`
+#define DD_MMAP_WINDOW_SIZE (64 * 1024 * 1024)
+
+enum DdMode
+{
+    DD_MODE_RW,   // read and write
+    DD_MODE_MMAP, // map the input, and write from the mapping
+    DD_MODE_COPY  // copy_file_range, the data does not pass the user space
+};
+
+struct DdStat
+{
+    uint64_t full_in;
+    uint64_t partial_in;
+    uint64_t full_out;
+    uint64_t partial_out;
+    uint64_t bytes;
+    struct timespec start;
+    struct timespec last_report;
+};
+
+const char *dd_usage =
+    "Usage:\n"
+    "    dd [if=file] [of=file] [bs=size] [count=n] [skip=n] [seek=n]\n"
+    "       [iflag=direct] [oflag=direct,dsync] [conv=fsync,sparse,notrunc]\n"
+    "       [status=progress|none] [mode=rw|mmap|copy]\n"
+    "\n"
+    "the size accepts the suffixes c (1), w (2), b (512), K, M and G (1024^n).\n"
+    "\n"
+    "mode=rw      read and write by the buffer (default)\n"
+    "mode=mmap    map the input file and write from the mapping\n"
+    "mode=copy    copy by copy_file_range, the data does not pass the user space\n";
+
+bool is_dd_progress = false;
+bool is_dd_quiet = false;
+bool is_dd_sparse = false;
+
+/**
+ * @brief Parse the size of `dd`, e.g. "4096", "4K", "1M", "8b".
+ *
+ * @param text
+ * @param value
+ * @return bool
+ */
+bool parse_dd_size(const char *text, uint64_t *value)
+{
+    // `strtoull` accepts the sign and the leading spaces, e.g. "-1" is
+    // UINT64_MAX, so the text must start with a digit
+    if (!isdigit((unsigned char)text[0]))
+    {
+        return false;
+    }
+
+    char *end;
+    errno = 0;
+    unsigned long long number = strtoull(text, &end, 10);
+    if (errno != 0)
+    {
+        return false;
+    }
+
+    uint64_t unit = 1;
+    switch (*end)
+    {
+    case '\0':
+    case 'c':
+        break;
+    case 'w':
+        unit = 2;
+        break;
+    case 'b':
+        unit = 512;
+        break;
+    case 'k':
+    case 'K':
+        unit = 1024;
+        break;
+    case 'M':
+        unit = 1024 * 1024;
+        break;
+    case 'G':
+        unit = 1024 * 1024 * 1024;
+        break;
+    default:
+        return false;
+    }
+
+    if ((*end != '\0' && end[1] != '\0') || number > UINT64_MAX / unit)
+    {
+        return false;
+    }
+
+    *value = number * unit;
+    return true;
+}
+
+/**
+ * @brief Check whether the flags in the list (e.g. "direct,dsync") are all
+ * supported, and set the matched flags.
+ *
+ * @param list
+ * @param names the supported names
+ * @param flags the flags of the names
+ * @param result
+ * @return bool
+ */
+bool parse_dd_flags(const char *list, const char **names, const int *flags, int *result)
+{
+    char *copy = strdup(list);
+    char *saveptr;
+    bool is_valid = true;
+
+    for (char *name = strtok_r(copy, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr))
+    {
+        int idx = 0;
+        while (names[idx] != NULL && strcmp(names[idx], name) != 0)
+        {
+            idx++;
+        }
+
+        if (names[idx] == NULL)
+        {
+            fprintf(stderr, "dd: invalid flag: %s\n", name);
+            is_valid = false;
+            break;
+        }
+
+        *result |= flags[idx];
+    }
+
+    free(copy);
+    return is_valid;
+}
+
+double get_elapsed_seconds(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+void print_dd_throughput(const struct DdStat *stat, const struct timespec *now, bool is_final)
+{
+    double seconds = get_elapsed_seconds(&stat->start, now);
+    double rate = (seconds > 0) ? stat->bytes / seconds : 0;
+    double iops = (seconds > 0) ? (stat->full_out + stat->partial_out) / seconds : 0;
+
+    fprintf(stderr, "%s%llu bytes (%.1f MB, %.1f MiB) copied, %.3f s, %.1f MB/s, %.0f IOPS%s",
+            is_final ? "" : "\r",
+            (unsigned long long)stat->bytes, stat->bytes / 1e6, stat->bytes / 1048576.0,
+            seconds, rate / 1e6, iops,
+            is_final ? "\n" : "   ");
+}
+
+/**
+ * @brief Account a block, and print the progress every second for
+ * `status=progress`.
+ */
+void update_dd_stat(struct DdStat *stat, size_t length, size_t block_size)
+{
+    if (length == block_size)
+    {
+        stat->full_in++;
+        stat->full_out++;
+    }
+    else
+    {
+        stat->partial_in++;
+        stat->partial_out++;
+    }
+    stat->bytes += length;
+
+    if (is_dd_progress)
+    {
+        // the clock is read by vDSO, it is cheap
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (get_elapsed_seconds(&stat->last_report, &now) >= 1.0)
+        {
+            print_dd_throughput(stat, &now, false);
+            stat->last_report = now;
+        }
+    }
+}
+
+bool is_zero_block(const unsigned char *data, size_t length)
+{
+    size_t idx = 0;
+    for (; idx + 8 <= length; idx += 8)
+    {
+        if (swar_load(data + idx) != 0)
+        {
+            return false;
+        }
+    }
+
+    for (; idx < length; idx++)
+    {
+        if (data[idx] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Clear O_DIRECT of the file, for the unaligned last block.
+ *
+ * @return int 1 if it was cleared, 0 if it was not set, -1 for error
+ */
+int drop_direct_io(int fd)
+{
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || (flags & O_DIRECT) == 0)
+    {
+        return 0;
+    }
+
+    if (fcntl(fd, F_SETFL, flags & ~O_DIRECT) != 0)
+    {
+        perror("dd: fcntl");
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Write a block, the block of zeros is skipped by seeking for
+ * `conv=sparse`.
+ *
+ * @return bool
+ */
+bool write_dd_block(int fd, const unsigned char *data, size_t length, bool *is_hole)
+{
+    if (is_dd_sparse && is_zero_block(data, length))
+    {
+        if (lseek(fd, length, SEEK_CUR) != -1)
+        {
+            *is_hole = true;
+            return true;
+        }
+
+        if (errno != ESPIPE)
+        {
+            perror("dd: lseek");
+            return false;
+        }
+
+        // the output can not be seeked (e.g. a pipe), write the zeros as
+        // GNU dd does
+        is_dd_sparse = false;
+    }
+
+    *is_hole = false;
+
+    // O_DIRECT requires the aligned length (and buffer), it is dropped
+    // before the partial last block, as GNU dd does.
+    if ((length % DD_ALIGNMENT != 0 || (uintptr_t)data % DD_ALIGNMENT != 0) && drop_direct_io(fd) == -1)
+    {
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t result = write(fd, data + written, length - written);
+        if (result == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("dd: write");
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a block, a short read (e.g. a pipe) is a partial block.
+ *
+ * @return ssize_t the bytes read, 0 for the end of file, -1 for error
+ */
+ssize_t read_dd_block(int fd, unsigned char *buffer, size_t length)
+{
+    while (true)
+    {
+        ssize_t result = read(fd, buffer, length);
+        if (result == -1 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (result == -1)
+        {
+            perror("dd: read");
+        }
+        return result;
+    }
+}
+
+bool copy_by_read_write(int in_fd, int out_fd, uint64_t block_size, uint64_t count,
+                        struct DdStat *stat, bool *is_hole)
+{
+    // O_DIRECT requires the aligned buffer
+    unsigned char *buffer;
+    if (posix_memalign((void **)&buffer, DD_ALIGNMENT, block_size) != 0)
+    {
+        fputs("dd: failed to allocate the buffer\n", stderr);
+        return false;
+    }
+
+    bool is_success = true;
+    for (uint64_t idx = 0; idx < count; idx++)
+    {
+        ssize_t length = read_dd_block(in_fd, buffer, block_size);
+        if (length <= 0)
+        {
+            is_success = (length == 0);
+            break;
+        }
+
+        if (!write_dd_block(out_fd, buffer, length, is_hole))
+        {
+            is_success = false;
+            break;
+        }
+
+        update_dd_stat(stat, length, block_size);
+    }
+
+    free(buffer);
+    return is_success;
+}
+
+bool copy_by_mmap(int in_fd, int out_fd, uint64_t block_size, uint64_t count, uint64_t offset,
+                  struct DdStat *stat, bool *is_hole)
+{
+    struct stat s;
+    if (fstat(in_fd, &s) != 0 || !S_ISREG(s.st_mode))
+    {
+        fputs("dd: mode=mmap requires a regular input file\n", stderr);
+        return false;
+    }
+
+    uint64_t end = s.st_size;
+    if (offset < end && count < (end - offset) / block_size)
+    {
+        end = offset + count * block_size;
+    }
+
+    // the input is mapped by windows, a window is a multiple of the block
+    // size and the page size
+    uint64_t window_size = (DD_MMAP_WINDOW_SIZE / block_size) * block_size;
+    window_size = (window_size < block_size) ? block_size : window_size;
+
+    while (offset < end)
+    {
+        // the offset of `mmap` must be aligned to the page
+        uint64_t map_offset = offset & ~(uint64_t)(DD_ALIGNMENT - 1);
+        uint64_t window_end = (offset + window_size < end) ? offset + window_size : end;
+        size_t map_length = window_end - map_offset;
+
+        unsigned char *data = mmap(NULL, map_length, PROT_READ, MAP_SHARED, in_fd, map_offset);
+        if (data == MAP_FAILED)
+        {
+            perror("dd: mmap");
+            return false;
+        }
+        madvise(data, map_length, MADV_SEQUENTIAL);
+
+        for (; offset < window_end; offset += block_size)
+        {
+            size_t length = (window_end - offset < block_size) ? window_end - offset : block_size;
+            if (!write_dd_block(out_fd, data + (offset - map_offset), length, is_hole))
+            {
+                munmap(data, map_length);
+                return false;
+            }
+
+            update_dd_stat(stat, length, block_size);
+        }
+
+        munmap(data, map_length);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Copy by `copy_file_range`, the blocks are copied in the kernel
+ * (or shared by reflink on some filesystems).
+ *
+ * @return int 1 for success, 0 for failure, -1 if not supported by the
+ * files and nothing has been copied
+ */
+int copy_by_copy_file_range(int in_fd, int out_fd, uint64_t block_size, uint64_t count, struct DdStat *stat)
+{
+    for (uint64_t idx = 0; idx < count; idx++)
+    {
+        size_t copied = 0;
+        while (copied < block_size)
+        {
+            ssize_t result = copy_file_range(in_fd, NULL, out_fd, NULL, block_size - copied, 0);
+            if (result == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                // the unaligned last block of O_DIRECT, copy it without O_DIRECT
+                if (errno == EINVAL && (stat->bytes > 0 || copied > 0) && drop_direct_io(out_fd) == 1)
+                {
+                    continue;
+                }
+
+                if (stat->bytes == 0 && copied == 0 &&
+                    (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+                {
+                    return -1;
+                }
+
+                perror("dd: copy_file_range");
+                return 0;
+            }
+
+            if (result == 0)
+            {
+                break;
+            }
+            copied += result;
+        }
+
+        if (copied == 0)
+        {
+            break;
+        }
+
+        update_dd_stat(stat, copied, block_size);
+
+        if (copied < block_size)
+        {
+            // the end of file
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Copy blocks between files, and report the throughput.
+ *
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int command_dd(int argc, char **argv)
+{
+    const char *input_path = NULL;
+    const char *output_path = NULL;
+    uint64_t block_size = 512;
+    uint64_t count = UINT64_MAX; // all
+    uint64_t skip = 0;
+    uint64_t seek = 0;
+    int input_flags = 0;
+    int output_flags = 0;
+    int conversions = 0;
+    enum DdMode mode = DD_MODE_RW;
+
+    // `conv`
+    const int CONV_FSYNC = 1;
+    const int CONV_SPARSE = 2;
+    const int CONV_NOTRUNC = 4;
+
+    const char *input_flag_names[] = {"direct", NULL};
+    const int input_flag_values[] = {O_DIRECT};
+    const char *output_flag_names[] = {"direct", "dsync", "sync", NULL};
+    const int output_flag_values[] = {O_DIRECT, O_DSYNC, O_SYNC};
+    const char *conversion_names[] = {"fsync", "sparse", "notrunc", NULL};
+    const int conversion_values[] = {CONV_FSYNC, CONV_SPARSE, CONV_NOTRUNC};
+
+    for (int idx = 1; idx < argc; idx++)
+    {
+        char *operand = argv[idx];
+        char *value = strchr(operand, '=');
+        if (value == NULL)
+        {
+            fputs(dd_usage, stderr);
+            return EXIT_FAILURE;
+        }
+
+        size_t name_length = value - operand;
+        value++;
+
+        bool is_valid = true;
+        if (strncmp(operand, "if", name_length) == 0 && name_length == 2)
+        {
+            input_path = value;
+        }
+        else if (strncmp(operand, "of", name_length) == 0 && name_length == 2)
+        {
+            output_path = value;
+        }
+        else if (strncmp(operand, "bs", name_length) == 0 && name_length == 2)
+        {
+            is_valid = parse_dd_size(value, &block_size) && block_size > 0;
+        }
+        else if (strncmp(operand, "count", name_length) == 0 && name_length == 5)
+        {
+            is_valid = parse_dd_size(value, &count);
+        }
+        else if (strncmp(operand, "skip", name_length) == 0 && name_length == 4)
+        {
+            is_valid = parse_dd_size(value, &skip);
+        }
+        else if (strncmp(operand, "seek", name_length) == 0 && name_length == 4)
+        {
+            is_valid = parse_dd_size(value, &seek);
+        }
+        else if (strncmp(operand, "iflag", name_length) == 0 && name_length == 5)
+        {
+            is_valid = parse_dd_flags(value, input_flag_names, input_flag_values, &input_flags);
+        }
+        else if (strncmp(operand, "oflag", name_length) == 0 && name_length == 5)
+        {
+            is_valid = parse_dd_flags(value, output_flag_names, output_flag_values, &output_flags);
+        }
+        else if (strncmp(operand, "conv", name_length) == 0 && name_length == 4)
+        {
+            is_valid = parse_dd_flags(value, conversion_names, conversion_values, &conversions);
+        }
+        else if (strncmp(operand, "status", name_length) == 0 && name_length == 6)
+        {
+            is_dd_progress = (strcmp(value, "progress") == 0);
+            is_dd_quiet = (strcmp(value, "none") == 0);
+            is_valid = is_dd_progress || is_dd_quiet;
+        }
+        else if (strncmp(operand, "mode", name_length) == 0 && name_length == 4)
+        {
+            if (strcmp(value, "rw") == 0)
+            {
+                mode = DD_MODE_RW;
+            }
+            else if (strcmp(value, "mmap") == 0)
+            {
+                mode = DD_MODE_MMAP;
+            }
+            else if (strcmp(value, "copy") == 0)
+            {
+                mode = DD_MODE_COPY;
+            }
+            else
+            {
+                is_valid = false;
+            }
+        }
+        else
+        {
+            is_valid = false;
+        }
+
+        if (!is_valid)
+        {
+            fprintf(stderr, "dd: invalid operand: %s\n", operand);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // the offsets of skip and seek in bytes must fit `off_t`
+    if (skip > DD_OFFSET_MAX / block_size || seek > DD_OFFSET_MAX / block_size)
+    {
+        fputs("dd: the offset of skip or seek is too large\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    is_dd_sparse = (conversions & CONV_SPARSE) != 0;
+
+    int in_fd = STDIN_FILENO;
+    if (input_path != NULL)
+    {
+        in_fd = open(input_path, O_RDONLY | O_CLOEXEC | input_flags);
+        if (in_fd == -1)
+        {
+            fprintf(stderr, "dd: %s: %s\n", input_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    int out_fd = STDOUT_FILENO;
+    if (output_path != NULL)
+    {
+        // the output is truncated at the seek offset, i.e. the blocks before
+        // it are kept
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC | output_flags;
+        if ((conversions & CONV_NOTRUNC) == 0 && seek == 0)
+        {
+            flags |= O_TRUNC;
+        }
+
+        out_fd = open(output_path, flags, 0644);
+        if (out_fd == -1)
+        {
+            fprintf(stderr, "dd: %s: %s\n", output_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        struct stat s;
+        if ((conversions & CONV_NOTRUNC) == 0 && seek > 0 &&
+            fstat(out_fd, &s) == 0 && S_ISREG(s.st_mode))
+        {
+            ftruncate(out_fd, seek * block_size);
+        }
+    }
+
+    if (skip > 0 && mode != DD_MODE_MMAP && lseek(in_fd, skip * block_size, SEEK_CUR) == -1)
+    {
+        // e.g. a pipe, skip by reading
+        unsigned char *buffer = malloc(block_size);
+        if (buffer == NULL)
+        {
+            perror("dd: malloc");
+            return EXIT_FAILURE;
+        }
+
+        for (uint64_t idx = 0; idx < skip; idx++)
+        {
+            ssize_t length = read_dd_block(in_fd, buffer, block_size);
+            if (length == -1)
+            {
+                free(buffer);
+                return EXIT_FAILURE;
+            }
+
+            if (length == 0)
+            {
+                // the same as GNU dd, nothing is copied
+                fputs("dd: cannot skip to the specified offset\n", stderr);
+                break;
+            }
+        }
+        free(buffer);
+    }
+
+    if (seek > 0 && lseek(out_fd, seek * block_size, SEEK_CUR) == -1)
+    {
+        perror("dd: lseek");
+        return EXIT_FAILURE;
+    }
+
+    struct DdStat stat = {0};
+    clock_gettime(CLOCK_MONOTONIC, &stat.start);
+    stat.last_report = stat.start;
+
+    bool is_hole = false;
+    bool is_success;
+
+    if (mode == DD_MODE_COPY)
+    {
+        int result = copy_by_copy_file_range(in_fd, out_fd, block_size, count, &stat);
+        if (result == -1)
+        {
+            fputs("dd: copy_file_range is not supported by the files, fall back to read and write\n", stderr);
+            result = copy_by_read_write(in_fd, out_fd, block_size, count, &stat, &is_hole);
+        }
+        is_success = (result == 1);
+    }
+    else if (mode == DD_MODE_MMAP)
+    {
+        is_success = copy_by_mmap(in_fd, out_fd, block_size, count, skip * block_size, &stat, &is_hole);
+    }
+    else
+    {
+        is_success = copy_by_read_write(in_fd, out_fd, block_size, count, &stat, &is_hole);
+    }
+
+    // the hole at the end of file does not change the size, so the size
+    // is set explicitly
+    if (is_hole)
+    {
+        off_t size = lseek(out_fd, 0, SEEK_CUR);
+        if (size == -1 || ftruncate(out_fd, size) != 0)
+        {
+            perror("dd: ftruncate");
+            is_success = false;
+        }
+    }
+
+    if ((conversions & CONV_FSYNC) != 0 && fsync(out_fd) != 0)
+    {
+        perror("dd: fsync");
+        is_success = false;
+    }
+
+    if (!is_dd_quiet)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        if (is_dd_progress && (stat.last_report.tv_sec != stat.start.tv_sec ||
+                               stat.last_report.tv_nsec != stat.start.tv_nsec))
+        {
+            // end the progress line
+            fputc('\n', stderr);
+        }
+
+        fprintf(stderr, "%llu+%llu records in\n%llu+%llu records out\n",
+                (unsigned long long)stat.full_in, (unsigned long long)stat.partial_in,
+                (unsigned long long)stat.full_out, (unsigned long long)stat.partial_out);
+        print_dd_throughput(&stat, &now, true);
+    }
+
+    if (output_path != NULL && close(out_fd) != 0)
+    {
+        perror("dd: close");
+        is_success = false;
+    }
+
+    return is_success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#define CHECKSUM_MAX_THREADS 32
+#define CHECKSUM_BLOCK_SIZE (1024 * 1024)
+#define CHECKSUM_MAX_DIGEST_LENGTH 64 // the hex digits
+
+enum ChecksumType
+{
+    CHECKSUM_SHA256,
+    CHECKSUM_CRC32C,
+    CHECKSUM_XXH64
+};
+
+struct ChecksumState
+{
+    struct Sha256 sha256;
+    uint32_t crc;
+    struct Xxh64 xxh64;
+};
+
+struct ChecksumTask
+{
+    const char *filepath;
+    char *line; // the line of the checklist which owns the filepath, `-c` only
+    char expected[CHECKSUM_MAX_DIGEST_LENGTH + 1];
+    char digest[CHECKSUM_MAX_DIGEST_LENGTH + 1];
+    int error_number;
+};
+
+enum ChecksumType checksum_type = CHECKSUM_SHA256;
+struct ChecksumTask *checksum_tasks = NULL;
+size_t checksum_task_count = 0;
+size_t checksum_next_task = 0;
+
+/**
+ * @brief The number of the hex digits of the digest.
+ */
+size_t get_digest_length(void)
+{
+    switch (checksum_type)
+    {
+    case CHECKSUM_SHA256:
+        return SHA256_DIGEST_SIZE * 2;
+    case CHECKSUM_CRC32C:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+void init_checksum(struct ChecksumState *state)
+{
+    switch (checksum_type)
+    {
+    case CHECKSUM_SHA256:
+        sha256_init(&state->sha256);
+        break;
+    case CHECKSUM_CRC32C:
+        state->crc = 0;
+        break;
+    case CHECKSUM_XXH64:
+        xxh64_init(&state->xxh64, 0);
+        break;
+    }
+}
+
+void update_checksum(struct ChecksumState *state, const void *data, size_t length)
+{
+    switch (checksum_type)
+    {
+    case CHECKSUM_SHA256:
+        sha256_update(&state->sha256, data, length);
+        break;
+    case CHECKSUM_CRC32C:
+        state->crc = crc32c_update(state->crc, data, length);
+        break;
+    case CHECKSUM_XXH64:
+        xxh64_update(&state->xxh64, data, length);
+        break;
+    }
+}
+
+void finish_checksum(struct ChecksumState *state, char *digest)
+{
+    switch (checksum_type)
+    {
+    case CHECKSUM_SHA256:
+    {
+        unsigned char bytes[SHA256_DIGEST_SIZE];
+        sha256_final(&state->sha256, bytes);
+        for (int idx = 0; idx < SHA256_DIGEST_SIZE; idx++)
+        {
+            sprintf(digest + idx * 2, "%02x", bytes[idx]);
+        }
+        break;
+    }
+    case CHECKSUM_CRC32C:
+        sprintf(digest, "%08x", state->crc);
+        break;
+    case CHECKSUM_XXH64:
+        sprintf(digest, "%016llx", (unsigned long long)xxh64_final(&state->xxh64));
+        break;
+    }
+}
+
+/**
+ * @brief Compute the checksum of a file, the regular file is mapped into
+ * memory, the others are read by large blocks.
+ *
+ * @param filepath "-" for stdin
+ * @param buffer CHECKSUM_BLOCK_SIZE bytes
+ * @param digest the hex digits
+ * @return int 0, or the error number
+ */
+int checksum_file(const char *filepath, unsigned char *buffer, char *digest)
+{
+    bool is_stdin = (strcmp(filepath, "-") == 0);
+    int fd = is_stdin ? STDIN_FILENO : open(filepath, O_RDONLY);
+    if (fd == -1)
+    {
+        return errno;
+    }
+
+    struct ChecksumState state;
+    init_checksum(&state);
+
+    int error_number = 0;
+    bool is_done = false;
+
+    struct stat s;
+    if (fstat(fd, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0 && lseek(fd, 0, SEEK_CUR) == 0)
+    {
+        void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, s.st_size, MADV_SEQUENTIAL);
+            update_checksum(&state, data, s.st_size);
+            munmap(data, s.st_size);
+            is_done = true;
+        }
+    }
+
+    while (!is_done)
+    {
+        ssize_t nread = read(fd, buffer, CHECKSUM_BLOCK_SIZE);
+        if (nread == 0)
+        {
+            break;
+        }
+
+        if (nread == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            error_number = errno;
+            break;
+        }
+
+        update_checksum(&state, buffer, nread);
+    }
+
+    if (!is_stdin)
+    {
+        close(fd);
+    }
+
+    if (error_number == 0)
+    {
+        finish_checksum(&state, digest);
+    }
+    return error_number;
+}
+
+void *run_checksum_worker(void *arg)
+{
+    (void)arg;
+
+    unsigned char *buffer = malloc(CHECKSUM_BLOCK_SIZE);
+
+    while (true)
+    {
+        size_t idx = __atomic_fetch_add(&checksum_next_task, 1, __ATOMIC_RELAXED);
+        if (idx >= checksum_task_count)
+        {
+            break;
+        }
+
+        struct ChecksumTask *task = &checksum_tasks[idx];
+        task->error_number = (buffer == NULL) ? ENOMEM : checksum_file(task->filepath, buffer, task->digest);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief Compute the checksums of all tasks, the files are taken by the
+ * threads one by one, the current thread works too.
+ */
+void run_checksum_tasks(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = (cpus < 1) ? 1 : (cpus > CHECKSUM_MAX_THREADS ? CHECKSUM_MAX_THREADS : cpus);
+    thread_count = (thread_count > checksum_task_count) ? checksum_task_count : thread_count;
+
+    pthread_t threads[CHECKSUM_MAX_THREADS];
+    bool is_created[CHECKSUM_MAX_THREADS] = {false};
+
+    checksum_next_task = 0;
+
+    for (size_t idx = 1; idx < thread_count; idx++)
+    {
+        is_created[idx] = (pthread_create(&threads[idx], NULL, run_checksum_worker, NULL) == 0);
+    }
+
+    run_checksum_worker(NULL);
+
+    for (size_t idx = 1; idx < thread_count; idx++)
+    {
+        if (is_created[idx])
+        {
+            pthread_join(threads[idx], NULL);
+        }
+    }
+}
+
+bool add_checksum_task(const char *filepath, char *line, const char *expected)
+{
+    static size_t capacity = 0;
+    if (checksum_task_count == capacity)
+    {
+        size_t new_capacity = (capacity == 0) ? 16 : capacity * 2;
+        struct ChecksumTask *tasks = realloc(checksum_tasks, new_capacity * sizeof(struct ChecksumTask));
+        if (tasks == NULL)
+        {
+            return false;
+        }
+        checksum_tasks = tasks;
+        capacity = new_capacity;
+    }
+
+    struct ChecksumTask *task = &checksum_tasks[checksum_task_count++];
+    memset(task, 0, sizeof(struct ChecksumTask));
+    task->filepath = filepath;
+    task->line = line;
+    if (expected != NULL)
+    {
+        size_t length = get_digest_length();
+        for (size_t idx = 0; idx < length; idx++)
+        {
+            task->expected[idx] = tolower((unsigned char)expected[idx]);
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Parse a line of the checklist, i.e. "<digest>  <filepath>", or
+ * "<digest> *<filepath>" which is written by the binary mode of GNU tools.
+ *
+ * @param line the trailing newline has been removed
+ * @return char* the filepath, or NULL if the line is improperly formatted
+ */
+char *parse_checksum_line(char *line)
+{
+    size_t length = get_digest_length();
+    for (size_t idx = 0; idx < length; idx++)
+    {
+        if (!isxdigit((unsigned char)line[idx]))
+        {
+            return NULL;
+        }
+    }
+
+    if (line[length] != ' ' || (line[length + 1] != ' ' && line[length + 1] != '*') ||
+        line[length + 2] == '\0')
+    {
+        return NULL;
+    }
+
+    return line + length + 2;
+}
+
+/**
+ * @brief Read the lines of a checklist into the tasks.
+ *
+ * @param name the applet name
+ * @param filepath "-" for stdin
+ * @param bad_lines the number of the improperly formatted lines
+ * @return bool false if the checklist can not be read, or there is no
+ * properly formatted line
+ */
+bool read_checklist(const char *name, const char *filepath, int *bad_lines)
+{
+    bool is_stdin = (strcmp(filepath, "-") == 0);
+    FILE *file = is_stdin ? stdin : fopen(filepath, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "%s: %s: %s\n", name, filepath, strerror(errno));
+        return false;
+    }
+
+    size_t task_count = checksum_task_count;
+    bool is_ok = true;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, file)) != -1)
+    {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+        {
+            line[--length] = '\0';
+        }
+
+        char *task_filepath = parse_checksum_line(line);
+        if (task_filepath == NULL)
+        {
+            (*bad_lines)++;
+            continue;
+        }
+
+        if (!add_checksum_task(task_filepath, line, line))
+        {
+            perror("realloc");
+            is_ok = false;
+            break;
+        }
+
+        // the line is owned by the task now
+        line = NULL;
+        capacity = 0;
+    }
+
+    free(line);
+
+    if (!is_stdin)
+    {
+        fclose(file);
+    }
+
+    if (is_ok && checksum_task_count == task_count)
+    {
+        fprintf(stderr, "%s: %s: no properly formatted checksum lines found\n", name, filepath);
+        return false;
+    }
+
+    return is_ok;
+}
+
+void print_checksum_usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage:\n"
+            "    %s [-v] [file]...\n"
+            "    %s -c [-q|-s] [-v] [checklist]...\n"
+            "\n"
+            "-c    read the checksums from the checklists and verify them\n"
+            "-q    do not print OK for each successfully verified file\n"
+            "-s    print nothing, the exit status shows the result\n"
+            "-v    print the implementation, i.e. the scalar code or the RISC-V\n"
+            "      extensions (Zbc for CRC32C, Zknh for SHA-256)\n",
+            name, name);
+}
+
+/**
+ * @brief Compute or verify the checksums (SHA-256, CRC32C or XXH64) of the
+ * files, the files are processed by threads in parallel.
+ *
+ * @param argc
+ * @param argv
+ * @param type
+ * @return int
+ */
+int command_checksum(int argc, char **argv, enum ChecksumType type)
+{
+    const char *name = (type == CHECKSUM_SHA256) ? "sha256sum" : (type == CHECKSUM_CRC32C ? "crc32c" : "xxh64");
+    bool is_check = false;
+    bool is_quiet = false;
+    bool is_status = false;
+    bool is_verbose = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "cqsv")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            is_check = true;
+            break;
+        case 'q':
+            is_quiet = true;
+            break;
+        case 's':
+            is_status = true;
+            break;
+        case 'v':
+            is_verbose = true;
+            break;
+        default:
+            print_checksum_usage(name);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((is_quiet || is_status) && !is_check)
+    {
+        print_checksum_usage(name);
+        return EXIT_FAILURE;
+    }
+
+    checksum_type = type;
+
+    // the features must be detected before the threads start
+    unsigned int features = checksum_init();
+    if (is_verbose)
+    {
+        const char *implementation = "the scalar code";
+        if (type == CHECKSUM_SHA256 && (features & CHECKSUM_FEATURE_ZKNH))
+        {
+            implementation = "Zknh";
+        }
+        else if (type == CHECKSUM_CRC32C && (features & CHECKSUM_FEATURE_ZBC))
+        {
+            implementation = "Zbc";
+        }
+        fprintf(stderr, "%s: using %s\n", name, implementation);
+    }
+
+    char *stdin_args[] = {"-"};
+    char **files = (optind < argc) ? argv + optind : stdin_args;
+    int file_count = (optind < argc) ? argc - optind : 1;
+
+    int exit_code = EXIT_SUCCESS;
+    int bad_lines = 0;
+
+    for (int idx = 0; idx < file_count; idx++)
+    {
+        if (!is_check)
+        {
+            if (!add_checksum_task(files[idx], NULL, NULL))
+            {
+                perror("realloc");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!read_checklist(name, files[idx], &bad_lines))
+        {
+            exit_code = EXIT_FAILURE;
+        }
+    }
+
+    run_checksum_tasks();
+
+    int failed = 0;
+    int unreadable = 0;
+
+    for (size_t idx = 0; idx < checksum_task_count; idx++)
+    {
+        struct ChecksumTask *task = &checksum_tasks[idx];
+
+        if (task->error_number != 0)
+        {
+            fprintf(stderr, "%s: %s: %s\n", name, task->filepath, strerror(task->error_number));
+            if (is_check && !is_status)
+            {
+                printf("%s: FAILED open or read\n", task->filepath);
+            }
+            unreadable++;
+        }
+        else if (!is_check)
+        {
+            printf("%s  %s\n", task->digest, task->filepath);
+        }
+        else if (strcmp(task->digest, task->expected) != 0)
+        {
+            if (!is_status)
+            {
+                printf("%s: FAILED\n", task->filepath);
+            }
+            failed++;
+        }
+        else if (!is_quiet && !is_status)
+        {
+            printf("%s: OK\n", task->filepath);
+        }
+
+        free(task->line);
+    }
+
+    free(checksum_tasks);
+
+    if (!is_status)
+    {
+        fflush(stdout);
+
+        if (bad_lines > 0)
+        {
+            fprintf(stderr, "%s: WARNING: %d line%s improperly formatted\n",
+                    name, bad_lines, bad_lines == 1 ? " is" : "s are");
+        }
+
+        if (is_check && unreadable > 0)
+        {
+            fprintf(stderr, "%s: WARNING: %d listed file%s could not be read\n",
+                    name, unreadable, unreadable == 1 ? "" : "s");
+        }
+
+        if (failed > 0)
+        {
+            fprintf(stderr, "%s: WARNING: %d computed checksum%s did NOT match\n",
+                    name, failed, failed == 1 ? "" : "s");
+        }
+    }
+
+    return (exit_code == EXIT_SUCCESS && failed == 0 && unreadable == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    char *filepath = argv[0];
+    char *command = basename(filepath);
+
+    if (strcmp(command, "applets") == 0)
+    {
+        if (argc == 1)
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+
+        // convert:
+        //
+        // argv[0] argv[1] argv[2] argv[3]
+        // applets command arg0    arg1
+        //
+        //    |
+        //    to
+        //    V
+        //
+        // argv[0]  argv[1] argv[2]
+        // command  arg0    arg1
+
+        argv++;
+        argc--;
+        command = argv[0];
+    }
+
+    if (strcmp(command, "tee") == 0)
+    {
+        if (argc > 2)
+        {
+            fputs("Usage:\n", stderr);
+            fputs("    applets tee\n", stderr);
+            fputs("    applets tee /path/to/name\n", stderr);
+            fputs("or\n", stderr);
+            fputs("    tee\n", stderr);
+            fputs("    tee /path/to/name\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        // usage:
+        //
+        // tee
+        // tee filename
+        return command_tee(argv[1]);
+    }
+    else if (strcmp(command, "tr") == 0)
+    {
+        if (argc != 3)
+        {
+
+            fputs("Usages:\n", stderr);
+            fputs("    applets tr [:upper:] [:lower:]\n", stderr);
+            fputs("    applets tr [:blank:] _\n", stderr);
+            fputs("or\n", stderr);
+            fputs("    tr [:upper:] [:lower:]\n", stderr);
+            fputs("    tr [:blank:] _\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        // usage:
+        //
+        // tr pattern1 pattern2
+        return command_tr(argv[1], argv[2]);
+    }
+    else if (strcmp(command, "uname") == 0)
+    {
+        // usage:
+        //
+        // uname
+        // uname -a[-s,-n,-r,-v,-m]
+        // uname --all[--kernel-name,--nodename,--kernel-release,--kernel-version,--machine]
+        // uname --help[--version]
+        return command_uname(argc, argv);
+    }
+    else if (strcmp(command, "bootchart") == 0)
+    {
+        // usage:
+        //
+        // bootchart
+        // bootchart -r
+        // bootchart /path/to/boottrace
+        bool is_raw = false;
+        char *filepath = BOOTTRACE_FILEPATH;
+
+        for (int i = 1; i < argc; i++)
+        {
+            if (strcmp(argv[i], "-r") == 0)
+            {
+                is_raw = true;
+            }
+            else
+            {
+                filepath = argv[i];
+            }
+        }
+
+        return command_bootchart(filepath, is_raw);
+    }
+    else if (strcmp(command, "cgstat") == 0)
+    {
+        // usage:
+        //
+        // cgstat
+        // cgstat name1 name2 ...
+        return command_cgstat(argc, argv);
+    }
+    else if (strcmp(command, "taskset") == 0)
+    {
+        // usage:
+        //
+        // taskset 3 command args...
+        // taskset -c 0,1 command args...
+        // taskset -p pid
+        // taskset -pc 2-3 pid
+        return command_taskset(argc, argv);
+    }
+    else if (strcmp(command, "chrt") == 0)
+    {
+        // usage:
+        //
+        // chrt -f 50 command args...
+        // chrt -i 0 command args...
+        // chrt -p pid
+        // chrt -r -p 10 pid
+        return command_chrt(argc, argv);
+    }
+    else if (strcmp(command, "ionice") == 0)
+    {
+        // usage:
+        //
+        // ionice -c idle command args...
+        // ionice -c 2 -n 0 command args...
+        // ionice -p pid
+        return command_ionice(argc, argv);
+    }
+    else if (strcmp(command, "wc") == 0)
+    {
+        // usage:
+        //
+        // wc file1 file2 ...
+        // wc -l < file
+        // wc -c file
+        return command_wc(argc, argv);
+    }
+    else if (strcmp(command, "grep") == 0)
+    {
+        // usage:
+        //
+        // grep pattern file1 file2 ...
+        // grep -F -i text < file
+        // grep -c -v '^#' file
+        return command_grep(argc, argv);
+    }
+    else if (strcmp(command, "sort") == 0)
+    {
+        // usage:
+        //
+        // sort file1 file2 ...
+        // sort -n -r < file
+        // sort -t : -k 3,3n /etc/passwd
+        // sort -S 64M -T /var/tmp huge.log
+        return command_sort(argc, argv);
+    }
+    else if (strcmp(command, "xargs") == 0)
+    {
+        // usage:
+        //
+        // find . -name '*.log' | xargs -P 4 -n 16 gzip
+        // ls | xargs -I {} cp {} {}.bak
+        // xargs -0 -P 0 -g sha256sum < list
+        return command_xargs(argc, argv);
+    }
+    else if (strcmp(command, "dd") == 0)
+    {
+        // usage:
+        //
+        // dd if=/dev/zero of=/tmp/test bs=1M count=256 conv=fsync
+        // dd if=/tmp/test of=/dev/null bs=4K iflag=direct status=progress
+        // dd if=/tmp/a of=/tmp/b bs=1M mode=copy
+        return command_dd(argc, argv);
+    }
+    else if (strcmp(command, "sha256sum") == 0)
+    {
+        // usage:
+        //
+        // sha256sum file1 file2 ... > SHA256SUMS
+        // sha256sum -c SHA256SUMS
+        return command_checksum(argc, argv, CHECKSUM_SHA256);
+    }
+    else if (strcmp(command, "crc32c") == 0)
+    {
+        // usage:
+        //
+        // crc32c file1 file2 ... > CRC32C
+        // crc32c -c -q CRC32C
+        return command_checksum(argc, argv, CHECKSUM_CRC32C);
+    }
+    else if (strcmp(command, "xxh64") == 0)
+    {
+        // usage:
+        //
+        // xxh64 file1 file2 ... > XXH64SUMS
+        // xxh64 -c -s XXH64SUMS
+        return command_checksum(argc, argv, CHECKSUM_XXH64);
     }
     else
     {
@@ -8,6 +8,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "lib/ioengine.h"
 
 int main(int argc, char **argv)
 {
@@ -18,42 +23,59 @@ int main(int argc, char **argv)
     // cat filename
     // cat file1 file2 ...
 
-    const int BUF_SIZE = 4096;
-    char buf[BUF_SIZE];
-    size_t bytes_read;
+    struct IoEngine engine;
+    if (!ioengine_init(&engine, 0, 0))
+    {
+        perror("ioengine_init");
+        return EXIT_FAILURE;
+    }
+
+    int out_fd = STDOUT_FILENO;
+    int exit_code = EXIT_SUCCESS;
 
     argv++; // argv[0] is the command line
 
     if (*argv == NULL)
     {
         // read from stdin
-        while ((bytes_read = fread(buf, 1, BUF_SIZE, stdin)) > 0)
+        int error_number = ioengine_copy(&engine, STDIN_FILENO, &out_fd, 1, NULL, NULL);
+        if (error_number != 0)
         {
-            fwrite(buf, 1, bytes_read, stdout);
+            fprintf(stderr, "cat: %s: %s\n",
+                    engine.error_fd == STDIN_FILENO ? "stdin" : "stdout",
+                    strerror(error_number));
+            exit_code = EXIT_FAILURE;
         }
     }
     else
     {
         while (*argv != NULL)
         {
-            FILE *file = fopen(*argv, "r");
-            if (file == NULL)
+            int fd = open(*argv, O_RDONLY);
+            if (fd == -1)
             {
-                perror("fopen");
-                return EXIT_FAILURE;
+                perror("open");
+                exit_code = EXIT_FAILURE;
+                break;
             }
 
-            while ((bytes_read = fread(buf, 1, BUF_SIZE, file)) > 0)
+            int error_number = ioengine_copy(&engine, fd, &out_fd, 1, NULL, NULL);
+            close(fd);
+
+            if (error_number != 0)
             {
-                fwrite(buf, 1, bytes_read, stdout);
+                fprintf(stderr, "cat: %s: %s\n",
+                        engine.error_fd == fd ? *argv : "stdout",
+                        strerror(error_number));
+                exit_code = EXIT_FAILURE;
+                break;
             }
 
-            fclose(file);
-
             // next file
             argv++;
         }
     }
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    ioengine_destroy(&engine);
+    return exit_code;
+}
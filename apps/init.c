@@ -6,9 +6,9 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
-// enable "XPG7"
+// enable "XPG7" and the GNU extensions, e.g. `syncfs()`
 // /usr/include/features.h
-#define _XOPEN_SOURCE 700
+#define _GNU_SOURCE
 
 // REF::
 // https://gist.github.com/rofl0r/6168719
@@ -19,61 +19,1510 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
 #include <wait.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <sys/epoll.h>
+#include <sys/mount.h>
+#include <sys/reboot.h>
+#include <sys/resource.h>
+
+#include "lib/boottrace.h"
+#include "lib/schedutil.h"
+#include "lib/mountinfo.h"
+
+// services are declared by files `/etc/init.d/*.svc`, one service per file,
+// each line is a `key=value` pair, lines start with '#' are comments.
+//
+// e.g. `/etc/init.d/shell.svc`
+//
+//     # start an interactive shell
+//     type=simple
+//     after=mount
+//     cwd=/root
+//     exec=/bin/sh
+//
+// keys:
+// - exec:  the command line, arguments are separated by spaces.
+// - type:  `oneshot` (default), the service is ready when the process exits successfully;
+//          `simple`, the service is ready once the program has been executed.
+// - after: names (the file name without `.svc`) of the services that must be ready
+//          before this service starts, separated by spaces or commas.
+// - cwd:   the working directory, default is `/`.
+// - interactive: `yes` if the service is the interactive shell, the execution of
+//          the program is recorded as the handoff to the shell, default is `no`.
+// - restart: `no` (default), `always` or `on-failure`, restart the service when its
+//          process exits. the successful exit of a oneshot service is never restarted.
+//          the delay before restarting is doubled on every consecutive restart
+//          (100 ms to 30 s) and is reset when the process has run for 10 s.
+// - restart_burst, restart_interval: give up restarting when the service has been
+//          restarted `restart_burst` times (default 5) in `restart_interval`
+//          seconds (default 60).
+// - stop_timeout: the seconds to wait for the service to exit after SIGTERM is sent
+//          on shutdown, then SIGKILL is sent, default is 3.
+// - cpu.*, memory.*, io.*, pids.*: the cgroup v2 interface files (e.g. `cpu.max`,
+//          `cpu.weight`, `memory.max`, `memory.high` and `io.max`), the value is
+//          written into the file of the service's cgroup.
+//
+// e.g.
+//
+//     cpu.max=50000 100000
+//     memory.high=128M
+//     io.max=254:0 rbps=10485760 wbps=10485760
+//
+// - cpu_affinity: the CPUs the service runs on, e.g. `1-3` or `0,2`.
+// - nice:  the nice value, from -20 (the highest priority) to 19.
+// - sched_policy: `other` (default), `batch`, `idle`, `fifo` or `rr`.
+// - sched_priority: the static priority of `fifo` and `rr`, from 1 (default) to 99.
+// - ioprio: the I/O scheduling class and level, `rt:N`, `be:N` (N is from 0
+//          (the highest) to 7) or `idle`.
+//
+// e.g. keep a latency critical service away from CPU 0 where the console and
+// the housekeeping processes run:
+//
+//     cpu_affinity=1-3
+//     sched_policy=fifo
+//     sched_priority=50
+//     ioprio=rt:2
+//
+// services without dependency between them are started concurrently, the number
+// of oneshot services running at the same time is limited to the number of CPUs.
+//
+// when there is no service file, the script `/etc/rc` is executed instead.
+//
+// the system is shut down by sending signals to `init` (e.g. by the command `poweroff`):
+// - SIGUSR1: halt
+// - SIGUSR2: power off
+// - SIGTERM, SIGINT (Ctrl+Alt+Del): reboot
+//
+// the services are sent SIGTERM in the reverse dependency order, i.e. a service is
+// stopped after all services which depend on it have exited, independent services
+// are stopped in parallel. then the remaining processes are sent SIGTERM and SIGKILL,
+// each mounted filesystem is synchronized and lazily unmounted in the reverse
+// mount order before the system is rebooted.
+//
+// each service runs in its own cgroup `/sys/fs/cgroup/SERVICE_NAME`, the cgroup2
+// filesystem is mounted once `/sys` is mounted, and the services started before
+// are moved into their cgroups then. run the applet `cgstat` to show the usage.
+//
+// the timestamps of the boot steps are recorded into the ring `/run/boottrace`,
+// run the applet `bootchart` to print the timeline. the records are kept in
+// memory until `/run` is mounted (or all services have been started).
+//
+// the boot benchmark is enabled by the kernel argument `initbench=1` (the
+// unknown arguments of the kernel are passed to `init` as the environment
+// variables), the boot steps are printed to the console as
+// `initbench: STEP SECONDS`, where the seconds are CLOCK_BOOTTIME, i.e. since
+// the kernel started, and the steps are:
+// - init:    the `init` process started.
+// - rc-done: all services except the interactive ones have been started (or
+//            the script `/etc/rc` exited).
+// - shell:   the interactive shell was executed.
+// the system is powered off once all steps are printed, check the script
+// `bench-qemu-initramfs.sh`.
+
+#define SERVICE_DIRECTORY "/etc/init.d"
+#define SERVICE_SUFFIX ".svc"
+#define RC_SCRIPT "/etc/rc"
+
+#define MAX_SERVICES 64
+#define MAX_ARGS 64
+#define MAX_DEPENDENCIES 16
+#define MAX_NAME_LENGTH 64
+#define MAX_PATH_LENGTH 1024
+#define MAX_EVENTS 16
+
+#define RESTART_DELAY_MIN_MS 100
+#define RESTART_DELAY_MAX_MS 30000
+#define RESTART_STABLE_MS 10000
+#define DEFAULT_RESTART_BURST 5
+#define DEFAULT_RESTART_INTERVAL_MS 60000
+#define DEFAULT_STOP_TIMEOUT_MS 3000
+#define KILL_TIMEOUT_MS 1000
+#define PROCESS_STOP_TIMEOUT_MS 1000
+#define MAX_CGROUP_SETTINGS 16
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+
+enum ServiceType
+{
+    SERVICE_ONESHOT,
+    SERVICE_SIMPLE
+};
+
+enum ServiceRestart
+{
+    RESTART_NO,
+    RESTART_ALWAYS,
+    RESTART_ON_FAILURE
+};
+
+enum ServiceState
+{
+    STATE_WAITING,    // waiting for the dependencies
+    STATE_STARTING,   // the process is forked, waiting for the program to be executed
+    STATE_RUNNING,    // the oneshot program is running
+    STATE_READY,      // the dependents can be started
+    STATE_EXITED,     // the simple program has exited
+    STATE_RESTARTING, // waiting for the restart delay
+    STATE_FAILED,     // failed to start, or exited unsuccessfully, or a dependency failed
+    STATE_STOPPED     // stopped on shutdown
+};
+
+enum ShutdownPhase
+{
+    SHUTDOWN_NONE,
+    SHUTDOWN_SERVICES,  // stopping the services in the reverse dependency order
+    SHUTDOWN_PROCESSES, // SIGTERM has been sent to all remaining processes
+    SHUTDOWN_KILL       // SIGKILL has been sent to all remaining processes
+};
+
+struct Service
+{
+    char name[MAX_NAME_LENGTH];
+    enum ServiceType type;
+    enum ServiceState state;
+    pid_t pid;
+    bool is_interactive;
+
+    int exec_status_fd;  // the read port of the pipe which reports the result of `execve`
+    bool is_exec_failed; //
+
+    enum ServiceRestart restart;
+    int restart_burst;
+    uint64_t restart_interval_ms;
+    int restarts;                // the total number of restarts
+    int window_restarts;         // the number of restarts in the current rate limit window
+    uint64_t window_start_ms;    //
+    uint64_t restart_delay_ms;   // the current backoff delay
+    uint64_t restart_at_ms;      // CLOCK_MONOTONIC
+    uint64_t started_ms;         //
+
+    uint64_t stop_timeout_ms;
+    uint64_t stop_deadline_ms; // 0 for SIGTERM has not been sent
+    bool is_killed;            // SIGKILL has been sent
+
+    char *cgroup_keys[MAX_CGROUP_SETTINGS]; // the names of the cgroup interface files
+    char *cgroup_values[MAX_CGROUP_SETTINGS];
+    int number_of_cgroup_settings;
+    bool has_cgroup; // the cgroup has been created
+
+    bool has_cpu_affinity;
+    cpu_set_t cpu_affinity;
+    bool has_nice;
+    int nice;
+    bool has_sched_policy;
+    int sched_policy;   // SCHED_*
+    int sched_priority; //
+    bool has_ioprio;
+    int ioprio;
+
+    char *command;        // the value of `exec`, `argv` points into it
+    char *argv[MAX_ARGS]; // NULL terminated
+    char *cwd;            // NULL for "/"
+
+    char *after;                            // the value of `after`, the names point into it
+    char *after_names[MAX_DEPENDENCIES];    //
+    int dependencies[MAX_DEPENDENCIES];     // index of the dependent services
+    int number_of_dependencies;
+};
+
+struct Service services[MAX_SERVICES];
+int number_of_services = 0;
+
+// the maximum number of oneshot services running at the same time
+int max_running_services = 1;
+
+int epoll_fd = -1;
+int signal_fd = -1;
+
+enum ShutdownPhase shutdown_phase = SHUTDOWN_NONE;
+int shutdown_command = RB_POWER_OFF; // the argument of `reboot()`
+uint64_t shutdown_deadline_ms = 0;   // the deadline of the current phase
+bool has_children = true;            // updated by `reap_children()`
+
+bool is_cgroup_ready = false;       // cgroup2 is mounted on `/sys/fs/cgroup`
+bool is_cgroup_unavailable = false; // failed to mount cgroup2
+
+// the boot trace, it is allocated in memory first, and then is moved
+// into the file `/run/boottrace` (i.e. memory mapped) once `/run` is available.
+struct BootTraceHeader *trace = NULL;
+size_t trace_size = 0;
+bool is_trace_attached = false;
+bool is_boot_done = false;
+
+// the boot benchmark, check the comments above
+bool is_bench = false;
+bool is_bench_rc_done = false;
+bool is_bench_shell = false;
+
+extern char **environ;
+
+char *envp[] = {"USER=root",
+                "HOME=/root",
+                "SHELL=/bin/sh",
+                "PWD=/",
+                "PATH=/bin:/sbin:/usr/bin:/usr/sbin",
+                NULL};
+
+// functions prototypes
+
+int load_services(void);
+bool load_service(struct Service *, char *);
+void free_service(struct Service *);
+void resolve_dependencies(void);
+void start_services(void);
+bool start_service(struct Service *);
+void handle_signals(void);
+void reap_children(void);
+void handle_exec_status(struct Service *);
+void handle_exit(pid_t, int);
+bool schedule_restart(struct Service *);
+int get_timeout(void);
+void restart_services(void);
+bool is_services_started(bool);
+void check_boot_done(void);
+void begin_shutdown(int);
+void stop_services(void);
+void finish_shutdown(void);
+void unmount_all(void);
+pid_t spawn(struct Service *, int *);
+void setup_process(struct Service *);
+bool setup_cgroup_root(void);
+bool create_cgroup(struct Service *);
+bool write_file(const char *, const char *);
+uint64_t get_clock_ns(clockid_t);
+uint64_t get_clock_ms(void);
+void trace_open(void);
+void trace_attach(bool);
+void trace_event(enum BootTraceEvent, const char *, pid_t, int);
+void bench_mark(const char *);
+char *trim_inplace(char *);
 
 int main(void)
 {
 
-    // the `init` process is launched directly by the kernel,
-    // the value of PID should be 1.
-    // check APUE chapter 8.2
-    if (getpid() != 1)
+    // the `init` process is launched directly by the kernel,
+    // the value of PID should be 1.
+    // check APUE chapter 8.2
+    if (getpid() != 1)
+    {
+        // this process is launched incorrectly.
+        return EXIT_FAILURE;
+    }
+
+    // the `init` process should not be killed or stoped,
+    // so block all signal.
+    sigset_t set;
+    sigfillset(&set);
+    sigprocmask(SIG_BLOCK, &set, NULL);
+
+    // the signals are received through a file descriptor instead of the
+    // signal handlers, so the main loop waits for the signals and the
+    // pipes of the starting services in one `epoll_wait()`.
+    // check _The Linux Programming Interface_ section 22.11 and 63.4
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+
+    // let the kernel send SIGINT to `init` when Ctrl+Alt+Del is pressed,
+    // instead of rebooting immediately.
+    reboot(RB_DISABLE_CAD);
+
+    signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (signal_fd == -1 || epoll_fd == -1)
+    {
+        perror("init");
+        exit(EXIT_FAILURE);
+    }
+
+    // the `data.ptr` is the service for the pipes, and NULL for the signals.
+    struct epoll_event signal_event = {.events = EPOLLIN, .data.ptr = NULL};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &signal_event);
+
+    trace_open();
+    trace_event(BOOTTRACE_INIT, "init", 1, 0);
+
+    const char *bench = getenv("initbench");
+    is_bench = (bench != NULL && strcmp(bench, "1") == 0);
+    bench_mark("init");
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_running_services = cpus > 0 ? cpus : 1;
+
+    if (load_services() > 0)
+    {
+        resolve_dependencies();
+        start_services();
+        check_boot_done();
+    }
+    else
+    {
+        // execute the script
+        struct Service *rc = &services[0];
+        memset(rc, 0, sizeof(*rc));
+        strcpy(rc->name, "rc");
+        rc->argv[0] = RC_SCRIPT;
+
+        rc->pid = spawn(rc, NULL);
+        if (rc->pid == -1)
+        {
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+
+    while (true)
+    {
+        // wait for the signals, the results of `execve` and
+        // the next restart or stop deadline of services.
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, get_timeout());
+        if (count == -1 && errno != EINTR)
+        {
+            perror("epoll_wait");
+        }
+
+        for (int idx = 0; idx < count; idx++)
+        {
+            if (events[idx].data.ptr == NULL)
+            {
+                handle_signals();
+            }
+            else
+            {
+                handle_exec_status(events[idx].data.ptr);
+            }
+        }
+
+        if (shutdown_phase != SHUTDOWN_NONE)
+        {
+            stop_services();
+            continue;
+        }
+
+        restart_services();
+        start_services();
+        check_boot_done();
+    }
+
+    // parent process wouldn't stop until system shut down
+}
+
+int compare_names(const struct dirent **left, const struct dirent **right)
+{
+    return strcmp((*left)->d_name, (*right)->d_name);
+}
+
+int filter_service_file(const struct dirent *entry)
+{
+    size_t name_length = strlen(entry->d_name);
+    size_t suffix_length = strlen(SERVICE_SUFFIX);
+
+    return entry->d_name[0] != '.' &&
+           name_length > suffix_length &&
+           name_length - suffix_length < MAX_NAME_LENGTH &&
+           strcmp(entry->d_name + name_length - suffix_length, SERVICE_SUFFIX) == 0;
+}
+
+/**
+ * @brief Load all service files, the services are sorted by name.
+ *
+ * @return int the number of services
+ */
+int load_services(void)
+{
+    struct dirent **entries;
+    int count = scandir(SERVICE_DIRECTORY, &entries, filter_service_file, compare_names);
+    if (count == -1)
+    {
+        // the service directory is optional
+        return 0;
+    }
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        if (number_of_services == MAX_SERVICES)
+        {
+            fprintf(stderr, "init: too many services, %s is ignored\n", entries[idx]->d_name);
+        }
+        else if (load_service(&services[number_of_services], entries[idx]->d_name))
+        {
+            number_of_services++;
+        }
+
+        free(entries[idx]);
+    }
+
+    free(entries);
+    return number_of_services;
+}
+
+bool load_service(struct Service *service, char *filename)
+{
+    char filepath[MAX_PATH_LENGTH];
+    snprintf(filepath, sizeof(filepath), "%s/%s", SERVICE_DIRECTORY, filename);
+
+    FILE *file = fopen(filepath, "r");
+    if (file == NULL)
+    {
+        perror("fopen");
+        return false;
+    }
+
+    memset(service, 0, sizeof(*service));
+    size_t name_length = strlen(filename) - strlen(SERVICE_SUFFIX);
+    memcpy(service->name, filename, name_length);
+    service->type = SERVICE_ONESHOT;
+    service->state = STATE_WAITING;
+    service->exec_status_fd = -1;
+    service->restart = RESTART_NO;
+    service->restart_burst = DEFAULT_RESTART_BURST;
+    service->restart_interval_ms = DEFAULT_RESTART_INTERVAL_MS;
+    service->stop_timeout_ms = DEFAULT_STOP_TIMEOUT_MS;
+
+    char *line = NULL;
+    size_t len = 0;
+
+    while (getline(&line, &len, file) != -1)
+    {
+        char *text = trim_inplace(line);
+        if (text[0] == '#' || text[0] == '\0')
+        {
+            continue;
+        }
+
+        char *value = strchr(text, '=');
+        if (value == NULL)
+        {
+            fprintf(stderr, "init: %s: invalid line \"%s\"\n", filepath, text);
+            continue;
+        }
+
+        *value = '\0';
+        char *key = trim_inplace(text);
+        value = trim_inplace(value + 1);
+
+        if (strcmp(key, "exec") == 0)
+        {
+            free(service->command);
+            service->command = strdup(value);
+        }
+        else if (strcmp(key, "type") == 0)
+        {
+            if (strcmp(value, "oneshot") == 0)
+            {
+                service->type = SERVICE_ONESHOT;
+            }
+            else if (strcmp(value, "simple") == 0)
+            {
+                service->type = SERVICE_SIMPLE;
+            }
+            else
+            {
+                fprintf(stderr, "init: %s: unknown type \"%s\"\n", filepath, value);
+            }
+        }
+        else if (strcmp(key, "after") == 0)
+        {
+            free(service->after);
+            service->after = strdup(value);
+        }
+        else if (strcmp(key, "cwd") == 0)
+        {
+            free(service->cwd);
+            service->cwd = strdup(value);
+        }
+        else if (strcmp(key, "interactive") == 0)
+        {
+            service->is_interactive = (strcmp(value, "yes") == 0);
+        }
+        else if (strcmp(key, "restart") == 0)
+        {
+            if (strcmp(value, "no") == 0)
+            {
+                service->restart = RESTART_NO;
+            }
+            else if (strcmp(value, "always") == 0)
+            {
+                service->restart = RESTART_ALWAYS;
+            }
+            else if (strcmp(value, "on-failure") == 0)
+            {
+                service->restart = RESTART_ON_FAILURE;
+            }
+            else
+            {
+                fprintf(stderr, "init: %s: unknown restart \"%s\"\n", filepath, value);
+            }
+        }
+        else if (strcmp(key, "restart_burst") == 0)
+        {
+            service->restart_burst = atoi(value);
+        }
+        else if (strcmp(key, "restart_interval") == 0)
+        {
+            service->restart_interval_ms = strtod(value, NULL) * 1000;
+        }
+        else if (strcmp(key, "stop_timeout") == 0)
+        {
+            service->stop_timeout_ms = strtod(value, NULL) * 1000;
+        }
+        else if (strncmp(key, "cpu.", 4) == 0 ||
+                 strncmp(key, "memory.", 7) == 0 ||
+                 strncmp(key, "io.", 3) == 0 ||
+                 strncmp(key, "pids.", 5) == 0)
+        {
+            if (strchr(key, '/') != NULL ||
+                service->number_of_cgroup_settings == MAX_CGROUP_SETTINGS)
+            {
+                fprintf(stderr, "init: %s: cgroup setting \"%s\" is ignored\n", filepath, key);
+                continue;
+            }
+
+            service->cgroup_keys[service->number_of_cgroup_settings] = strdup(key);
+            service->cgroup_values[service->number_of_cgroup_settings] = strdup(value);
+            service->number_of_cgroup_settings++;
+        }
+        else if (strcmp(key, "cpu_affinity") == 0)
+        {
+            service->has_cpu_affinity = parse_cpu_list(value, &service->cpu_affinity);
+            if (!service->has_cpu_affinity)
+            {
+                fprintf(stderr, "init: %s: invalid cpu_affinity \"%s\"\n", filepath, value);
+            }
+        }
+        else if (strcmp(key, "nice") == 0)
+        {
+            service->has_nice = true;
+            service->nice = atoi(value);
+        }
+        else if (strcmp(key, "sched_policy") == 0)
+        {
+            int policy = parse_sched_policy(value);
+            if (policy == -1)
+            {
+                fprintf(stderr, "init: %s: unknown sched_policy \"%s\"\n", filepath, value);
+                continue;
+            }
+
+            service->has_sched_policy = true;
+            service->sched_policy = policy;
+        }
+        else if (strcmp(key, "sched_priority") == 0)
+        {
+            service->sched_priority = atoi(value);
+        }
+        else if (strcmp(key, "ioprio") == 0)
+        {
+            int ioprio = parse_ioprio(value);
+            if (ioprio == -1)
+            {
+                fprintf(stderr, "init: %s: invalid ioprio \"%s\"\n", filepath, value);
+                continue;
+            }
+
+            service->has_ioprio = true;
+            service->ioprio = ioprio;
+        }
+        else
+        {
+            fprintf(stderr, "init: %s: unknown key \"%s\"\n", filepath, key);
+        }
+    }
+
+    free(line);
+    fclose(file);
+
+    if (service->command == NULL)
+    {
+        fprintf(stderr, "init: %s: missing \"exec\"\n", filepath);
+        free_service(service);
+        return false;
+    }
+
+    // split the command line into arguments
+    const char *DELIMITERS = " \t";
+    int count = 0;
+    char *token = strtok(service->command, DELIMITERS);
+    while (token != NULL && count < MAX_ARGS - 1)
+    {
+        service->argv[count] = token;
+        count++;
+        token = strtok(NULL, DELIMITERS);
+    }
+
+    // set NULL terminate
+    service->argv[count] = NULL;
+
+    if (count == 0)
+    {
+        fprintf(stderr, "init: %s: empty \"exec\"\n", filepath);
+        free_service(service);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Free the strings of the service which is not loaded.
+ *
+ * @param service
+ */
+void free_service(struct Service *service)
+{
+    free(service->command);
+    free(service->after);
+    free(service->cwd);
+
+    for (int idx = 0; idx < service->number_of_cgroup_settings; idx++)
+    {
+        free(service->cgroup_keys[idx]);
+        free(service->cgroup_values[idx]);
+    }
+    service->number_of_cgroup_settings = 0;
+}
+
+int find_service(const char *name)
+{
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        if (strcmp(services[idx].name, name) == 0)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Convert the `after` names of every service into service indices.
+ */
+void resolve_dependencies(void)
+{
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        if (service->after == NULL)
+        {
+            continue;
+        }
+
+        const char *DELIMITERS = " \t,";
+        char *token = strtok(service->after, DELIMITERS);
+        while (token != NULL)
+        {
+            int dependency = find_service(token);
+            if (dependency == -1)
+            {
+                fprintf(stderr, "init: %s: unknown dependency \"%s\" is ignored\n",
+                        service->name, token);
+            }
+            else if (service->number_of_dependencies == MAX_DEPENDENCIES)
+            {
+                fprintf(stderr, "init: %s: too many dependencies, \"%s\" is ignored\n",
+                        service->name, token);
+            }
+            else
+            {
+                service->after_names[service->number_of_dependencies] = token;
+                service->dependencies[service->number_of_dependencies] = dependency;
+                service->number_of_dependencies++;
+            }
+
+            token = strtok(NULL, DELIMITERS);
+        }
+    }
+}
+
+/**
+ * @brief Start every waiting service whose dependencies are all ready,
+ * until the limit of running services is reached.
+ */
+void start_services(void)
+{
+    bool has_progress = true;
+
+    // a failed service makes its dependents fail, which may
+    // affect their dependents, so repeat until nothing changes.
+    while (has_progress)
+    {
+        has_progress = false;
+
+        // the number of running oneshot services
+        int running = 0;
+
+        // the number of services which will change their states later
+        int pending = 0;
+
+        for (int idx = 0; idx < number_of_services; idx++)
+        {
+            enum ServiceState state = services[idx].state;
+            if (state == STATE_STARTING || state == STATE_RUNNING || state == STATE_RESTARTING)
+            {
+                pending++;
+
+                if (services[idx].type == SERVICE_ONESHOT && state != STATE_RESTARTING)
+                {
+                    running++;
+                }
+            }
+        }
+
+        for (int idx = 0; idx < number_of_services; idx++)
+        {
+            struct Service *service = &services[idx];
+            if (service->state != STATE_WAITING)
+            {
+                continue;
+            }
+
+            bool is_blocked = false;
+            bool is_failed = false;
+
+            for (int dep = 0; dep < service->number_of_dependencies; dep++)
+            {
+                enum ServiceState state = services[service->dependencies[dep]].state;
+                if (state == STATE_FAILED)
+                {
+                    fprintf(stderr, "init: %s: dependency \"%s\" failed, skipped\n",
+                            service->name, service->after_names[dep]);
+                    trace_event(BOOTTRACE_FAIL, service->name, 0, 0);
+                    is_failed = true;
+                    break;
+                }
+                else if (state != STATE_READY && state != STATE_EXITED)
+                {
+                    is_blocked = true;
+                }
+            }
+
+            if (is_failed)
+            {
+                service->state = STATE_FAILED;
+                has_progress = true;
+                continue;
+            }
+
+            if (is_blocked)
+            {
+                continue;
+            }
+
+            if (service->type == SERVICE_ONESHOT && running >= max_running_services)
+            {
+                // no free slot, wait for a running service to exit
+                continue;
+            }
+
+            if (start_service(service))
+            {
+                pending++;
+
+                if (service->type == SERVICE_ONESHOT)
+                {
+                    running++;
+                }
+            }
+
+            has_progress = true;
+        }
+
+        if (!has_progress && pending == 0)
+        {
+            // nothing is running and nothing can be started,
+            // the remaining waiting services depend on each other.
+            for (int idx = 0; idx < number_of_services; idx++)
+            {
+                if (services[idx].state == STATE_WAITING)
+                {
+                    fprintf(stderr, "init: %s: dependency cycle, skipped\n", services[idx].name);
+                    trace_event(BOOTTRACE_FAIL, services[idx].name, 0, 0);
+                    services[idx].state = STATE_FAILED;
+                }
+            }
+        }
+    }
+}
+
+bool start_service(struct Service *service)
+{
+    if (setup_cgroup_root())
+    {
+        create_cgroup(service);
+    }
+
+    int exec_status_fd = -1;
+    pid_t pid = spawn(service, &exec_status_fd);
+
+    if (pid == -1)
+    {
+        trace_event(BOOTTRACE_FAIL, service->name, 0, 0);
+        service->state = STATE_FAILED;
+        return false;
+    }
+
+    service->pid = pid;
+    service->state = STATE_STARTING;
+    service->started_ms = get_clock_ms();
+    service->is_exec_failed = false;
+    service->exec_status_fd = exec_status_fd;
+
+    // the pipe becomes readable when the program is executed (EOF)
+    // or failed to execute (the error number).
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = service};
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, exec_status_fd, &event);
+
+    return true;
+}
+
+void handle_signals(void)
+{
+    struct signalfd_siginfo infos[MAX_EVENTS];
+    bool has_child_signal = false;
+
+    while (true)
+    {
+        ssize_t bytes_read = read(signal_fd, infos, sizeof(infos));
+        if (bytes_read <= 0)
+        {
+            // EAGAIN, all pending signals are consumed
+            break;
+        }
+
+        int count = bytes_read / sizeof(struct signalfd_siginfo);
+        for (int idx = 0; idx < count; idx++)
+        {
+            switch (infos[idx].ssi_signo)
+            {
+            case SIGCHLD:
+                has_child_signal = true;
+                break;
+            case SIGUSR1:
+                begin_shutdown(RB_HALT_SYSTEM);
+                break;
+            case SIGUSR2:
+                begin_shutdown(RB_POWER_OFF);
+                break;
+            case SIGTERM:
+            case SIGINT:
+                begin_shutdown(RB_AUTOBOOT);
+                break;
+            }
+        }
+    }
+
+    if (has_child_signal)
+    {
+        reap_children();
+    }
+}
+
+/**
+ * @brief Reap all exited child processes.
+ */
+void reap_children(void)
+{
+    // the SIGCHLD signals of the processes which exit at the same time
+    // are merged into one, so reap them in a batch until there is
+    // no more exited child.
+    //
+    // note that the _child processes_ includes the services which
+    // are started directly by the `init` process, and all other
+    // processes that have lose their parents, i.e. orphan processes.
+    // check APUE chapter 9.10
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        handle_exit(pid, status);
+    }
+
+    // `waitpid()` returns 0 when there are child processes but none has exited,
+    // and returns -1 (ECHILD) when there is no child process.
+    has_children = (pid == 0);
+}
+
+/**
+ * @brief Read the result of `execve` from the pipe of a starting service.
+ *
+ * @param service
+ */
+void handle_exec_status(struct Service *service)
+{
+    if (service->exec_status_fd == -1)
+    {
+        return;
+    }
+
+    int error_number = 0;
+    ssize_t bytes_read = read(service->exec_status_fd, &error_number, sizeof(error_number));
+    if (bytes_read == -1 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+
+    // closing the file descriptor also removes it from epoll
+    close(service->exec_status_fd);
+    service->exec_status_fd = -1;
+
+    // `read` returns 0 (EOF) when the program is executed successfully.
+    if (bytes_read == sizeof(error_number))
+    {
+        fprintf(stderr, "init: %s: failed to execute %s: %s\n",
+                service->name, service->argv[0], strerror(error_number));
+
+        // the state is updated when the process is reaped
+        service->is_exec_failed = true;
+        return;
+    }
+
+    trace_event(BOOTTRACE_EXEC, service->name, service->pid, 0);
+
+    if (service->is_interactive)
+    {
+        trace_event(BOOTTRACE_SHELL, service->name, service->pid, 0);
+        bench_mark("shell");
+    }
+
+    if (service->type == SERVICE_ONESHOT)
+    {
+        service->state = STATE_RUNNING;
+    }
+    else
+    {
+        trace_event(BOOTTRACE_READY, service->name, service->pid, 0);
+        service->state = STATE_READY;
+    }
+}
+
+/**
+ * @brief Update the state of the service which the exited process belongs to.
+ *
+ * @param pid the exited process, may be an orphan process
+ * @param status
+ */
+void handle_exit(pid_t pid, int status)
+{
+    if (number_of_services == 0 && pid == services[0].pid)
+    {
+        // the script `/etc/rc`
+        bench_mark("rc-done");
+        return;
+    }
+
+    struct Service *service = NULL;
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        if (services[idx].pid == pid)
+        {
+            service = &services[idx];
+            break;
+        }
+    }
+
+    if (service == NULL)
+    {
+        // the exit status of orphan processes makes no sense for
+        // the init process, just discard it.
+        return;
+    }
+
+    // the process may exit before the result of `execve` is handled
+    handle_exec_status(service);
+
+    service->pid = 0;
+    trace_event(BOOTTRACE_EXIT, service->name, pid, status);
+
+    bool is_success = !service->is_exec_failed &&
+                      WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    if (!service->is_exec_failed)
+    {
+        if (WIFSIGNALED(status))
+        {
+            fprintf(stderr, "init: %s: killed by signal %d\n", service->name, WTERMSIG(status));
+        }
+        else if (!is_success || service->type == SERVICE_SIMPLE)
+        {
+            fprintf(stderr, "init: %s: exited with status %d\n", service->name, WEXITSTATUS(status));
+        }
+    }
+
+    if (shutdown_phase != SHUTDOWN_NONE)
+    {
+        service->state = STATE_STOPPED;
+        return;
+    }
+
+    if (service->type == SERVICE_ONESHOT && is_success)
+    {
+        trace_event(BOOTTRACE_READY, service->name, pid, 0);
+        service->state = STATE_READY;
+        return;
+    }
+
+    bool is_restart = (service->restart == RESTART_ALWAYS) ||
+                      (service->restart == RESTART_ON_FAILURE && !is_success);
+
+    if (is_restart && schedule_restart(service))
+    {
+        return;
+    }
+
+    if (service->state == STATE_READY)
+    {
+        service->state = STATE_EXITED;
+    }
+    else
+    {
+        trace_event(BOOTTRACE_FAIL, service->name, pid, status);
+        service->state = STATE_FAILED;
+    }
+}
+
+/**
+ * @brief Schedule the restart of the exited service with an exponential backoff delay.
+ *
+ * @param service
+ * @return bool false if the service has been restarted too often
+ */
+bool schedule_restart(struct Service *service)
+{
+    uint64_t now_ms = get_clock_ms();
+
+    if (now_ms - service->window_start_ms >= service->restart_interval_ms)
+    {
+        service->window_start_ms = now_ms;
+        service->window_restarts = 0;
+    }
+
+    if (service->window_restarts >= service->restart_burst)
+    {
+        fprintf(stderr, "init: %s: restarted too often, given up\n", service->name);
+        return false;
+    }
+
+    if (now_ms - service->started_ms >= RESTART_STABLE_MS)
+    {
+        // the process had been running stably
+        service->restart_delay_ms = 0;
+    }
+
+    if (service->restart_delay_ms == 0)
+    {
+        service->restart_delay_ms = RESTART_DELAY_MIN_MS;
+    }
+    else if (service->restart_delay_ms * 2 <= RESTART_DELAY_MAX_MS)
+    {
+        service->restart_delay_ms *= 2;
+    }
+    else
+    {
+        service->restart_delay_ms = RESTART_DELAY_MAX_MS;
+    }
+
+    service->window_restarts++;
+    service->restarts++;
+    service->restart_at_ms = now_ms + service->restart_delay_ms;
+    service->state = STATE_RESTARTING;
+
+    fprintf(stderr, "init: %s: restart #%d in %llu ms\n",
+            service->name, service->restarts, (unsigned long long)service->restart_delay_ms);
+    return true;
+}
+
+int get_remain_ms(uint64_t deadline_ms, uint64_t now_ms)
+{
+    return (deadline_ms > now_ms) ? deadline_ms - now_ms : 0;
+}
+
+/**
+ * @brief Get the timeout of `epoll_wait()` for the nearest restart,
+ * or the nearest deadline of stopping on shutdown.
+ *
+ * @return int milliseconds, -1 for no deadline
+ */
+int get_timeout(void)
+{
+    uint64_t now_ms = get_clock_ms();
+    int timeout = -1;
+
+    if (shutdown_phase == SHUTDOWN_PROCESSES || shutdown_phase == SHUTDOWN_KILL)
+    {
+        return get_remain_ms(shutdown_deadline_ms, now_ms);
+    }
+
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        int remain;
+
+        if (service->state == STATE_RESTARTING && shutdown_phase == SHUTDOWN_NONE)
+        {
+            remain = get_remain_ms(service->restart_at_ms, now_ms);
+        }
+        else if (service->pid != 0 && service->stop_deadline_ms != 0)
+        {
+            remain = get_remain_ms(service->stop_deadline_ms, now_ms);
+        }
+        else
+        {
+            continue;
+        }
+
+        if (timeout == -1 || remain < timeout)
+        {
+            timeout = remain;
+        }
+    }
+
+    return timeout;
+}
+
+/**
+ * @brief Move the services whose restart delay has elapsed to the waiting state,
+ * so that they are started by `start_services()`.
+ */
+void restart_services(void)
+{
+    uint64_t now_ms = get_clock_ms();
+
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        if (service->state == STATE_RESTARTING && service->restart_at_ms <= now_ms)
+        {
+            service->state = STATE_WAITING;
+        }
+    }
+}
+
+/**
+ * @brief Check whether no service is waiting or running, i.e. the oneshot
+ * services have exited and the simple services are ready.
+ *
+ * @param is_interactive_included false to ignore the interactive services
+ * @return bool
+ */
+bool is_services_started(bool is_interactive_included)
+{
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        if (services[idx].is_interactive && !is_interactive_included)
+        {
+            continue;
+        }
+
+        enum ServiceState state = services[idx].state;
+        if (state == STATE_WAITING ||
+            state == STATE_STARTING ||
+            state == STATE_RUNNING ||
+            state == STATE_RESTARTING)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Record the end of the boot when no service is waiting or running.
+ */
+void check_boot_done(void)
+{
+    // the boot benchmark does not wait for the interactive shell, so
+    // "rc-done" and "shell" are separate steps.
+    if (is_bench && !is_bench_rc_done && is_services_started(false))
+    {
+        bench_mark("rc-done");
+    }
+
+    if (is_boot_done || !is_services_started(true))
+    {
+        return;
+    }
+
+    is_boot_done = true;
+    trace_event(BOOTTRACE_BOOT_DONE, "init", 1, 0);
+    trace_attach(true);
+}
+
+/**
+ * @brief Start shutting down the system.
+ *
+ * @param command the argument of `reboot()`
+ */
+void begin_shutdown(int command)
+{
+    if (shutdown_phase != SHUTDOWN_NONE)
+    {
+        // already shutting down
+        return;
+    }
+
+    fputs("init: the system is going down\n", stderr);
+
+    shutdown_command = command;
+    shutdown_phase = SHUTDOWN_SERVICES;
+
+    // the services which are not started will never be started
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        if (service->pid == 0)
+        {
+            service->state = STATE_STOPPED;
+        }
+    }
+}
+
+bool has_running_dependents(int service_index)
+{
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        if (service->pid == 0)
+        {
+            continue;
+        }
+
+        for (int dep = 0; dep < service->number_of_dependencies; dep++)
+        {
+            if (service->dependencies[dep] == service_index)
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void send_signal(struct Service *service, int signal)
+{
+    if (signal == SIGKILL && service->has_cgroup)
+    {
+        // kill all processes of the cgroup, including the ones
+        // which have left the process group. (Linux 5.14+)
+        char filepath[MAX_PATH_LENGTH];
+        snprintf(filepath, sizeof(filepath), "%s/%s/cgroup.kill", CGROUP_ROOT, service->name);
+        write_file(filepath, "1");
+    }
+
+    // each service is a process group (created by `setsid()`),
+    // send the signal to the whole group.
+    if (kill(-service->pid, signal) != 0)
     {
-        // this process is launched incorrectly.
-        return EXIT_FAILURE;
+        kill(service->pid, signal);
     }
+}
 
-    // the `init` process should not be killed or stoped,
-    // so block all signal.
-    sigset_t set;
-    sigfillset(&set);
-    sigprocmask(SIG_BLOCK, &set, NULL);
+/**
+ * @brief Advance the shutdown, it is called on every iteration of the main loop.
+ */
+void stop_services(void)
+{
+    uint64_t now_ms = get_clock_ms();
+
+    if (shutdown_phase == SHUTDOWN_SERVICES)
+    {
+        bool has_running = false;
+
+        for (int idx = 0; idx < number_of_services; idx++)
+        {
+            struct Service *service = &services[idx];
+            if (service->pid == 0)
+            {
+                continue;
+            }
+
+            if (service->stop_deadline_ms == 0)
+            {
+                if (has_running_dependents(idx))
+                {
+                    // wait for the dependents to exit
+                    has_running = true;
+                    continue;
+                }
+
+                send_signal(service, SIGTERM);
+                send_signal(service, SIGCONT);
+                service->stop_deadline_ms = now_ms + service->stop_timeout_ms;
+                has_running = true;
+            }
+            else if (now_ms >= service->stop_deadline_ms)
+            {
+                if (!service->is_killed)
+                {
+                    fprintf(stderr, "init: %s: stop timeout, killing\n", service->name);
+                    send_signal(service, SIGKILL);
+                    service->is_killed = true;
+                    service->stop_deadline_ms = now_ms + KILL_TIMEOUT_MS;
+                    has_running = true;
+                }
+                else
+                {
+                    // the process can not be killed, e.g. it is in uninterruptible sleep,
+                    // give up waiting for it.
+                    fprintf(stderr, "init: %s: can not be killed, ignored\n", service->name);
+                    service->pid = 0;
+                    service->state = STATE_STOPPED;
+                }
+            }
+            else
+            {
+                has_running = true;
+            }
+        }
+
+        if (has_running)
+        {
+            return;
+        }
+
+        // all services have exited, stop all other processes,
+        // `kill(-1, ...)` sends the signal to all processes except `init`.
+        kill(-1, SIGTERM);
+        kill(-1, SIGCONT);
+        shutdown_phase = SHUTDOWN_PROCESSES;
+        shutdown_deadline_ms = now_ms + PROCESS_STOP_TIMEOUT_MS;
+        reap_children();
+    }
 
-    int child_pid = fork();
-    if (child_pid > 0)
+    if (shutdown_phase == SHUTDOWN_PROCESSES)
     {
-        // parent process start here
+        if (has_children && now_ms < shutdown_deadline_ms)
+        {
+            return;
+        }
+
+        if (has_children)
+        {
+            kill(-1, SIGKILL);
+            shutdown_phase = SHUTDOWN_KILL;
+            shutdown_deadline_ms = now_ms + KILL_TIMEOUT_MS;
+            reap_children();
+        }
+    }
+
+    if (shutdown_phase == SHUTDOWN_KILL)
+    {
+        if (has_children && now_ms < shutdown_deadline_ms)
+        {
+            return;
+        }
+    }
+
+    finish_shutdown();
+}
+
+/**
+ * @brief Unmount the filesystems and reboot, it never returns.
+ */
+void finish_shutdown(void)
+{
+    unmount_all();
+    sync();
+
+    reboot(shutdown_command);
+
+    // the `init` process must not exit, otherwise the kernel panics.
+    perror("reboot");
+    while (true)
+    {
+        pause();
+    }
+}
+
+/**
+ * @brief Synchronize and lazily unmount all filesystems in the reverse mount order.
+ */
+void unmount_all(void)
+{
+    struct MountTable table;
+    if (!read_mountinfo(&table))
+    {
+        // `/proc` is not mounted
+        return;
+    }
+
+    for (int idx = table.count - 1; idx >= 0; idx--)
+    {
+        char *mount_point = table.entries[idx].mount_point;
+        if (strcmp(mount_point, "/") == 0)
+        {
+            // the root filesystem can not be unmounted
+            continue;
+        }
+
+        int fd = open(mount_point, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd != -1)
+        {
+            syncfs(fd);
+            close(fd);
+        }
 
-        int status;
-        while (true)
+        // detach the filesystem even it is busy.
+        if (umount2(mount_point, MNT_DETACH) != 0)
         {
-            // wait child processes exit
+            fprintf(stderr, "init: umount %s: %s\n", mount_point, strerror(errno));
+        }
+    }
 
-            // the exit status of the child process makes no sense for
-            // the init process, just discard it here.
-            wait(&status);
+    free_mountinfo(&table);
+}
 
-            // the `wait()` function return the `pid` of the exited child process.
-            //
-            // note that the _child processes_ includes the `/etc/rc` process which
-            // is started directly by the `init` process, and all other
-            // processes that have lose their parents, i.e. orphan processes.
-            // check APUE chapter 9.10
-            //
-            // the `wait()` function will be blocked until a child process exits.
-            //
-            // when there are no child processes, the `wait()` function will return -1
-            // and set the `errno` to 10.
+/**
+ * @brief Fork and execute the program of a service.
+ *
+ * @param service
+ * @param exec_status_fd optional, store the read port of a non-blocking pipe
+ *        into it, the pipe reports the error number of `execve`, or EOF
+ *        when the program is executed successfully.
+ * @return pid_t -1 if failed to fork
+ */
+pid_t spawn(struct Service *service, int *exec_status_fd)
+{
+    // the write port of the pipe is closed automatically when `execve` succeeds,
+    // otherwise the child process writes the error number into it.
+    int fd_pipe[2] = {-1, -1};
+    if (exec_status_fd != NULL)
+    {
+        if (pipe(fd_pipe) != 0)
+        {
+            perror("pipe");
+            return -1;
         }
 
-        // parent process wouldn't stop until system shut down
+        fcntl(fd_pipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fd_pipe[1], F_SETFD, FD_CLOEXEC);
+        fcntl(fd_pipe[0], F_SETFL, O_NONBLOCK);
     }
-    else if (child_pid == 0)
+
+    pid_t pid = fork();
+    if (pid == 0)
     {
         // child process start here
 
         // undo the signal blocking that set by the parent process.
+        sigset_t set;
+        sigfillset(&set);
         sigprocmask(SIG_UNBLOCK, &set, NULL);
 
         // start new session.
@@ -93,30 +1542,458 @@ int main(void)
         // check APUE chapter 9.6
         setsid();
 
-        chdir("/");
+        setup_process(service);
 
-        char *envp[] = {"USER=root",
-                        "HOME=/root",
-                        "SHELL=/bin/sh",
-                        "PWD=/",
-                        "PATH=/bin:/sbin:/usr/bin:/usr/sbin",
-                        NULL};
+        char *cwd = (service->cwd != NULL) ? service->cwd : "/";
 
-        // execute the shell program
-        // char *argv[] = {"sh", NULL};
-        // execve("/bin/sh", argv, envp);
+        if (chdir(cwd) != 0)
+        {
+            perror("chdir");
+        }
 
-        // execute the script
-        char *argv[] = {"/etc/rc", NULL};
-        execve("/etc/rc", argv, envp);
+        environ = envp;
+        setenv("PWD", cwd, 1);
+        execvp(service->argv[0], service->argv);
 
         // execve nerver return unless error occured.
-        perror("execve");
-        exit(EXIT_FAILURE);
+        int error_number = errno;
+        if (exec_status_fd != NULL)
+        {
+            write(fd_pipe[1], &error_number, sizeof(error_number));
+        }
+        else
+        {
+            perror("execve");
+        }
+
+        _exit(EXIT_FAILURE);
+    }
+    else if (pid > 0)
+    {
+        // parent process
+        trace_event(BOOTTRACE_FORK, service->name, pid, 0);
+
+        if (exec_status_fd != NULL)
+        {
+            close(fd_pipe[1]);
+            *exec_status_fd = fd_pipe[0];
+        }
+
+        return pid;
     }
     else
     {
         perror("fork");
-        exit(EXIT_FAILURE);
+        if (exec_status_fd != NULL)
+        {
+            close(fd_pipe[0]);
+            close(fd_pipe[1]);
+        }
+
+        return -1;
+    }
+}
+
+void trace_open(void)
+{
+    trace_size = sizeof(struct BootTraceHeader) +
+                 BOOTTRACE_CAPACITY * sizeof(struct BootTraceRecord);
+
+    trace = calloc(1, trace_size);
+    if (trace == NULL)
+    {
+        perror("calloc");
+        return;
+    }
+
+    memcpy(trace->magic, BOOTTRACE_MAGIC, sizeof(trace->magic));
+    trace->record_size = sizeof(struct BootTraceRecord);
+    trace->capacity = BOOTTRACE_CAPACITY;
+}
+
+/**
+ * @brief Move the boot trace from memory into the file `/run/boottrace`.
+ *
+ * @param is_forced attach even `/run` is not a mount point, i.e. write
+ *        the file into the initramfs.
+ */
+void trace_attach(bool is_forced)
+{
+    if (trace == NULL || is_trace_attached)
+    {
+        return;
+    }
+
+    if (!is_forced)
+    {
+        // `/run` is a mount point when its device differs from the root's.
+        struct stat root_stat;
+        struct stat run_stat;
+        if (stat("/", &root_stat) != 0 ||
+            stat("/run", &run_stat) != 0 ||
+            root_stat.st_dev == run_stat.st_dev)
+        {
+            return;
+        }
+    }
+
+    int fd = open(BOOTTRACE_FILEPATH, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+    {
+        if (is_forced)
+        {
+            // keep recording in memory, do not try again
+            perror("init: open " BOOTTRACE_FILEPATH);
+            is_trace_attached = true;
+        }
+        return;
+    }
+
+    if (ftruncate(fd, trace_size) != 0)
+    {
+        perror("init: ftruncate");
+        close(fd);
+        return;
+    }
+
+    void *addr = mmap(NULL, trace_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED)
+    {
+        perror("init: mmap");
+        return;
+    }
+
+    memcpy(addr, trace, trace_size);
+    free(trace);
+    trace = addr;
+    is_trace_attached = true;
+}
+
+/**
+ * @brief Set up the attributes of the current (child) process before
+ * executing the program of the service.
+ *
+ * @param service
+ */
+void setup_process(struct Service *service)
+{
+    if (service->has_cgroup)
+    {
+        // move the current process into the cgroup of the service,
+        // "0" means the writing process.
+        char filepath[MAX_PATH_LENGTH];
+        snprintf(filepath, sizeof(filepath), "%s/%s/cgroup.procs", CGROUP_ROOT, service->name);
+        if (!write_file(filepath, "0"))
+        {
+            fprintf(stderr, "init: %s: failed to enter cgroup: %s\n", service->name, strerror(errno));
+        }
+    }
+
+    // the attributes are inherited by the program and its children,
+    // a failure is reported but the service is still started.
+
+    if (service->has_cpu_affinity &&
+        sched_setaffinity(0, sizeof(service->cpu_affinity), &service->cpu_affinity) != 0)
+    {
+        fprintf(stderr, "init: %s: sched_setaffinity: %s\n", service->name, strerror(errno));
+    }
+
+    if (service->has_nice &&
+        setpriority(PRIO_PROCESS, 0, service->nice) != 0)
+    {
+        fprintf(stderr, "init: %s: setpriority: %s\n", service->name, strerror(errno));
+    }
+
+    if (service->has_sched_policy)
+    {
+        // the priority must be 0 for the policies other than `fifo` and `rr`
+        struct sched_param param = {0};
+        if (service->sched_policy == SCHED_FIFO || service->sched_policy == SCHED_RR)
+        {
+            param.sched_priority = (service->sched_priority > 0) ? service->sched_priority : 1;
+        }
+
+        if (sched_setscheduler(0, service->sched_policy, &param) != 0)
+        {
+            fprintf(stderr, "init: %s: sched_setscheduler: %s\n", service->name, strerror(errno));
+        }
+    }
+
+    if (service->has_ioprio &&
+        ioprio_set(IOPRIO_WHO_PROCESS, 0, service->ioprio) != 0)
+    {
+        fprintf(stderr, "init: %s: ioprio_set: %s\n", service->name, strerror(errno));
+    }
+}
+
+/**
+ * @brief Mount cgroup2 on `/sys/fs/cgroup` and enable the controllers for the
+ * child cgroups, and then move the running services into their cgroups.
+ *
+ * @return bool false if `/sys` is not mounted yet, or cgroup2 is not supported.
+ */
+bool setup_cgroup_root(void)
+{
+    if (is_cgroup_ready)
+    {
+        return true;
+    }
+
+    if (is_cgroup_unavailable)
+    {
+        return false;
+    }
+
+    // `/sys/fs/cgroup` exists once sysfs is mounted
+    struct stat s;
+    if (stat(CGROUP_ROOT, &s) != 0)
+    {
+        return false;
+    }
+
+    if (access(CGROUP_ROOT "/cgroup.controllers", F_OK) != 0 &&
+        mount("cgroup2", CGROUP_ROOT, "cgroup2", MS_NOSUID | MS_NODEV | MS_NOEXEC, NULL) != 0)
+    {
+        perror("init: mount cgroup2");
+
+        // do not try again
+        is_cgroup_unavailable = true;
+        return false;
+    }
+
+    is_cgroup_ready = true;
+
+    // enable the available controllers one by one, so that
+    // a missing controller does not affect the others.
+    FILE *file = fopen(CGROUP_ROOT "/cgroup.controllers", "r");
+    if (file != NULL)
+    {
+        char controllers[256];
+        if (fgets(controllers, sizeof(controllers), file) != NULL)
+        {
+            char *save_ptr;
+            char *token = strtok_r(controllers, " \n", &save_ptr);
+            while (token != NULL)
+            {
+                if (strcmp(token, "cpu") == 0 ||
+                    strcmp(token, "memory") == 0 ||
+                    strcmp(token, "io") == 0 ||
+                    strcmp(token, "pids") == 0)
+                {
+                    char text[32];
+                    snprintf(text, sizeof(text), "+%s", token);
+                    if (!write_file(CGROUP_ROOT "/cgroup.subtree_control", text))
+                    {
+                        fprintf(stderr, "init: failed to enable cgroup controller %s: %s\n",
+                                token, strerror(errno));
+                    }
+                }
+
+                token = strtok_r(NULL, " \n", &save_ptr);
+            }
+        }
+
+        fclose(file);
+    }
+
+    // move the services started before
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        struct Service *service = &services[idx];
+        if (service->pid != 0 && create_cgroup(service))
+        {
+            char filepath[MAX_PATH_LENGTH];
+            int length = snprintf(filepath, sizeof(filepath), "%s/%s/cgroup.procs", CGROUP_ROOT, service->name);
+            if (length < 0 || (size_t)length >= sizeof(filepath))
+            {
+                fprintf(stderr, "init: %s: the cgroup path is too long\n", service->name);
+                continue;
+            }
+
+            char text[32];
+            snprintf(text, sizeof(text), "%d", service->pid);
+            write_file(filepath, text);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Create the cgroup of the service and apply the settings.
+ *
+ * @param service
+ * @return bool
+ */
+bool create_cgroup(struct Service *service)
+{
+    if (service->has_cgroup)
+    {
+        return true;
+    }
+
+    char filepath[MAX_PATH_LENGTH];
+    int length = snprintf(filepath, sizeof(filepath), "%s/%s", CGROUP_ROOT, service->name);
+    if (length < 0 || (size_t)length >= sizeof(filepath))
+    {
+        fprintf(stderr, "init: %s: the cgroup path is too long\n", service->name);
+        return false;
+    }
+
+    if (mkdir(filepath, 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "init: %s: failed to create cgroup: %s\n", service->name, strerror(errno));
+        return false;
+    }
+
+    service->has_cgroup = true;
+
+    for (int idx = 0; idx < service->number_of_cgroup_settings; idx++)
+    {
+        length = snprintf(filepath, sizeof(filepath), "%s/%s/%s",
+                          CGROUP_ROOT, service->name, service->cgroup_keys[idx]);
+        if (length < 0 || (size_t)length >= sizeof(filepath))
+        {
+            fprintf(stderr, "init: %s: the cgroup path of %s is too long\n",
+                    service->name, service->cgroup_keys[idx]);
+            continue;
+        }
+
+        if (!write_file(filepath, service->cgroup_values[idx]))
+        {
+            fprintf(stderr, "init: %s: failed to set %s to \"%s\": %s\n",
+                    service->name, service->cgroup_keys[idx],
+                    service->cgroup_values[idx], strerror(errno));
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write the text into the file, it is used for the files of
+ * cgroup, procfs and sysfs.
+ *
+ * @param filepath
+ * @param text
+ * @return bool false if failed, the `errno` is set.
+ */
+bool write_file(const char *filepath, const char *text)
+{
+    int fd = open(filepath, O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    size_t len = strlen(text);
+    ssize_t bytes_written = write(fd, text, len);
+
+    int error_number = errno;
+    close(fd);
+    errno = error_number;
+
+    return bytes_written == (ssize_t)len;
+}
+
+uint64_t get_clock_ns(clockid_t clock_id)
+{
+    struct timespec ts;
+    clock_gettime(clock_id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t get_clock_ms(void)
+{
+    return get_clock_ns(CLOCK_MONOTONIC) / 1000000;
+}
+
+void trace_event(enum BootTraceEvent event, const char *name, pid_t pid, int status)
+{
+    if (trace == NULL)
+    {
+        return;
     }
-}
\ No newline at end of file
+
+    uint64_t count = trace->count;
+    struct BootTraceRecord *records = (struct BootTraceRecord *)(trace + 1);
+    struct BootTraceRecord *record = &records[count % trace->capacity];
+
+    record->boottime_ns = get_clock_ns(CLOCK_BOOTTIME);
+    record->monotonic_ns = get_clock_ns(CLOCK_MONOTONIC);
+    record->pid = pid;
+    record->status = status;
+    record->event = event;
+    strncpy(record->name, name, sizeof(record->name) - 1);
+    record->name[sizeof(record->name) - 1] = '\0';
+
+    // publish the record after it is completely written,
+    // readers check `count` first.
+    __atomic_store_n(&trace->count, count + 1, __ATOMIC_RELEASE);
+
+    if (event == BOOTTRACE_READY || event == BOOTTRACE_EXIT)
+    {
+        // a filesystem may be mounted on `/run` by the service
+        trace_attach(false);
+    }
+}
+
+/**
+ * @brief Print a step of the boot benchmark, and power off the system when
+ * all steps are printed.
+ *
+ * @param step "init", "rc-done" or "shell"
+ */
+void bench_mark(const char *step)
+{
+    if (!is_bench)
+    {
+        return;
+    }
+
+    uint64_t ns = get_clock_ns(CLOCK_BOOTTIME);
+    fprintf(stderr, "initbench: %s %llu.%06llu\n", step,
+            (unsigned long long)(ns / 1000000000), (unsigned long long)(ns % 1000000000 / 1000));
+
+    is_bench_rc_done = is_bench_rc_done || strcmp(step, "rc-done") == 0;
+    is_bench_shell = is_bench_shell || strcmp(step, "shell") == 0;
+
+    bool has_shell = false;
+    for (int idx = 0; idx < number_of_services; idx++)
+    {
+        has_shell = has_shell || services[idx].is_interactive;
+    }
+
+    if (is_bench_rc_done && (is_bench_shell || !has_shell))
+    {
+        // the same as the command `poweroff`, the signal wakes up the main loop
+        kill(getpid(), SIGUSR2);
+    }
+}
+
+char *trim_inplace(char *str)
+{
+    char *start_ptr = str;
+    while (isspace((unsigned char)*start_ptr))
+    {
+        start_ptr++;
+    }
+
+    if (*start_ptr == 0)
+    {
+        // all characters are space
+        return start_ptr;
+    }
+
+    char *end_ptr = start_ptr + strlen(start_ptr) - 1;
+    while (end_ptr > start_ptr && isspace((unsigned char)*end_ptr))
+    {
+        end_ptr--;
+    }
+
+    // set null terminator
+    end_ptr[1] = '\0';
+    return start_ptr;
+}
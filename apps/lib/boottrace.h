@@ -0,0 +1,85 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef BOOTTRACE_H
+#define BOOTTRACE_H
+
+#include <stdint.h>
+
+// the boot trace is written by `init` and read by the applet `bootchart`.
+//
+// the file consists of a header followed by a ring of fixed size records:
+//
+// | header (64 bytes) | record 0 | record 1 | ... | record (capacity - 1) |
+//
+// the record `n` is stored in the slot `n % capacity`, the oldest records
+// are overwritten when the ring is full. `count` is the total number of
+// records ever written, it is updated after the record is written.
+
+#define BOOTTRACE_FILEPATH "/run/boottrace"
+#define BOOTTRACE_MAGIC "BOOTTRC1"
+#define BOOTTRACE_CAPACITY 1024
+#define BOOTTRACE_NAME_LENGTH 40
+
+enum BootTraceEvent
+{
+    BOOTTRACE_INIT = 1,  // the `init` process started
+    BOOTTRACE_FORK,      // the service process was forked
+    BOOTTRACE_EXEC,      // the service program was executed
+    BOOTTRACE_READY,     // the service is ready
+    BOOTTRACE_EXIT,      // the service process exited, `status` is the wait status
+    BOOTTRACE_FAIL,      // the service failed to start, or was skipped
+    BOOTTRACE_BOOT_DONE, // all services have been started
+    BOOTTRACE_SHELL      // the interactive shell was executed
+};
+
+struct BootTraceHeader
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t count;
+    uint64_t reserved[5];
+};
+
+struct BootTraceRecord
+{
+    uint64_t boottime_ns;  // CLOCK_BOOTTIME
+    uint64_t monotonic_ns; // CLOCK_MONOTONIC
+    int32_t pid;
+    int32_t status;
+    uint32_t event;
+    char name[BOOTTRACE_NAME_LENGTH]; // the service name, NULL terminated
+};
+
+static inline const char *boottrace_event_name(uint32_t event)
+{
+    switch (event)
+    {
+    case BOOTTRACE_INIT:
+        return "init";
+    case BOOTTRACE_FORK:
+        return "fork";
+    case BOOTTRACE_EXEC:
+        return "exec";
+    case BOOTTRACE_READY:
+        return "ready";
+    case BOOTTRACE_EXIT:
+        return "exit";
+    case BOOTTRACE_FAIL:
+        return "fail";
+    case BOOTTRACE_BOOT_DONE:
+        return "boot-done";
+    case BOOTTRACE_SHELL:
+        return "shell";
+    default:
+        return "?";
+    }
+}
+
+#endif
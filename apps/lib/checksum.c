@@ -0,0 +1,582 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "checksum.h"
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the checksum functions require a little endian target"
+#endif
+
+#if defined(__riscv) && __riscv_xlen == 64
+#define IS_RISCV64 1
+#else
+#define IS_RISCV64 0
+#endif
+
+// the bit-reflected polynomial of CRC32C
+#define CRC32C_POLY 0x82f63b78
+// the quotient of x^64 divided by the polynomial (bit-reflected), it is used
+// by the Barrett reduction of the carry-less multiplication.
+#define CRC32C_POLY_QT 0xa434f61c6f5389f8ULL
+
+#define XXH64_PRIME1 0x9e3779b185ebca87ULL
+#define XXH64_PRIME2 0xc2b2ae3d27d4eb4fULL
+#define XXH64_PRIME3 0x165667b19e3779f9ULL
+#define XXH64_PRIME4 0x85ebca77c2b2ae63ULL
+#define XXH64_PRIME5 0x27d4eb2f165667c5ULL
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static unsigned int features = 0;
+
+// the tables of the slicing-by-8 CRC32C
+static uint32_t crc32c_table[8][256];
+
+#if IS_RISCV64
+
+// the system call `riscv_hwprobe` (since Linux 6.4), the numbers are defined
+// here because the old kernel headers do not have them.
+#define NR_RISCV_HWPROBE 258
+#define RISCV_HWPROBE_KEY_IMA_EXT_0 4
+#define RISCV_HWPROBE_EXT_ZBC (1ULL << 7)
+#define RISCV_HWPROBE_EXT_ZKNH (1ULL << 13)
+
+struct RiscvHwprobe
+{
+    int64_t key;
+    uint64_t value;
+};
+
+/**
+ * @brief Check the extension in the ISA string, e.g. "rv64imafdc_zba_zbc".
+ */
+static bool has_isa_extension(const char *isa, const char *name)
+{
+    size_t length = strlen(name);
+    const char *ptr = isa;
+
+    while ((ptr = strchr(ptr, '_')) != NULL)
+    {
+        ptr++;
+        if (strncmp(ptr, name, length) == 0 &&
+            (ptr[length] == '_' || ptr[length] == '\n' || ptr[length] == '\0'))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static unsigned int detect_features(void)
+{
+    unsigned int result = 0;
+
+    struct RiscvHwprobe pair = {.key = RISCV_HWPROBE_KEY_IMA_EXT_0};
+    if (syscall(NR_RISCV_HWPROBE, &pair, 1, 0, NULL, 0) == 0 && pair.key != -1)
+    {
+        result |= (pair.value & RISCV_HWPROBE_EXT_ZBC) ? CHECKSUM_FEATURE_ZBC : 0;
+        result |= (pair.value & RISCV_HWPROBE_EXT_ZKNH) ? CHECKSUM_FEATURE_ZKNH : 0;
+        return result;
+    }
+
+    // the old kernels, check the ISA string of the first hart
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (strncmp(line, "isa", 3) == 0)
+        {
+            result |= has_isa_extension(line, "zbc") ? CHECKSUM_FEATURE_ZBC : 0;
+            result |= has_isa_extension(line, "zknh") ? CHECKSUM_FEATURE_ZKNH : 0;
+            break;
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+// the instructions are encoded by `.insn`, so the assembler which does not
+// support the extensions works too.
+
+static inline uint64_t clmul(uint64_t a, uint64_t b)
+{
+    uint64_t result;
+    __asm__(".insn r 0x33, 1, 5, %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+    return result;
+}
+
+static inline uint64_t clmulr(uint64_t a, uint64_t b)
+{
+    uint64_t result;
+    __asm__(".insn r 0x33, 2, 5, %0, %1, %2" : "=r"(result) : "r"(a), "r"(b));
+    return result;
+}
+
+// the RV64 Zknh instructions read the low 32 bits, and sign-extend the result
+#define ZKNH_INSTRUCTION(imm, x) ({                                        \
+    unsigned long _result;                                                 \
+    __asm__(".insn i 0x13, 1, %0, %1, " #imm : "=r"(_result) : "r"(x)); \
+    (uint32_t)_result;                                                     \
+})
+
+#else
+
+static unsigned int detect_features(void)
+{
+    return 0;
+}
+
+#endif
+
+unsigned int checksum_init(void)
+{
+    for (uint32_t idx = 0; idx < 256; idx++)
+    {
+        uint32_t crc = idx;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        }
+        crc32c_table[0][idx] = crc;
+    }
+
+    for (int slice = 1; slice < 8; slice++)
+    {
+        for (int idx = 0; idx < 256; idx++)
+        {
+            uint32_t previous = crc32c_table[slice - 1][idx];
+            crc32c_table[slice][idx] = (previous >> 8) ^ crc32c_table[0][previous & 0xff];
+        }
+    }
+
+    features = detect_features();
+    return features;
+}
+
+static inline uint32_t load_be32(const unsigned char *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static inline uint64_t load_le64(const unsigned char *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t load_le32(const unsigned char *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t rotate_right32(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static inline uint64_t rotate_left64(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// SHA-256
+
+static inline uint32_t sha256_sum0(uint32_t x, bool is_zknh)
+{
+#if IS_RISCV64
+    if (is_zknh)
+    {
+        return ZKNH_INSTRUCTION(0x100, x);
+    }
+#endif
+    (void)is_zknh;
+    return rotate_right32(x, 2) ^ rotate_right32(x, 13) ^ rotate_right32(x, 22);
+}
+
+static inline uint32_t sha256_sum1(uint32_t x, bool is_zknh)
+{
+#if IS_RISCV64
+    if (is_zknh)
+    {
+        return ZKNH_INSTRUCTION(0x101, x);
+    }
+#endif
+    (void)is_zknh;
+    return rotate_right32(x, 6) ^ rotate_right32(x, 11) ^ rotate_right32(x, 25);
+}
+
+static inline uint32_t sha256_sig0(uint32_t x, bool is_zknh)
+{
+#if IS_RISCV64
+    if (is_zknh)
+    {
+        return ZKNH_INSTRUCTION(0x102, x);
+    }
+#endif
+    (void)is_zknh;
+    return rotate_right32(x, 7) ^ rotate_right32(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t sha256_sig1(uint32_t x, bool is_zknh)
+{
+#if IS_RISCV64
+    if (is_zknh)
+    {
+        return ZKNH_INSTRUCTION(0x103, x);
+    }
+#endif
+    (void)is_zknh;
+    return rotate_right32(x, 17) ^ rotate_right32(x, 19) ^ (x >> 10);
+}
+
+/**
+ * @brief Compress the blocks, it is always inlined so the branches of
+ * `is_zknh` are resolved at compile time.
+ */
+static inline __attribute__((always_inline)) void sha256_compress(uint32_t *state, const unsigned char *data,
+                                                                  size_t blocks, bool is_zknh)
+{
+    for (; blocks > 0; blocks--, data += SHA256_BLOCK_SIZE)
+    {
+        uint32_t w[64];
+        for (int idx = 0; idx < 16; idx++)
+        {
+            w[idx] = load_be32(data + idx * 4);
+        }
+
+        for (int idx = 16; idx < 64; idx++)
+        {
+            w[idx] = sha256_sig1(w[idx - 2], is_zknh) + w[idx - 7] + sha256_sig0(w[idx - 15], is_zknh) + w[idx - 16];
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int idx = 0; idx < 64; idx++)
+        {
+            uint32_t t1 = h + sha256_sum1(e, is_zknh) + ((e & f) ^ (~e & g)) + SHA256_K[idx] + w[idx];
+            uint32_t t2 = sha256_sum0(a, is_zknh) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+static void sha256_blocks(uint32_t *state, const unsigned char *data, size_t blocks)
+{
+    if (features & CHECKSUM_FEATURE_ZKNH)
+    {
+        sha256_compress(state, data, blocks, true);
+    }
+    else
+    {
+        sha256_compress(state, data, blocks, false);
+    }
+}
+
+void sha256_init(struct Sha256 *context)
+{
+    static const uint32_t INITIAL_STATE[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    memcpy(context->state, INITIAL_STATE, sizeof(INITIAL_STATE));
+    context->length = 0;
+    context->buffer_length = 0;
+}
+
+void sha256_update(struct Sha256 *context, const void *data, size_t length)
+{
+    const unsigned char *ptr = data;
+    context->length += length;
+
+    if (context->buffer_length > 0)
+    {
+        size_t count = SHA256_BLOCK_SIZE - context->buffer_length;
+        count = (count > length) ? length : count;
+        memcpy(context->buffer + context->buffer_length, ptr, count);
+        context->buffer_length += count;
+        ptr += count;
+        length -= count;
+
+        if (context->buffer_length < SHA256_BLOCK_SIZE)
+        {
+            return;
+        }
+
+        sha256_blocks(context->state, context->buffer, 1);
+        context->buffer_length = 0;
+    }
+
+    size_t blocks = length / SHA256_BLOCK_SIZE;
+    sha256_blocks(context->state, ptr, blocks);
+    ptr += blocks * SHA256_BLOCK_SIZE;
+    length -= blocks * SHA256_BLOCK_SIZE;
+
+    memcpy(context->buffer, ptr, length);
+    context->buffer_length = length;
+}
+
+void sha256_final(struct Sha256 *context, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    uint64_t bits = context->length * 8;
+
+    // the padding is 0x80, the zeros, and the length (in bits) of 8 bytes
+    unsigned char padding[SHA256_BLOCK_SIZE * 2] = {0x80};
+    size_t padding_length = (context->buffer_length < 56) ? 56 - context->buffer_length : 120 - context->buffer_length;
+    for (int idx = 0; idx < 8; idx++)
+    {
+        padding[padding_length + idx] = bits >> (56 - idx * 8);
+    }
+
+    sha256_update(context, padding, padding_length + 8);
+
+    for (int idx = 0; idx < 8; idx++)
+    {
+        digest[idx * 4] = context->state[idx] >> 24;
+        digest[idx * 4 + 1] = context->state[idx] >> 16;
+        digest[idx * 4 + 2] = context->state[idx] >> 8;
+        digest[idx * 4 + 3] = context->state[idx];
+    }
+}
+
+// CRC32C
+
+static uint32_t crc32c_bytes(uint32_t crc, const unsigned char *data, size_t length)
+{
+    for (size_t idx = 0; idx < length; idx++)
+    {
+        crc = crc32c_table[0][(crc ^ data[idx]) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+static uint32_t crc32c_slicing(uint32_t crc, const unsigned char *data, size_t length)
+{
+    for (; length >= 8; length -= 8, data += 8)
+    {
+        uint64_t word = load_le64(data) ^ crc;
+        crc = crc32c_table[7][word & 0xff] ^
+              crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^
+              crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^
+              crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^
+              crc32c_table[0][word >> 56];
+    }
+
+    return crc32c_bytes(crc, data, length);
+}
+
+#if IS_RISCV64
+
+static uint32_t crc32c_zbc(uint32_t crc, const unsigned char *data, size_t length)
+{
+    // the unaligned loads may be emulated by the firmware, which is very slow
+    size_t head = (8 - ((uintptr_t)data & 7)) & 7;
+    head = (head > length) ? length : head;
+    crc = crc32c_bytes(crc, data, head);
+    data += head;
+    length -= head;
+
+    for (; length >= 8; length -= 8, data += 8)
+    {
+        // the Barrett reduction of (word * x^32) modulo the polynomial, in
+        // the bit-reflected domain.
+        uint64_t word = load_le64(data) ^ crc;
+        uint64_t quotient = (clmul(word, CRC32C_POLY_QT) << 1) ^ word;
+        crc = clmulr(quotient, (uint64_t)CRC32C_POLY << 32) >> 32;
+    }
+
+    return crc32c_bytes(crc, data, length);
+}
+
+#endif
+
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t length)
+{
+    crc = ~crc;
+
+#if IS_RISCV64
+    if (features & CHECKSUM_FEATURE_ZBC)
+    {
+        return ~crc32c_zbc(crc, data, length);
+    }
+#endif
+
+    return ~crc32c_slicing(crc, data, length);
+}
+
+// XXH64
+
+static inline uint64_t xxh64_round(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * XXH64_PRIME2;
+    accumulator = rotate_left64(accumulator, 31);
+    return accumulator * XXH64_PRIME1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= xxh64_round(0, accumulator);
+    return hash * XXH64_PRIME1 + XXH64_PRIME4;
+}
+
+static void xxh64_stripes(uint64_t *accumulators, const unsigned char *data, size_t stripes)
+{
+    uint64_t v1 = accumulators[0], v2 = accumulators[1], v3 = accumulators[2], v4 = accumulators[3];
+
+    for (; stripes > 0; stripes--, data += 32)
+    {
+        v1 = xxh64_round(v1, load_le64(data));
+        v2 = xxh64_round(v2, load_le64(data + 8));
+        v3 = xxh64_round(v3, load_le64(data + 16));
+        v4 = xxh64_round(v4, load_le64(data + 24));
+    }
+
+    accumulators[0] = v1;
+    accumulators[1] = v2;
+    accumulators[2] = v3;
+    accumulators[3] = v4;
+}
+
+void xxh64_init(struct Xxh64 *context, uint64_t seed)
+{
+    context->accumulators[0] = seed + XXH64_PRIME1 + XXH64_PRIME2;
+    context->accumulators[1] = seed + XXH64_PRIME2;
+    context->accumulators[2] = seed;
+    context->accumulators[3] = seed - XXH64_PRIME1;
+    context->seed = seed;
+    context->length = 0;
+    context->buffer_length = 0;
+}
+
+void xxh64_update(struct Xxh64 *context, const void *data, size_t length)
+{
+    const unsigned char *ptr = data;
+    context->length += length;
+
+    if (context->buffer_length > 0)
+    {
+        size_t count = 32 - context->buffer_length;
+        count = (count > length) ? length : count;
+        memcpy(context->buffer + context->buffer_length, ptr, count);
+        context->buffer_length += count;
+        ptr += count;
+        length -= count;
+
+        if (context->buffer_length < 32)
+        {
+            return;
+        }
+
+        xxh64_stripes(context->accumulators, context->buffer, 1);
+        context->buffer_length = 0;
+    }
+
+    size_t stripes = length / 32;
+    xxh64_stripes(context->accumulators, ptr, stripes);
+    ptr += stripes * 32;
+    length -= stripes * 32;
+
+    memcpy(context->buffer, ptr, length);
+    context->buffer_length = length;
+}
+
+uint64_t xxh64_final(const struct Xxh64 *context)
+{
+    const uint64_t *v = context->accumulators;
+    uint64_t hash;
+
+    if (context->length >= 32)
+    {
+        hash = rotate_left64(v[0], 1) + rotate_left64(v[1], 7) + rotate_left64(v[2], 12) + rotate_left64(v[3], 18);
+        hash = xxh64_merge(hash, v[0]);
+        hash = xxh64_merge(hash, v[1]);
+        hash = xxh64_merge(hash, v[2]);
+        hash = xxh64_merge(hash, v[3]);
+    }
+    else
+    {
+        hash = context->seed + XXH64_PRIME5;
+    }
+
+    hash += context->length;
+
+    const unsigned char *ptr = context->buffer;
+    size_t length = context->buffer_length;
+
+    for (; length >= 8; length -= 8, ptr += 8)
+    {
+        hash ^= xxh64_round(0, load_le64(ptr));
+        hash = rotate_left64(hash, 27) * XXH64_PRIME1 + XXH64_PRIME4;
+    }
+
+    if (length >= 4)
+    {
+        hash ^= (uint64_t)load_le32(ptr) * XXH64_PRIME1;
+        hash = rotate_left64(hash, 23) * XXH64_PRIME2 + XXH64_PRIME3;
+        ptr += 4;
+        length -= 4;
+    }
+
+    for (; length > 0; length--, ptr++)
+    {
+        hash ^= *ptr * XXH64_PRIME5;
+        hash = rotate_left64(hash, 11) * XXH64_PRIME1;
+    }
+
+    // the avalanche
+    hash ^= hash >> 33;
+    hash *= XXH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH64_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+// the checksum algorithms of the applets `sha256sum`, `crc32c` and `xxh64`.
+//
+// the RISC-V extensions are detected at runtime by `checksum_init()`, by the
+// `riscv_hwprobe` system call, or `/proc/cpuinfo` on the older kernels:
+//
+// - Zbc (the carry-less multiplication) for CRC32C, 8 bytes per step.
+// - Zknh (the scalar SHA-256 sigma instructions) for SHA-256.
+//
+// the portable code is used on the other CPUs and targets.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHECKSUM_FEATURE_ZBC (1 << 0)
+#define CHECKSUM_FEATURE_ZKNH (1 << 1)
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+
+struct Sha256
+{
+    uint32_t state[8];
+    uint64_t length; // the total bytes
+    unsigned char buffer[SHA256_BLOCK_SIZE];
+    size_t buffer_length;
+};
+
+struct Xxh64
+{
+    uint64_t accumulators[4];
+    uint64_t seed;
+    uint64_t length; // the total bytes
+    unsigned char buffer[32];
+    size_t buffer_length;
+};
+
+/**
+ * @brief Detect the CPU features and build the tables, it must be called
+ * before the other functions, and before any thread is created.
+ *
+ * @return unsigned int the used features, i.e. `CHECKSUM_FEATURE_*`
+ */
+unsigned int checksum_init(void);
+
+void sha256_init(struct Sha256 *context);
+void sha256_update(struct Sha256 *context, const void *data, size_t length);
+void sha256_final(struct Sha256 *context, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Continue the CRC32C (Castagnoli) of the data.
+ *
+ * @param crc 0 for the beginning, or the result of the previous data
+ * @param data
+ * @param length
+ * @return uint32_t
+ */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t length);
+
+void xxh64_init(struct Xxh64 *context, uint64_t seed);
+void xxh64_update(struct Xxh64 *context, const void *data, size_t length);
+uint64_t xxh64_final(const struct Xxh64 *context);
+
+#endif
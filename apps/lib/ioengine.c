@@ -0,0 +1,775 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "ioengine.h"
+
+// the kinds of the requests, they are stored in `user_data` along with
+// the slot index and the output index
+#define REQUEST_READ 0
+#define REQUEST_WRITE 1
+#define REQUEST_LINKED_WRITE 2
+
+#define MAKE_USER_DATA(kind, slot, output) (((uint64_t)(kind) << 32) | ((uint64_t)(output) << 16) | (slot))
+#define USER_DATA_KIND(data) ((data) >> 32)
+#define USER_DATA_OUTPUT(data) (((data) >> 16) & 0xffff)
+#define USER_DATA_SLOT(data) ((data) & 0xffff)
+
+enum SlotState
+{
+    SLOT_FREE,
+    SLOT_READING,
+    SLOT_READY,  // the block has been read, and it is being written
+    SLOT_LINKED, // the block is being read and written by the linked requests
+};
+
+struct IoSlot
+{
+    enum SlotState state;
+    uint64_t seq;      // the sequence number of the block
+    off_t in_offset;   // -1 for the current position
+    size_t requested;  // the length of the read
+    bool is_discarded; // read ahead after a short read, i.e. at a wrong offset
+    size_t length;
+    unsigned int pending; // the number of outputs which have not finished
+    size_t written[IOENGINE_MAX_OUTPUTS];
+    off_t out_offset[IOENGINE_MAX_OUTPUTS]; // -1 for the current position
+};
+
+struct IoOutput
+{
+    int fd;
+    bool is_seekable;
+    off_t position;
+    bool is_busy;      // a non-seekable output has one write in flight at most
+    uint64_t next_seq; // the next block to write
+};
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int ring_fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int ring_fd, unsigned int opcode, const void *arg, unsigned int nr_args)
+{
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static bool setup_ring(struct IoEngine *engine)
+{
+    // each slot has a read and a write for each output in flight at most
+    unsigned int entries = engine->queue_depth * (1 + IOENGINE_MAX_OUTPUTS);
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd == -1)
+    {
+        return false;
+    }
+
+    engine->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    engine->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    bool is_single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (is_single_mmap)
+    {
+        size_t size = (engine->sq_ring_size > engine->cq_ring_size) ? engine->sq_ring_size : engine->cq_ring_size;
+        engine->sq_ring_size = size;
+        engine->cq_ring_size = size;
+    }
+
+    engine->sq_ring = mmap(NULL, engine->sq_ring_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (engine->sq_ring == MAP_FAILED)
+    {
+        close(ring_fd);
+        return false;
+    }
+
+    if (is_single_mmap)
+    {
+        engine->cq_ring = engine->sq_ring;
+    }
+    else
+    {
+        engine->cq_ring = mmap(NULL, engine->cq_ring_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (engine->cq_ring == MAP_FAILED)
+        {
+            munmap(engine->sq_ring, engine->sq_ring_size);
+            close(ring_fd);
+            return false;
+        }
+    }
+
+    engine->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    engine->sqes = mmap(NULL, engine->sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (engine->sqes == MAP_FAILED)
+    {
+        if (!is_single_mmap)
+        {
+            munmap(engine->cq_ring, engine->cq_ring_size);
+        }
+        munmap(engine->sq_ring, engine->sq_ring_size);
+        close(ring_fd);
+        return false;
+    }
+
+    unsigned char *sq = engine->sq_ring;
+    engine->sq_head = (unsigned int *)(sq + params.sq_off.head);
+    engine->sq_tail = (unsigned int *)(sq + params.sq_off.tail);
+    engine->sq_mask = (unsigned int *)(sq + params.sq_off.ring_mask);
+    engine->sq_entries = (unsigned int *)(sq + params.sq_off.ring_entries);
+    engine->sq_array = (unsigned int *)(sq + params.sq_off.array);
+
+    unsigned char *cq = engine->cq_ring;
+    engine->cq_head = (unsigned int *)(cq + params.cq_off.head);
+    engine->cq_tail = (unsigned int *)(cq + params.cq_off.tail);
+    engine->cq_mask = (unsigned int *)(cq + params.cq_off.ring_mask);
+    engine->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    engine->ring_fd = ring_fd;
+
+    // the registered buffers are pinned once, instead of on every request,
+    // it may fail by RLIMIT_MEMLOCK, then the plain requests are used.
+    struct iovec iovecs[IOENGINE_MAX_QUEUE_DEPTH];
+    for (unsigned int idx = 0; idx < engine->queue_depth; idx++)
+    {
+        iovecs[idx].iov_base = engine->buffers + idx * engine->block_size;
+        iovecs[idx].iov_len = engine->block_size;
+    }
+    engine->is_registered =
+        (io_uring_register(ring_fd, IORING_REGISTER_BUFFERS, iovecs, engine->queue_depth) == 0);
+
+    return true;
+}
+
+bool ioengine_init(struct IoEngine *engine, unsigned int queue_depth, size_t block_size)
+{
+    memset(engine, 0, sizeof(struct IoEngine));
+    engine->ring_fd = -1;
+    engine->error_fd = -1;
+
+    bool is_disabled = false;
+    const char *depth_text = getenv("IOENGINE_QUEUE_DEPTH");
+    if (depth_text != NULL)
+    {
+        queue_depth = atoi(depth_text);
+        is_disabled = (queue_depth == 0);
+    }
+
+    queue_depth = (queue_depth == 0) ? IOENGINE_DEFAULT_QUEUE_DEPTH : queue_depth;
+    queue_depth = (queue_depth > IOENGINE_MAX_QUEUE_DEPTH) ? IOENGINE_MAX_QUEUE_DEPTH : queue_depth;
+    block_size = (block_size == 0) ? IOENGINE_DEFAULT_BLOCK_SIZE : block_size;
+
+    engine->queue_depth = queue_depth;
+    engine->block_size = block_size;
+
+    // aligned to the page, so the buffers can be used by O_DIRECT too
+    if (posix_memalign((void **)&engine->buffers, 4096, queue_depth * block_size) != 0)
+    {
+        return false;
+    }
+
+    if (!is_disabled && !setup_ring(engine))
+    {
+        engine->ring_fd = -1;
+    }
+
+    return true;
+}
+
+void ioengine_destroy(struct IoEngine *engine)
+{
+    if (engine->ring_fd != -1)
+    {
+        munmap(engine->sqes, engine->sqes_size);
+        if (engine->cq_ring != engine->sq_ring)
+        {
+            munmap(engine->cq_ring, engine->cq_ring_size);
+        }
+        munmap(engine->sq_ring, engine->sq_ring_size);
+        close(engine->ring_fd);
+        engine->ring_fd = -1;
+    }
+
+    free(engine->buffers);
+    engine->buffers = NULL;
+}
+
+/**
+ * @brief Submit the prepared SQEs, and wait for the completions.
+ *
+ * @return int 0, or the error number
+ */
+static int submit_and_wait(struct IoEngine *engine, unsigned int min_complete)
+{
+    while (true)
+    {
+        int result = io_uring_enter(engine->ring_fd, engine->to_submit, min_complete,
+                                    min_complete > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (result >= 0)
+        {
+            engine->to_submit -= result;
+            if (engine->to_submit == 0 || min_complete > 0)
+            {
+                return 0;
+            }
+            continue;
+        }
+
+        if (errno != EINTR)
+        {
+            return errno;
+        }
+    }
+}
+
+static struct io_uring_sqe *get_sqe(struct IoEngine *engine)
+{
+    unsigned int tail = *engine->sq_tail;
+    unsigned int head = __atomic_load_n(engine->sq_head, __ATOMIC_ACQUIRE);
+
+    if (tail - head == *engine->sq_entries)
+    {
+        // the queue is full, it can not happen in practice because the
+        // ring is large enough for all requests of the slots.
+        submit_and_wait(engine, 0);
+    }
+
+    unsigned int index = tail & *engine->sq_mask;
+    struct io_uring_sqe *sqe = &engine->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    engine->sq_array[index] = index;
+    __atomic_store_n(engine->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    engine->to_submit++;
+    engine->in_flight++;
+    return sqe;
+}
+
+/**
+ * @brief Wait for all requests in flight, they refer to the buffers.
+ */
+static void drain_requests(struct IoEngine *engine)
+{
+    while (engine->in_flight > 0)
+    {
+        if (submit_and_wait(engine, 1) != 0)
+        {
+            return;
+        }
+
+        unsigned int head = *engine->cq_head;
+        unsigned int tail = __atomic_load_n(engine->cq_tail, __ATOMIC_ACQUIRE);
+        engine->in_flight -= tail - head;
+        __atomic_store_n(engine->cq_head, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void prepare_rw(struct IoEngine *engine, bool is_write, int fd, unsigned int slot_index,
+                       size_t data_offset, size_t length, off_t file_offset,
+                       uint64_t user_data, unsigned int flags)
+{
+    struct io_uring_sqe *sqe = get_sqe(engine);
+
+    if (engine->is_registered)
+    {
+        sqe->opcode = is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = slot_index;
+    }
+    else
+    {
+        sqe->opcode = is_write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)(engine->buffers + slot_index * engine->block_size + data_offset);
+    sqe->len = length;
+    sqe->off = (file_offset == -1) ? (uint64_t)-1 : (uint64_t)file_offset; // -1 for the current position
+    sqe->flags = flags;
+    sqe->user_data = user_data;
+}
+
+/**
+ * @brief Check whether the fd can be read or written at any offset,
+ * i.e. the regular files and the block devices.
+ *
+ * @param fd
+ * @param position the current position
+ * @param size the size of the file or the device, it is 0 for the files
+ * of procfs and sysfs. NULL if it is not needed.
+ * @return bool
+ */
+static bool is_seekable_fd(int fd, off_t *position, off_t *size)
+{
+    struct stat s;
+    if (fstat(fd, &s) != 0 || !(S_ISREG(s.st_mode) || S_ISBLK(s.st_mode)))
+    {
+        return false;
+    }
+
+    // the offset is ignored by the file opened with O_APPEND
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || (flags & O_APPEND) != 0)
+    {
+        return false;
+    }
+
+    *position = lseek(fd, 0, SEEK_CUR);
+    if (*position == -1)
+    {
+        return false;
+    }
+
+    if (size != NULL)
+    {
+        if (S_ISBLK(s.st_mode))
+        {
+            // the `st_size` of a block device is 0
+            *size = lseek(fd, 0, SEEK_END);
+            lseek(fd, *position, SEEK_SET);
+        }
+        else
+        {
+            *size = s.st_size;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Discard the slots read ahead after the short read of a block,
+ * they were read at wrong offsets.
+ *
+ * the slots whose reads are in flight are freed when the reads complete.
+ *
+ * @return unsigned int the number of the slots freed
+ */
+static unsigned int discard_slots_after(struct IoSlot *slots, unsigned int depth, uint64_t seq)
+{
+    unsigned int freed = 0;
+
+    for (unsigned int idx = 0; idx < depth; idx++)
+    {
+        struct IoSlot *slot = &slots[idx];
+        if (slot->state == SLOT_FREE || slot->seq <= seq || slot->is_discarded)
+        {
+            continue;
+        }
+
+        if (slot->state == SLOT_READY)
+        {
+            // it is not written yet, since the blocks are written in order
+            slot->state = SLOT_FREE;
+            freed++;
+        }
+        else
+        {
+            slot->is_discarded = true;
+        }
+    }
+
+    return freed;
+}
+
+static int write_all(int fd, const unsigned char *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return 0;
+}
+
+static int copy_sync(struct IoEngine *engine, int in_fd, const int *out_fds, int out_count,
+                     IoTransform transform, void *context)
+{
+    unsigned char *buffer = engine->buffers;
+
+    while (true)
+    {
+        ssize_t length = read(in_fd, buffer, engine->block_size);
+        if (length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            engine->error_fd = in_fd;
+            return errno;
+        }
+
+        if (length == 0)
+        {
+            return 0;
+        }
+
+        if (transform != NULL)
+        {
+            length = transform(context, buffer, length);
+        }
+
+        for (int idx = 0; idx < out_count; idx++)
+        {
+            int error_number = write_all(out_fds[idx], buffer, length);
+            if (error_number != 0)
+            {
+                engine->error_fd = out_fds[idx];
+                return error_number;
+            }
+        }
+    }
+}
+
+int ioengine_copy(struct IoEngine *engine, int in_fd, const int *out_fds, int out_count,
+                  IoTransform transform, void *context)
+{
+    engine->error_fd = -1;
+
+    if (engine->ring_fd == -1 || out_count > IOENGINE_MAX_OUTPUTS)
+    {
+        return copy_sync(engine, in_fd, out_fds, out_count, transform, context);
+    }
+
+    unsigned int depth = engine->queue_depth;
+    size_t block_size = engine->block_size;
+
+    struct IoSlot slots[IOENGINE_MAX_QUEUE_DEPTH];
+    memset(slots, 0, sizeof(slots));
+
+    struct IoOutput outputs[IOENGINE_MAX_OUTPUTS];
+    for (int idx = 0; idx < out_count; idx++)
+    {
+        outputs[idx] = (struct IoOutput){.fd = out_fds[idx]};
+        outputs[idx].is_seekable = is_seekable_fd(out_fds[idx], &outputs[idx].position, NULL);
+    }
+
+    // the blocks of a seekable input are read ahead at the offsets, up to
+    // its size, then it is read one block at a time until the end of file,
+    // since the file may grow, or the size is not the length of the content.
+    //
+    // the files of procfs and sysfs report size 0 (or the page size), and
+    // they may return short reads before the end, so they are read in order
+    // as a pipe, i.e. only one read is in flight.
+    off_t in_position = 0;
+    off_t in_size = 0;
+    bool is_in_seekable = is_seekable_fd(in_fd, &in_position, &in_size) && in_size > in_position;
+    bool is_read_ahead = is_in_seekable;
+    off_t next_offset = in_position; // the offset of the next read
+
+    bool is_linked = is_read_ahead && out_count == 1 && outputs[0].is_seekable && transform == NULL;
+    off_t out_start = outputs[0].position;
+
+    uint64_t next_read_seq = 0;
+    unsigned int reading = 0; // the reads in flight
+    bool is_eof = false;
+    unsigned int active = 0; // the slots which are not free
+    int error_number = 0;
+
+    while (error_number == 0)
+    {
+        // read ahead into the free slots
+        while (!is_eof)
+        {
+            unsigned int slot_index = next_read_seq % depth;
+            struct IoSlot *slot = &slots[slot_index];
+            if (slot->state != SLOT_FREE || (!is_read_ahead && reading > 0))
+            {
+                break;
+            }
+
+            if (is_read_ahead && next_offset >= in_size)
+            {
+                // the size is reached, read on one block at a time, and
+                // write in order.
+                is_read_ahead = false;
+                if (is_linked)
+                {
+                    is_linked = false;
+                    outputs[0].next_seq = next_read_seq;
+                    outputs[0].position = out_start + (next_offset - in_position);
+                }
+                continue;
+            }
+
+            slot->seq = next_read_seq;
+            slot->length = 0;
+            slot->is_discarded = false;
+            slot->in_offset = is_in_seekable ? next_offset : -1;
+            slot->requested = block_size;
+            if (is_read_ahead && (off_t)block_size > in_size - next_offset)
+            {
+                slot->requested = in_size - next_offset;
+            }
+
+            prepare_rw(engine, false, in_fd, slot_index, 0, slot->requested, slot->in_offset,
+                       MAKE_USER_DATA(REQUEST_READ, slot_index, 0), is_linked ? IOSQE_IO_LINK : 0);
+
+            if (is_linked)
+            {
+                // the write is canceled by the kernel if the read is short
+                slot->state = SLOT_LINKED;
+                slot->out_offset[0] = out_start + (next_offset - in_position);
+                slot->written[0] = 0;
+                prepare_rw(engine, true, outputs[0].fd, slot_index, 0, slot->requested, slot->out_offset[0],
+                           MAKE_USER_DATA(REQUEST_LINKED_WRITE, slot_index, 0), 0);
+            }
+            else
+            {
+                slot->state = SLOT_READING;
+            }
+
+            next_offset += slot->requested;
+            next_read_seq++;
+            reading++;
+            active++;
+        }
+
+        // write the blocks in order, a non-seekable output (e.g. a pipe or
+        // a terminal) has one write in flight at most.
+        for (int output_index = 0; output_index < out_count && !is_linked; output_index++)
+        {
+            struct IoOutput *output = &outputs[output_index];
+            while (output->is_seekable || !output->is_busy)
+            {
+                unsigned int slot_index = output->next_seq % depth;
+                struct IoSlot *slot = &slots[slot_index];
+                if (slot->state != SLOT_READY || slot->seq != output->next_seq)
+                {
+                    break;
+                }
+
+                output->next_seq++;
+
+                if (slot->length == 0)
+                {
+                    // the transform removed all data
+                    slot->pending--;
+                    if (slot->pending == 0)
+                    {
+                        slot->state = SLOT_FREE;
+                        active--;
+                    }
+                    continue;
+                }
+
+                slot->written[output_index] = 0;
+                slot->out_offset[output_index] = output->is_seekable ? output->position : -1;
+                output->position += slot->length;
+                output->is_busy = true;
+
+                prepare_rw(engine, true, output->fd, slot_index, 0, slot->length, slot->out_offset[output_index],
+                           MAKE_USER_DATA(REQUEST_WRITE, slot_index, output_index), 0);
+            }
+        }
+
+        if (active == 0)
+        {
+            break;
+        }
+
+        error_number = submit_and_wait(engine, 1);
+        if (error_number != 0)
+        {
+            break;
+        }
+
+        unsigned int head = *engine->cq_head;
+        unsigned int tail = __atomic_load_n(engine->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail && error_number == 0; head++)
+        {
+            engine->in_flight--;
+
+            struct io_uring_cqe *cqe = &engine->cqes[head & *engine->cq_mask];
+            int result = cqe->res;
+            unsigned int kind = USER_DATA_KIND(cqe->user_data);
+            unsigned int slot_index = USER_DATA_SLOT(cqe->user_data);
+            unsigned int output_index = USER_DATA_OUTPUT(cqe->user_data);
+            struct IoSlot *slot = &slots[slot_index];
+
+            if (kind == REQUEST_READ)
+            {
+                reading--;
+
+                if (result < 0)
+                {
+                    error_number = -result;
+                    engine->error_fd = in_fd;
+                    continue;
+                }
+
+                bool is_short = (size_t)result < slot->requested;
+
+                if (slot->is_discarded)
+                {
+                    // a linked block which is read fully is freed when
+                    // its write completes, the write of a short one has
+                    // been canceled.
+                    if (slot->state != SLOT_LINKED || is_short)
+                    {
+                        slot->state = SLOT_FREE;
+                        active--;
+                    }
+                    continue;
+                }
+
+                if (is_short && is_in_seekable)
+                {
+                    // the end of file, or the file is shorter than its size,
+                    // the blocks after this one were read at wrong offsets,
+                    // read on from the end of this block one at a time.
+                    active -= discard_slots_after(slots, depth, slot->seq);
+                    next_read_seq = slot->seq + 1;
+                    next_offset = slot->in_offset + result;
+                    is_read_ahead = false;
+
+                    if (slot->state == SLOT_LINKED)
+                    {
+                        // the linked write of this block has been canceled,
+                        // write it in order.
+                        is_linked = false;
+                        outputs[0].next_seq = slot->seq;
+                        outputs[0].position = slot->out_offset[0];
+                    }
+                }
+
+                if (result == 0)
+                {
+                    // the end of file, the linked write has been canceled
+                    is_eof = true;
+                    slot->state = SLOT_FREE;
+                    active--;
+                    continue;
+                }
+
+                slot->length = result;
+
+                if (slot->state == SLOT_LINKED && !is_short)
+                {
+                    // the linked write is in flight
+                    continue;
+                }
+
+                if (transform != NULL)
+                {
+                    slot->length = transform(context, engine->buffers + slot_index * block_size, result);
+                }
+
+                slot->state = SLOT_READY;
+                slot->pending = out_count;
+                continue;
+            }
+
+            if (kind == REQUEST_LINKED_WRITE && result == -ECANCELED)
+            {
+                // the read was short, check above
+                continue;
+            }
+
+            // the write of an output
+            struct IoOutput *output = &outputs[output_index];
+            if (result < 0)
+            {
+                error_number = -result;
+                engine->error_fd = output->fd;
+                continue;
+            }
+
+            size_t expected = (kind == REQUEST_LINKED_WRITE) ? slot->requested : slot->length;
+            slot->written[output_index] += result;
+
+            if (slot->written[output_index] < expected)
+            {
+                // a short write, write the remaining data
+                size_t written = slot->written[output_index];
+                off_t offset = (slot->out_offset[output_index] == -1) ? -1 : slot->out_offset[output_index] + (off_t)written;
+                prepare_rw(engine, true, output->fd, slot_index, written, expected - written, offset,
+                           MAKE_USER_DATA(kind, slot_index, output_index), 0);
+                continue;
+            }
+
+            output->is_busy = false;
+
+            if (kind == REQUEST_LINKED_WRITE)
+            {
+                slot->state = SLOT_FREE;
+                active--;
+                continue;
+            }
+
+            slot->pending--;
+            if (slot->pending == 0)
+            {
+                slot->state = SLOT_FREE;
+                active--;
+            }
+        }
+
+        __atomic_store_n(engine->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    if (error_number != 0)
+    {
+        drain_requests(engine);
+        return error_number;
+    }
+
+    // the requests with offsets do not move the file positions, move them
+    // as the synchronous I/O does.
+    if (is_in_seekable)
+    {
+        lseek(in_fd, next_offset, SEEK_SET);
+    }
+
+    for (int idx = 0; idx < out_count; idx++)
+    {
+        if (outputs[idx].is_seekable)
+        {
+            lseek(outputs[idx].fd, outputs[idx].position, SEEK_SET);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef IOENGINE_H
+#define IOENGINE_H
+
+// the I/O engine of the streaming applets, e.g. `cat`, `tee` and `tr`.
+//
+// the data is copied from an input to the outputs by a ring of buffers
+// (slots), up to `queue_depth` reads are kept in flight by io_uring, so
+// the CPU and the device overlap. the io_uring is driven by the raw system
+// calls, i.e. there is no dependency of liburing.
+//
+// - when both the input and the output are regular files (or block devices)
+//   and there is no transform, each read is linked with its write, so a
+//   block is copied without returning to the user space.
+// - otherwise the blocks are read ahead, and written in order.
+// - the input is read ahead at the offsets up to its size only, the files
+//   of procfs and sysfs (size 0) are read in order as a pipe, and a short
+//   read discards the blocks read ahead after it.
+// - if io_uring is not available (e.g. the kernel is built without it),
+//   the data is copied by the synchronous `read` and `write`.
+//
+// the queue depth can be overridden by the environment variable
+// `IOENGINE_QUEUE_DEPTH`, and 0 disables io_uring.
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define IOENGINE_DEFAULT_QUEUE_DEPTH 8
+#define IOENGINE_DEFAULT_BLOCK_SIZE (128 * 1024)
+#define IOENGINE_MAX_QUEUE_DEPTH 64
+#define IOENGINE_MAX_OUTPUTS 4
+
+/**
+ * @brief Transform a block in place before it is written, e.g. `tr`.
+ *
+ * @return size_t the new length, it must not be greater than the length
+ */
+typedef size_t (*IoTransform)(void *context, unsigned char *data, size_t length);
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+struct IoEngine
+{
+    int ring_fd; // -1 for the synchronous fallback
+    unsigned int queue_depth;
+    size_t block_size;
+    unsigned char *buffers; // queue_depth * block_size, aligned to the page
+    bool is_registered;     // the buffers are registered to the ring
+
+    int error_fd; // the fd which failed in the last `ioengine_copy()`
+
+    // the mapped rings
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_entries;
+    unsigned int *sq_array;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    unsigned int to_submit; // the prepared SQEs which have not been submitted
+    unsigned int in_flight; // the requests which have not completed
+};
+
+/**
+ * @brief Create the engine, it falls back to the synchronous I/O if
+ * io_uring is not available.
+ *
+ * @param engine
+ * @param queue_depth 0 for the default
+ * @param block_size 0 for the default
+ * @return bool false if failed to allocate the buffers
+ */
+bool ioengine_init(struct IoEngine *engine, unsigned int queue_depth, size_t block_size);
+
+void ioengine_destroy(struct IoEngine *engine);
+
+/**
+ * @brief Copy all data from the input to the outputs.
+ *
+ * @param engine
+ * @param in_fd
+ * @param out_fds
+ * @param out_count up to IOENGINE_MAX_OUTPUTS
+ * @param transform optional, it is applied to each block
+ * @param context the argument of the transform
+ * @return int 0, or the error number, the failed fd is `engine->error_fd`
+ */
+int ioengine_copy(struct IoEngine *engine, int in_fd, const int *out_fds, int out_count,
+                  IoTransform transform, void *context);
+
+#endif
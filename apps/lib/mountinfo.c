@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mountinfo.h"
+
+void unescape_mount_field(char *str)
+{
+    char *dst = str;
+    for (char *src = str; *src != '\0'; src++)
+    {
+        if (src[0] == '\\' &&
+            src[1] >= '0' && src[1] <= '7' &&
+            src[2] >= '0' && src[2] <= '7' &&
+            src[3] >= '0' && src[3] <= '7')
+        {
+            *dst++ = (src[1] - '0') * 64 + (src[2] - '0') * 8 + (src[3] - '0');
+            src += 3;
+        }
+        else
+        {
+            *dst++ = *src;
+        }
+    }
+
+    *dst = '\0';
+}
+
+/**
+ * @brief Parse a line of `/proc/self/mountinfo`.
+ *
+ * @param line it is modified
+ * @param entry
+ * @return bool false if the line is invalid
+ */
+static bool parse_line(char *line, struct MountEntry *entry)
+{
+    char *fields[5];
+    char *save_ptr;
+    char *field = strtok_r(line, " \n", &save_ptr);
+
+    for (int idx = 0; idx < 5; idx++)
+    {
+        if (field == NULL)
+        {
+            return false;
+        }
+
+        fields[idx] = field;
+        field = strtok_r(NULL, " \n", &save_ptr);
+    }
+
+    // skip the optional fields
+    while (field != NULL && strcmp(field, "-") != 0)
+    {
+        field = strtok_r(NULL, " \n", &save_ptr);
+    }
+
+    char *fstype = strtok_r(NULL, " \n", &save_ptr);
+    char *source = strtok_r(NULL, " \n", &save_ptr);
+    if (fstype == NULL || source == NULL)
+    {
+        return false;
+    }
+
+    unescape_mount_field(fields[4]);
+    unescape_mount_field(source);
+
+    entry->mount_id = atoi(fields[0]);
+    entry->parent_id = atoi(fields[1]);
+    entry->mount_point = strdup(fields[4]);
+    entry->fstype = strdup(fstype);
+    entry->source = strdup(source);
+    return true;
+}
+
+bool read_mountinfo(struct MountTable *table)
+{
+    table->entries = NULL;
+    table->count = 0;
+
+    FILE *file = fopen(MOUNTINFO_FILEPATH, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int capacity = 0;
+    char *line = NULL;
+    size_t len = 0;
+
+    while (getline(&line, &len, file) != -1)
+    {
+        if (table->count == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            struct MountEntry *entries = realloc(table->entries, capacity * sizeof(struct MountEntry));
+            if (entries == NULL)
+            {
+                break;
+            }
+            table->entries = entries;
+        }
+
+        if (parse_line(line, &table->entries[table->count]))
+        {
+            table->count++;
+        }
+    }
+
+    free(line);
+    fclose(file);
+    return true;
+}
+
+void free_mountinfo(struct MountTable *table)
+{
+    for (int idx = 0; idx < table->count; idx++)
+    {
+        free(table->entries[idx].mount_point);
+        free(table->entries[idx].fstype);
+        free(table->entries[idx].source);
+    }
+
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+}
+
+int find_mount(const struct MountTable *table, const char *mount_point)
+{
+    for (int idx = table->count - 1; idx >= 0; idx--)
+    {
+        if (strcmp(table->entries[idx].mount_point, mount_point) == 0)
+        {
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+bool is_path_under(const char *directory, const char *path)
+{
+    if (strcmp(directory, "/") == 0)
+    {
+        return path[0] == '/';
+    }
+
+    size_t len = strlen(directory);
+    while (len > 1 && directory[len - 1] == '/')
+    {
+        // ignore the trailing slashes
+        len--;
+    }
+
+    return strncmp(directory, path, len) == 0 &&
+           (path[len] == '/' || path[len] == '\0');
+}
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef MOUNTINFO_H
+#define MOUNTINFO_H
+
+// the parser of `/proc/self/mountinfo`, it is shared by `init`, `mount` and `umount`.
+//
+// the line of `/proc/self/mountinfo`:
+//
+// 36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+// (1)(2)(3)   (4)   (5)      (6)      (7)   (8) (9)   (10)         (11)
+//
+// (1) is the mount id, (2) is the parent id, (5) is the mount point,
+// (7) is zero or more optional fields terminated by (8) "-", (9) is the
+// filesystem type and (10) is the source. the mounts are listed in the
+// mount order, i.e. a mount is listed after its parent.
+//
+// check `man 5 proc`
+
+#include <stdbool.h>
+
+#define MOUNTINFO_FILEPATH "/proc/self/mountinfo"
+
+struct MountEntry
+{
+    int mount_id;
+    int parent_id;
+    char *mount_point; // unescaped
+    char *fstype;      //
+    char *source;      // unescaped
+};
+
+struct MountTable
+{
+    struct MountEntry *entries; // in the mount order
+    int count;
+};
+
+/**
+ * @brief Read and parse `/proc/self/mountinfo`.
+ *
+ * @param table
+ * @return bool false if the file can not be read (e.g. `/proc` is not
+ * mounted), `errno` is set.
+ */
+bool read_mountinfo(struct MountTable *table);
+
+void free_mountinfo(struct MountTable *table);
+
+/**
+ * @brief Find the last (i.e. the top) mount on the mount point.
+ *
+ * @param table
+ * @param mount_point
+ * @return int the index of the entry, or -1 if not found
+ */
+int find_mount(const struct MountTable *table, const char *mount_point);
+
+/**
+ * @brief Check whether the path is the directory or under the directory,
+ * e.g. "/mnt" and "/mnt/a" are under "/mnt", "/mnt2" is not.
+ *
+ * @param directory
+ * @param path
+ * @return bool
+ */
+bool is_path_under(const char *directory, const char *path);
+
+/**
+ * @brief Decode the octal escapes (e.g. "\040" for space) in place.
+ *
+ * @param str
+ */
+void unescape_mount_field(char *str);
+
+#endif
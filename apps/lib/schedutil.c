@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "schedutil.h"
+
+bool parse_cpu_list(const char *text, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    const char *ptr = text;
+    while (*ptr != '\0')
+    {
+        char *end;
+        long first = strtol(ptr, &end, 10);
+        if (end == ptr || first < 0)
+        {
+            return false;
+        }
+
+        long last = first;
+        ptr = end;
+
+        if (*ptr == '-')
+        {
+            ptr++;
+            last = strtol(ptr, &end, 10);
+            if (end == ptr || last < first)
+            {
+                return false;
+            }
+            ptr = end;
+        }
+
+        if (last >= CPU_SETSIZE)
+        {
+            return false;
+        }
+
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            CPU_SET(cpu, set);
+        }
+
+        if (*ptr == ',')
+        {
+            ptr++;
+        }
+        else if (*ptr != '\0')
+        {
+            return false;
+        }
+    }
+
+    return CPU_COUNT(set) > 0;
+}
+
+bool parse_cpu_mask(const char *text, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    if (text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+    {
+        text += 2;
+    }
+
+    size_t len = strlen(text);
+    if (len == 0)
+    {
+        return false;
+    }
+
+    // the last digit is CPU 0-3
+    for (size_t idx = 0; idx < len; idx++)
+    {
+        char ch = text[len - 1 - idx];
+        if (!isxdigit((unsigned char)ch))
+        {
+            return false;
+        }
+
+        int digit = isdigit((unsigned char)ch) ? ch - '0' : tolower((unsigned char)ch) - 'a' + 10;
+        for (int bit = 0; bit < 4; bit++)
+        {
+            if ((digit & (1 << bit)) != 0)
+            {
+                size_t cpu = idx * 4 + bit;
+                if (cpu >= CPU_SETSIZE)
+                {
+                    return false;
+                }
+
+                CPU_SET(cpu, set);
+            }
+        }
+    }
+
+    return CPU_COUNT(set) > 0;
+}
+
+void format_cpu_list(const cpu_set_t *set, char *buf, size_t buf_len)
+{
+    size_t pos = 0;
+    buf[0] = '\0';
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, set))
+        {
+            continue;
+        }
+
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set))
+        {
+            last++;
+        }
+
+        int written;
+        if (last == cpu)
+        {
+            written = snprintf(buf + pos, buf_len - pos, "%s%d", pos == 0 ? "" : ",", cpu);
+        }
+        else
+        {
+            written = snprintf(buf + pos, buf_len - pos, "%s%d-%d", pos == 0 ? "" : ",", cpu, last);
+        }
+
+        if (written < 0 || (size_t)written >= buf_len - pos)
+        {
+            // truncated
+            return;
+        }
+
+        pos += written;
+        cpu = last;
+    }
+}
+
+int parse_sched_policy(const char *name)
+{
+    if (strcmp(name, "other") == 0)
+    {
+        return SCHED_OTHER;
+    }
+    else if (strcmp(name, "batch") == 0)
+    {
+        return SCHED_BATCH;
+    }
+    else if (strcmp(name, "idle") == 0)
+    {
+        return SCHED_IDLE;
+    }
+    else if (strcmp(name, "fifo") == 0)
+    {
+        return SCHED_FIFO;
+    }
+    else if (strcmp(name, "rr") == 0)
+    {
+        return SCHED_RR;
+    }
+    else
+    {
+        return -1;
+    }
+}
+
+const char *get_sched_policy_name(int policy)
+{
+    switch (policy & ~SCHED_RESET_ON_FORK)
+    {
+    case SCHED_OTHER:
+        return "SCHED_OTHER";
+    case SCHED_BATCH:
+        return "SCHED_BATCH";
+    case SCHED_IDLE:
+        return "SCHED_IDLE";
+    case SCHED_FIFO:
+        return "SCHED_FIFO";
+    case SCHED_RR:
+        return "SCHED_RR";
+    default:
+        return "unknown";
+    }
+}
+
+int parse_ioprio(const char *text)
+{
+    int class;
+    const char *level_text = strchr(text, ':');
+    size_t class_len = (level_text != NULL) ? (size_t)(level_text - text) : strlen(text);
+
+    if (strncmp(text, "rt", class_len) == 0 && class_len == 2)
+    {
+        class = IOPRIO_CLASS_RT;
+    }
+    else if (strncmp(text, "be", class_len) == 0 && class_len == 2)
+    {
+        class = IOPRIO_CLASS_BE;
+    }
+    else if (strncmp(text, "idle", class_len) == 0 && class_len == 4)
+    {
+        class = IOPRIO_CLASS_IDLE;
+    }
+    else if (strncmp(text, "none", class_len) == 0 && class_len == 4)
+    {
+        class = IOPRIO_CLASS_NONE;
+    }
+    else
+    {
+        return -1;
+    }
+
+    int level = 4;
+    if (level_text != NULL)
+    {
+        char *end;
+        level = strtol(level_text + 1, &end, 10);
+        if (end == level_text + 1 || *end != '\0' || level < 0 || level > 7)
+        {
+            return -1;
+        }
+    }
+
+    if (class == IOPRIO_CLASS_IDLE || class == IOPRIO_CLASS_NONE)
+    {
+        // the level is ignored by these classes
+        level = 0;
+    }
+
+    return IOPRIO_PRIO_VALUE(class, level);
+}
+
+const char *get_ioprio_class_name(int class)
+{
+    switch (class)
+    {
+    case IOPRIO_CLASS_NONE:
+        return "none";
+    case IOPRIO_CLASS_RT:
+        return "realtime";
+    case IOPRIO_CLASS_BE:
+        return "best-effort";
+    case IOPRIO_CLASS_IDLE:
+        return "idle";
+    default:
+        return "unknown";
+    }
+}
+
+// glibc does not provide the wrappers of these system calls
+
+int ioprio_set(int which, int who, int ioprio)
+{
+    return syscall(SYS_ioprio_set, which, who, ioprio);
+}
+
+int ioprio_get(int which, int who)
+{
+    return syscall(SYS_ioprio_get, which, who);
+}
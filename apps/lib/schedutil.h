@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SCHEDUTIL_H
+#define SCHEDUTIL_H
+
+// the helpers for the CPU affinity, the scheduling policy and the I/O priority,
+// they are shared by `init` and the applets `taskset`, `chrt` and `ionice`.
+//
+// `cpu_set_t` requires `_GNU_SOURCE` to be defined before including any header.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sched.h>
+
+// check `man 2 ioprio_set`
+#define IOPRIO_CLASS_NONE 0
+#define IOPRIO_CLASS_RT 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_PRIO_MASK ((1 << IOPRIO_CLASS_SHIFT) - 1)
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+#define IOPRIO_PRIO_CLASS(value) ((value) >> IOPRIO_CLASS_SHIFT)
+#define IOPRIO_PRIO_DATA(value) ((value) & IOPRIO_PRIO_MASK)
+
+#define IOPRIO_WHO_PROCESS 1
+
+/**
+ * @brief Parse the CPU list, e.g. "0", "0-3", "0,2,4-7".
+ *
+ * @param text
+ * @param set
+ * @return bool false if the text is invalid
+ */
+bool parse_cpu_list(const char *text, cpu_set_t *set);
+
+/**
+ * @brief Parse the hexadecimal CPU mask, e.g. "3", "0x3", "ff00".
+ *
+ * @param text
+ * @param set
+ * @return bool false if the text is invalid
+ */
+bool parse_cpu_mask(const char *text, cpu_set_t *set);
+
+/**
+ * @brief Format the CPU set as a list, e.g. "0-3,6".
+ *
+ * @param set
+ * @param buf
+ * @param buf_len
+ */
+void format_cpu_list(const cpu_set_t *set, char *buf, size_t buf_len);
+
+/**
+ * @brief Parse the scheduling policy name, i.e. "other", "batch",
+ * "idle", "fifo" and "rr".
+ *
+ * @param name
+ * @return int SCHED_*, or -1 if the name is invalid
+ */
+int parse_sched_policy(const char *name);
+
+const char *get_sched_policy_name(int policy);
+
+/**
+ * @brief Parse the I/O priority, e.g. "rt:0", "be:4", "idle", "none".
+ * the level (0 is the highest, 7 is the lowest) is 4 if omitted.
+ *
+ * @param text
+ * @return int the I/O priority value, or -1 if the text is invalid
+ */
+int parse_ioprio(const char *text);
+
+const char *get_ioprio_class_name(int class);
+
+int ioprio_set(int which, int who, int ioprio);
+int ioprio_get(int which, int who);
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+#ifndef SWAR_H
+#define SWAR_H
+
+#include <stdint.h>
+#include <string.h>
+
+// SWAR (SIMD within a register) helpers, the 8 bytes of a 64-bit word are
+// processed at once, they are used by the text applets, e.g. `wc` and `grep`.
+//
+// a "byte mask" has the bit 7 set in each selected byte and all other bits
+// clear, so it can be combined by `&`, `|` and `~` (then `& SWAR_HIGH_BITS`),
+// and counted by `swar_count()`.
+//
+// the byte 0 (the first byte in memory) is the lowest byte of the word.
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "the SWAR helpers require a little endian target"
+#endif
+
+#define SWAR_ONES 0x0101010101010101ULL
+#define SWAR_LOW_BITS 0x7f7f7f7f7f7f7f7fULL
+#define SWAR_HIGH_BITS 0x8080808080808080ULL
+
+static inline uint64_t swar_load(const void *ptr)
+{
+    // compiled to a single (unaligned) load
+    uint64_t word;
+    memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+static inline uint64_t swar_broadcast(unsigned char value)
+{
+    return SWAR_ONES * value;
+}
+
+/**
+ * @brief The byte mask of the zero bytes, there is no false positive, i.e.
+ * unlike the well known `(x - 0x01..) & ~x & 0x80..`, the bytes after
+ * a zero byte are exact too.
+ */
+static inline uint64_t swar_zero_bytes(uint64_t word)
+{
+    uint64_t low = (word & SWAR_LOW_BITS) + SWAR_LOW_BITS;
+    return ~(low | word | SWAR_LOW_BITS);
+}
+
+/**
+ * @brief The byte mask of the bytes equal to the value of each byte of the
+ * pattern, the pattern is from `swar_broadcast()`.
+ */
+static inline uint64_t swar_equal_bytes(uint64_t word, uint64_t pattern)
+{
+    return swar_zero_bytes(word ^ pattern);
+}
+
+/**
+ * @brief The byte mask of the bytes in the range [low, high], the bound
+ * must be less than 0x80.
+ */
+static inline uint64_t swar_range_bytes(uint64_t word, unsigned char low, unsigned char high)
+{
+    // the bit 7 of (x + 0x80 - n) is set iff x >= n, there is no carry
+    // between the bytes because both x and (0x80 - n) are less than 0x80.
+    uint64_t value = word & SWAR_LOW_BITS;
+    uint64_t greater_equal_low = value + swar_broadcast(0x80 - low);
+    uint64_t greater_high = value + swar_broadcast(0x80 - high - 1);
+    return greater_equal_low & ~greater_high & ~word & SWAR_HIGH_BITS;
+}
+
+/**
+ * @brief The byte mask of the ASCII white spaces, i.e. ' ', '\t', '\n',
+ * '\v', '\f' and '\r'.
+ */
+static inline uint64_t swar_space_bytes(uint64_t word)
+{
+    return swar_equal_bytes(word, swar_broadcast(' ')) | swar_range_bytes(word, '\t', '\r');
+}
+
+/**
+ * @brief The byte mask of the UTF-8 continuation bytes, i.e. 0b10xxxxxx.
+ */
+static inline uint64_t swar_continuation_bytes(uint64_t word)
+{
+    // the bit 6 is moved to the bit 7 of the same byte
+    return word & ~(word << 1) & SWAR_HIGH_BITS;
+}
+
+/**
+ * @brief Count the selected bytes of a byte mask.
+ */
+static inline unsigned int swar_count(uint64_t mask)
+{
+    // each byte becomes 0 or 1, and they are summed into the highest byte
+    return ((mask >> 7) * SWAR_ONES) >> 56;
+}
+
+/**
+ * @brief The index of the first selected byte, the mask must not be 0.
+ */
+static inline unsigned int swar_first_index(uint64_t mask)
+{
+    return __builtin_ctzll(mask) / 8;
+}
+
+#endif
@@ -6,22 +6,443 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
-#define _DEFAULT_SOURCE
+// enable the GNU extensions, e.g. `statx()`
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/sysmacros.h>
 #include <time.h>
 #include <errno.h>
 
-#define MAX_PATH_LENGTH 1024
+// the entries are read by `getdents64` in large batches instead of one
+// `readdir` at a time, and stated relative to the fd of the directory by
+// `statx` (falling back to `fstatat`), so neither the number of system calls
+// nor the path lookup depends on the length of the directory path.
+//
+// the entries of a directory are collected into an arena (check `struct EntryList`),
+// sorted, and then formatted into a large buffer and written by a few `write`.
+//
+// `ls -R` and `du` (the program is also linked as `du`) walk the directory
+// tree by multiple threads, check `walk_trees()`.
+
+#define DIRENT_BUFFER_SIZE (64 * 1024)
+#define OUTPUT_BUFFER_SIZE (64 * 1024)
+#define TIME_TEXT_LENGTH 32
+#define DEFAULT_TERMINAL_WIDTH 80
+#define COLUMN_SPACING 2
+#define MAX_WORKERS 32
+
+// check `man 2 getdents64`
+struct linux_dirent64
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+enum ListFormat
+{
+    FORMAT_LONG,    // the default (or `-l`), type, permissions, size, time and name
+    FORMAT_NAME,    // `-1`, the name only, one per line
+    FORMAT_COLUMNS, // `-C`, the names in columns
+};
+
+enum SortOrder
+{
+    SORT_NAME, // the default
+    SORT_SIZE, // `-S`, the largest first
+    SORT_TIME, // `-t`, the newest first
+};
+
+// the fields of `stat` required by the output
+struct EntryStat
+{
+    mode_t mode;
+    off_t size;
+    time_t mtime;
+    long mtime_nsec;
+
+    // `du` only
+    uint64_t blocks; // the number of 512-byte blocks
+    nlink_t nlink;
+    dev_t dev;
+    ino_t ino;
+};
+
+// a directory entry, 40 bytes.
+//
+// the records are stored contiguously and the names are stored in a separate
+// byte arena, so that sorting moves the small records only, and most of the
+// comparisons by name are decided by the prefix key without touching the names.
+struct EntryRecord
+{
+    uint64_t name_key; // the first 8 bytes of the name, big endian, zero padded
+    int64_t size;
+    int64_t mtime;
+    uint32_t mtime_nsec;
+    uint32_t name_offset; // the offset of the name in the arena
+    uint32_t mode;
+    uint16_t name_length;
+};
+
+struct EntryList
+{
+    struct EntryRecord *records;
+    size_t count;
+    size_t capacity;
+    char *names; // the arena of the NULL terminated names
+    size_t names_length;
+    size_t names_capacity;
+};
+
+// the errors of the entries of a directory, they are printed along with
+// the output of the directory, so the order of the messages is kept even
+// the directories are read by multiple threads.
+//
+// each line is "error_number name\n", the empty name is the directory itself.
+struct ErrorLog
+{
+    char *text;
+    size_t length;
+    size_t capacity;
+};
+
+// a directory of the tree of `ls -R` and `du`
+struct DirNode
+{
+    struct DirNode *parent;
+    char *name; // the name in the parent directory, or the path of the root
+    int fd;     // closed when all children have opened themselves
+    atomic_size_t fd_users;
+    bool is_listed; // false if the directory failed to open, or it has been visited
+
+    struct EntryList list; // `ls` only
+
+    struct DirNode **children; // in the output order
+    size_t child_count;
+    size_t child_capacity;
+
+    uint64_t blocks; // `du` only, the directory itself and its non-directory entries
+    uint64_t bytes;  //
+
+    struct ErrorLog errors;
+};
+
+// a deque of the directories to read, the owner worker pushes and pops at
+// the tail (depth first, the fds of the parents are closed sooner), the
+// other workers steal from the head (the larger subtrees).
+struct WorkQueue
+{
+    pthread_mutex_t mutex;
+    struct DirNode **items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+};
+
+// the (dev, ino) of the visited directories, and of the files with multiple
+// hard links for `du`.
+struct VisitedKey
+{
+    dev_t dev;
+    ino_t ino;
+};
+
+struct VisitedSet
+{
+    pthread_mutex_t mutex;
+    struct VisitedKey *keys; // open addressing, {0, 0} is empty
+    size_t count;
+    size_t capacity; // power of 2
+};
+
+enum ListFormat list_format = FORMAT_LONG;
+enum SortOrder sort_order = SORT_NAME;
+bool is_classify = false;
+bool is_reverse = false;
+bool is_recursive = false;
+int exit_code = EXIT_SUCCESS;
+
+char *program_name = "ls";
+bool is_du = false;
+bool is_summary = false;       // `du -s`
+bool is_apparent_size = false; // `du -b`
+
+struct WorkQueue work_queues[MAX_WORKERS];
+int number_of_workers = 1;
+atomic_size_t pending_tasks = 0; // pushed but not finished
+atomic_uint_fast64_t work_generation = 0;
+atomic_int idle_workers = 0;
+pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+
+struct VisitedSet visited_set = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+char output_buffer[OUTPUT_BUFFER_SIZE];
+size_t output_length = 0;
+
+void write_all(const char *data, size_t len)
+{
+    size_t offset = 0;
+    while (offset < len)
+    {
+        ssize_t written = write(STDOUT_FILENO, data + offset, len - offset);
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // e.g. the pipe is closed
+            exit(EXIT_FAILURE);
+        }
+        offset += written;
+    }
+}
+
+void flush_output(void)
+{
+    write_all(output_buffer, output_length);
+    output_length = 0;
+}
+
+void write_output(const char *data, size_t len)
+{
+    if (output_length + len > OUTPUT_BUFFER_SIZE)
+    {
+        flush_output();
+    }
+
+    if (len > OUTPUT_BUFFER_SIZE)
+    {
+        // larger than the whole buffer
+        write_all(data, len);
+        return;
+    }
+
+    memcpy(output_buffer + output_length, data, len);
+    output_length += len;
+}
+
+void format_output(const char *format, ...)
+{
+    // format in place, flush and format again if the remaining space
+    // is not enough.
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        size_t remain = OUTPUT_BUFFER_SIZE - output_length;
+
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(output_buffer + output_length, remain, format, args);
+        va_end(args);
+
+        if (len < 0)
+        {
+            return;
+        }
+
+        if ((size_t)len < remain)
+        {
+            output_length += len;
+            return;
+        }
+
+        flush_output();
+    }
+}
+
+/**
+ * @brief Report an error and continue, the exit code is set to failure.
+ *
+ * @param path
+ * @param error_number
+ */
+void report_error(const char *path, int error_number)
+{
+    // keep the order of the output and the error messages
+    flush_output();
+    fprintf(stderr, "%s: %s: %s\n", program_name, path, strerror(error_number));
+    exit_code = EXIT_FAILURE;
+}
+
+void log_error(struct ErrorLog *log, const char *name, int error_number)
+{
+    size_t required = log->length + strlen(name) + 16;
+    if (required > log->capacity)
+    {
+        size_t capacity = (log->capacity == 0) ? 256 : log->capacity;
+        while (capacity < required)
+        {
+            capacity *= 2;
+        }
+
+        char *text = realloc(log->text, capacity);
+        if (text == NULL)
+        {
+            return;
+        }
+        log->text = text;
+        log->capacity = capacity;
+    }
+
+    log->length += sprintf(log->text + log->length, "%d %s\n", error_number, name);
+}
+
+/**
+ * @brief Print and clear the errors.
+ *
+ * @param log
+ * @param directory the path of the directory
+ */
+void print_errors(struct ErrorLog *log, const char *directory)
+{
+    if (log->length == 0)
+    {
+        return;
+    }
+
+    flush_output();
+
+    char *line = log->text;
+    char *end = log->text + log->length;
+    while (line < end)
+    {
+        char *name;
+        int error_number = strtol(line, &name, 10);
+        name++; // skip the space
+
+        char *newline = memchr(name, '\n', end - name);
+        *newline = '\0';
+
+        if (name[0] == '\0')
+        {
+            fprintf(stderr, "%s: %s: %s\n", program_name, directory, strerror(error_number));
+        }
+        else
+        {
+            bool has_slash = directory[strlen(directory) - 1] == '/';
+            fprintf(stderr, "%s: %s%s%s: %s\n", program_name, directory,
+                    has_slash ? "" : "/", name, strerror(error_number));
+        }
+
+        line = newline + 1;
+    }
+
+    log->length = 0;
+    exit_code = EXIT_FAILURE;
+}
+
+/**
+ * @brief Get the attributes of the entry relative to the directory,
+ * without following the symbolic link.
+ *
+ * @param dir_fd AT_FDCWD for the current directory
+ * @param name
+ * @param entry_stat
+ * @return int 0, or the error number
+ */
+int get_entry_stat(int dir_fd, const char *name, struct EntryStat *entry_stat)
+{
+    static bool is_statx_unavailable = false;
+
+    if (!is_statx_unavailable)
+    {
+        // only the required fields are requested, the filesystems such as
+        // NFS and FUSE can skip the other fields.
+        unsigned int mask = STATX_TYPE | STATX_MODE | STATX_SIZE | STATX_MTIME;
+        if (is_du)
+        {
+            mask |= STATX_BLOCKS | STATX_NLINK | STATX_INO;
+        }
+
+        struct statx stx;
+        if (statx(dir_fd, name, AT_SYMLINK_NOFOLLOW, mask, &stx) == 0)
+        {
+            entry_stat->mode = stx.stx_mode;
+            entry_stat->size = stx.stx_size;
+            entry_stat->mtime = stx.stx_mtime.tv_sec;
+            entry_stat->mtime_nsec = stx.stx_mtime.tv_nsec;
+            entry_stat->blocks = stx.stx_blocks;
+            entry_stat->nlink = stx.stx_nlink;
+            entry_stat->dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+            entry_stat->ino = stx.stx_ino;
+            return 0;
+        }
+
+        if (errno != ENOSYS)
+        {
+            return errno;
+        }
+
+        // Linux < 4.11
+        is_statx_unavailable = true;
+    }
+
+    struct stat s;
+    if (fstatat(dir_fd, name, &s, AT_SYMLINK_NOFOLLOW) != 0)
+    {
+        return errno;
+    }
+
+    entry_stat->mode = s.st_mode;
+    entry_stat->size = s.st_size;
+    entry_stat->mtime = s.st_mtim.tv_sec;
+    entry_stat->mtime_nsec = s.st_mtim.tv_nsec;
+    entry_stat->blocks = s.st_blocks;
+    entry_stat->nlink = s.st_nlink;
+    entry_stat->dev = s.st_dev;
+    entry_stat->ino = s.st_ino;
+    return 0;
+}
+
+/**
+ * @brief Format the time as `ctime()` does, e.g. "Wed Jun 30 21:49:08 1993".
+ *
+ * the entries of a directory often have the same modification time,
+ * the last result is cached.
+ *
+ * @param t
+ * @return const char*
+ */
+const char *format_time(time_t t)
+{
+    static time_t last_time = -1;
+    static char text[TIME_TEXT_LENGTH];
+
+    if (t != last_time)
+    {
+        struct tm tm;
+        if (localtime_r(&t, &tm) == NULL ||
+            strftime(text, sizeof(text), "%a %b %e %H:%M:%S %Y", &tm) == 0)
+        {
+            strcpy(text, "?");
+        }
+        last_time = t;
+    }
 
-void print_item(char *name, struct stat *s)
+    return text;
+}
+
+char get_type_char(mode_t mode)
 {
     // about `stat->st_mode`
     // MSB                             LSB
@@ -32,136 +453,1396 @@ void print_item(char *name, struct stat *s)
     //
     // check _The Linux Programming Interface_ session 15.1
 
-    char type;
-    switch (s->st_mode & S_IFMT)
+    switch (mode & S_IFMT)
     {
     case S_IFBLK:
-        type = 'b';
-        break;
+        return 'b';
     case S_IFCHR:
-        type = 'c';
-        break;
+        return 'c';
     case S_IFDIR:
-        type = 'd';
-        break;
+        return 'd';
     case S_IFIFO:
-        type = 'f';
-        break;
+        return 'f';
     case S_IFLNK:
-        type = 'l';
-        break;
+        return 'l';
     case S_IFREG:
-        type = ' ';
-        break;
+        return ' ';
     case S_IFSOCK:
-        type = 's';
-        break;
+        return 's';
     default:
-        type = '?';
-        break;
+        return '?';
     }
-
-    int permissions = s->st_mode & 07777;
-    long int size = s->st_size;
-    char *last_modified = ctime(&s->st_mtim.tv_sec);
-    last_modified[strlen(last_modified) - 1] = '\0'; // remove the last '\n' char.
-
-    printf("%c %04o %10ld %s %s\n", type, permissions, size, last_modified, name);
 }
 
-void list_file(char *filepath)
+/**
+ * @brief Get the indicator of `-F`.
+ *
+ * @param mode only the file type bits are required, except the regular file
+ * @return char '\0' for none
+ */
+char get_classify_char(mode_t mode)
 {
-    struct stat s;
-    if (lstat(filepath, &s) == -1)
+    switch (mode & S_IFMT)
     {
-        perror("list");
-        exit(EXIT_FAILURE);
+    case S_IFDIR:
+        return '/';
+    case S_IFLNK:
+        return '@';
+    case S_IFIFO:
+        return '|';
+    case S_IFSOCK:
+        return '=';
+    case S_IFREG:
+        return (mode & (S_IXUSR | S_IXGRP | S_IXOTH)) != 0 ? '*' : '\0';
+    default:
+        return '\0';
     }
-
-    print_item(basename(filepath), &s);
 }
 
-void list_directory(char *filepath)
+/**
+ * @brief Convert the `d_type` of the directory entry to the file type bits of `st_mode`.
+ *
+ * @param d_type
+ * @return mode_t 0 for DT_UNKNOWN, i.e. the filesystem does not provide the type.
+ */
+mode_t get_dirent_mode(unsigned char d_type)
 {
-    char fullpath[MAX_PATH_LENGTH];
+    switch (d_type)
+    {
+    case DT_BLK:
+        return S_IFBLK;
+    case DT_CHR:
+        return S_IFCHR;
+    case DT_DIR:
+        return S_IFDIR;
+    case DT_FIFO:
+        return S_IFIFO;
+    case DT_LNK:
+        return S_IFLNK;
+    case DT_REG:
+        return S_IFREG;
+    case DT_SOCK:
+        return S_IFSOCK;
+    default:
+        return 0;
+    }
+}
 
-    DIR *dir = opendir(filepath);
-    if (dir == NULL)
+/**
+ * @brief Append an entry to the list, the arena grows as needed.
+ *
+ * @param list
+ * @param name
+ * @param name_length
+ * @param entry_stat
+ * @return bool false if out of memory
+ */
+bool add_entry(struct EntryList *list,
+               const char *name,
+               size_t name_length,
+               const struct EntryStat *entry_stat)
+{
+    if (list->count == list->capacity)
     {
-        perror("opendir");
-        exit(EXIT_FAILURE);
+        size_t capacity = (list->capacity == 0) ? 16 : list->capacity * 2;
+        struct EntryRecord *records = realloc(list->records, capacity * sizeof(struct EntryRecord));
+        if (records == NULL)
+        {
+            return false;
+        }
+        list->records = records;
+        list->capacity = capacity;
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL)
+    if (list->names_length + name_length + 1 > list->names_capacity)
     {
-        char *name = entry->d_name;
-        if (strcmp(name, ".") == 0 ||
-            strcmp(name, "..") == 0)
+        size_t capacity = (list->names_capacity == 0) ? 256 : list->names_capacity;
+        while (list->names_length + name_length + 1 > capacity)
         {
-            continue;
+            capacity *= 2;
         }
 
-        // join file path and name
-        strcpy(fullpath, filepath);
-        if (filepath[strlen(filepath) - 1] != '/')
+        char *names = realloc(list->names, capacity);
+        if (names == NULL)
         {
-            strcat(fullpath, "/");
+            return false;
         }
-        strcat(fullpath, name);
+        list->names = names;
+        list->names_capacity = capacity;
+    }
 
-        list_file(fullpath);
+    struct EntryRecord *record = &list->records[list->count];
+
+    uint64_t key = 0;
+    for (size_t idx = 0; idx < 8; idx++)
+    {
+        key = (key << 8) | (idx < name_length ? (unsigned char)name[idx] : 0);
     }
 
-    closedir(dir);
+    record->name_key = key;
+    record->size = entry_stat->size;
+    record->mtime = entry_stat->mtime;
+    record->mtime_nsec = entry_stat->mtime_nsec;
+    record->name_offset = list->names_length;
+    record->mode = entry_stat->mode;
+    record->name_length = name_length;
+
+    memcpy(list->names + list->names_length, name, name_length + 1);
+    list->names_length += name_length + 1;
+    list->count++;
+    return true;
 }
 
-void list(char *filepath)
+void clear_entries(struct EntryList *list)
 {
-    struct stat s;
-    if (lstat(filepath, &s) == -1)
+    // keep the memory for the next directory
+    list->count = 0;
+    list->names_length = 0;
+}
+
+int compare_names(const struct EntryRecord *left,
+                  const struct EntryRecord *right,
+                  const struct EntryList *list)
+{
+    if (left->name_key != right->name_key)
+    {
+        return (left->name_key < right->name_key) ? -1 : 1;
+    }
+
+    // the first 8 bytes are the same
+    return strcmp(list->names + left->name_offset, list->names + right->name_offset);
+}
+
+int compare_entries(const void *left_ptr, const void *right_ptr, void *arg)
+{
+    const struct EntryRecord *left = left_ptr;
+    const struct EntryRecord *right = right_ptr;
+    const struct EntryList *list = arg;
+
+    int result = 0;
+
+    switch (sort_order)
     {
-        if (errno == ENOENT)
+    case SORT_SIZE:
+        if (left->size != right->size)
         {
-            printf("File %s does not exist\n", filepath);
+            result = (left->size > right->size) ? -1 : 1;
         }
-        else
+        break;
+    case SORT_TIME:
+        if (left->mtime != right->mtime)
+        {
+            result = (left->mtime > right->mtime) ? -1 : 1;
+        }
+        else if (left->mtime_nsec != right->mtime_nsec)
         {
-            perror("list");
+            result = (left->mtime_nsec > right->mtime_nsec) ? -1 : 1;
         }
+        break;
+    case SORT_NAME:
+        break;
+    }
 
-        exit(EXIT_FAILURE);
+    if (result == 0)
+    {
+        result = compare_names(left, right, list);
     }
 
-    if (S_ISDIR(s.st_mode))
+    return is_reverse ? -result : result;
+}
+
+void sort_entries(struct EntryList *list)
+{
+    qsort_r(list->records, list->count, sizeof(struct EntryRecord), compare_entries, list);
+}
+
+/**
+ * @brief Get the number of bytes of the name with the type indicator.
+ *
+ * @param record
+ * @return size_t
+ */
+size_t get_display_length(const struct EntryRecord *record)
+{
+    return record->name_length +
+           ((is_classify && get_classify_char(record->mode) != '\0') ? 1 : 0);
+}
+
+void print_name(const char *name, mode_t mode)
+{
+    char indicator = is_classify ? get_classify_char(mode) : '\0';
+    if (indicator != '\0')
     {
-        printf("%s:\n", filepath);
-        list_directory(filepath);
-        putchar('\n');
+        format_output("%s%c", name, indicator);
     }
     else
     {
-        print_item(filepath, &s);
+        format_output("%s", name);
     }
 }
 
-int main(int argc, char **argv)
+void print_item(const char *name, const struct EntryStat *entry_stat)
 {
-    // usage:
-    // ls
-    // ls file1 file2 ...
+    if (list_format == FORMAT_LONG)
+    {
+        format_output("%c %04o %10lld %s ",
+                      get_type_char(entry_stat->mode),
+                      entry_stat->mode & 07777,
+                      (long long)entry_stat->size,
+                      format_time(entry_stat->mtime));
+    }
+
+    print_name(name, entry_stat->mode);
+    write_output("\n", 1);
+}
 
-    if (argc == 1)
+int get_terminal_width(void)
+{
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
     {
-        list_directory(".");
+        return ws.ws_col;
     }
-    else
+
+    char *columns = getenv("COLUMNS");
+    if (columns != NULL && atoi(columns) > 0)
+    {
+        return atoi(columns);
+    }
+
+    return DEFAULT_TERMINAL_WIDTH;
+}
+
+/**
+ * @brief Print the names in columns, sorted vertically (i.e. down the
+ * columns first), with the fewest rows that fit the terminal width.
+ *
+ * @param list
+ */
+void print_columns(const struct EntryList *list)
+{
+    size_t count = list->count;
+    if (count == 0)
+    {
+        return;
+    }
+
+    size_t width = get_terminal_width();
+
+    // the rows can not be less than the total length divided by the width,
+    // start from there to avoid trying every number of rows.
+    size_t total_length = 0;
+    for (size_t idx = 0; idx < count; idx++)
+    {
+        total_length += get_display_length(&list->records[idx]) + COLUMN_SPACING;
+    }
+
+    size_t rows = (total_length + width - 1) / width;
+    if (rows == 0)
+    {
+        rows = 1;
+    }
+
+    size_t *column_widths = malloc(count * sizeof(size_t));
+    if (column_widths == NULL)
+    {
+        rows = count;
+    }
+
+    size_t columns = 1;
+    for (; rows < count; rows++)
     {
-        for (int i = 1; i < argc; i++)
+        columns = (count + rows - 1) / rows;
+
+        size_t line_width = 0;
+        for (size_t column = 0; column < columns && line_width <= width; column++)
         {
-            list(argv[i]);
+            size_t column_width = 0;
+            for (size_t row = 0; row < rows; row++)
+            {
+                size_t idx = column * rows + row;
+                if (idx < count)
+                {
+                    size_t len = get_display_length(&list->records[idx]);
+                    column_width = (len > column_width) ? len : column_width;
+                }
+            }
+
+            column_widths[column] = column_width;
+            line_width += column_width + ((column + 1 < columns) ? COLUMN_SPACING : 0);
+        }
+
+        if (line_width <= width)
+        {
+            break;
         }
     }
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    if (rows >= count)
+    {
+        // one name per line
+        rows = count;
+        columns = 1;
+    }
+
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t column = 0; column < columns; column++)
+        {
+            size_t idx = column * rows + row;
+            if (idx >= count)
+            {
+                break;
+            }
+
+            const struct EntryRecord *record = &list->records[idx];
+            print_name(list->names + record->name_offset, record->mode);
+
+            // pad unless it is the last name of the line
+            if (column + 1 < columns && idx + rows < count)
+            {
+                size_t padding = column_widths[column] + COLUMN_SPACING - get_display_length(record);
+                format_output("%*s", (int)padding, "");
+            }
+        }
+
+        write_output("\n", 1);
+    }
+
+    free(column_widths);
+}
+
+void print_entries(const struct EntryList *list)
+{
+    if (list_format == FORMAT_COLUMNS)
+    {
+        print_columns(list);
+        return;
+    }
+
+    for (size_t idx = 0; idx < list->count; idx++)
+    {
+        const struct EntryRecord *record = &list->records[idx];
+        struct EntryStat entry_stat = {
+            .mode = record->mode,
+            .size = record->size,
+            .mtime = record->mtime};
+
+        print_item(list->names + record->name_offset, &entry_stat);
+    }
+}
+
+/**
+ * @brief The handler of the entries of `read_directory()`.
+ *
+ * @return int 0 to continue, or the error number to stop reading
+ */
+typedef int (*EntryHandler)(void *context, int dir_fd, const char *name, unsigned char d_type);
+
+/**
+ * @brief Read all entries of the directory except "." and "..".
+ *
+ * @param dir_fd
+ * @param buffer DIRENT_BUFFER_SIZE bytes, aligned to 8 bytes
+ * @param handler
+ * @param context
+ * @return int 0, or the error number
+ */
+int read_directory(int dir_fd, char *buffer, EntryHandler handler, void *context)
+{
+    while (true)
+    {
+        long nread = syscall(SYS_getdents64, dir_fd, buffer, DIRENT_BUFFER_SIZE);
+        if (nread == -1)
+        {
+            return errno;
+        }
+
+        if (nread == 0)
+        {
+            // end of directory
+            return 0;
+        }
+
+        for (long offset = 0; offset < nread;)
+        {
+            struct linux_dirent64 *entry = (struct linux_dirent64 *)(buffer + offset);
+            offset += entry->d_reclen;
+
+            const char *name = entry->d_name;
+            if (name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+            {
+                continue;
+            }
+
+            int error_number = handler(context, dir_fd, name, entry->d_type);
+            if (error_number != 0)
+            {
+                return error_number;
+            }
+        }
+    }
+}
+
+struct ListContext
+{
+    struct EntryList *list;
+    struct ErrorLog *errors;
+};
+
+int handle_list_entry(void *arg, int dir_fd, const char *name, unsigned char d_type)
+{
+    struct ListContext *context = arg;
+
+    struct EntryStat entry_stat = {0};
+    entry_stat.mode = get_dirent_mode(d_type);
+
+    // the names only require nothing, and `-F` requires the type only,
+    // except the permissions of the regular files. `-R` requires the type.
+    bool is_stat_required =
+        (list_format == FORMAT_LONG) ||
+        (sort_order != SORT_NAME) ||
+        (is_classify && (entry_stat.mode == 0 || S_ISREG(entry_stat.mode))) ||
+        (is_recursive && entry_stat.mode == 0);
+
+    if (is_stat_required)
+    {
+        int error_number = get_entry_stat(dir_fd, name, &entry_stat);
+        if (error_number != 0)
+        {
+            // e.g. the entry has been deleted
+            log_error(context->errors, name, error_number);
+            return 0;
+        }
+    }
+
+    if (!add_entry(context->list, name, strlen(name), &entry_stat))
+    {
+        return ENOMEM;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief List the entries of a directory.
+ *
+ * @param path
+ */
+void list_directory(const char *path)
+{
+    // reused by all directories
+    static struct EntryList list;
+    static struct ErrorLog errors;
+    static char dirent_buffer[DIRENT_BUFFER_SIZE] __attribute__((aligned(8)));
+
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd == -1)
+    {
+        report_error(path, errno);
+        return;
+    }
+
+    clear_entries(&list);
+
+    struct ListContext context = {.list = &list, .errors = &errors};
+    int error_number = read_directory(dir_fd, dirent_buffer, handle_list_entry, &context);
+    if (error_number != 0)
+    {
+        log_error(&errors, "", error_number);
+    }
+
+    close(dir_fd);
+
+    print_errors(&errors, path);
+    sort_entries(&list);
+    print_entries(&list);
+}
+
+/**
+ * @brief Check and record the (dev, ino) of a directory or a file.
+ *
+ * @param dev
+ * @param ino
+ * @return bool false if it has been visited
+ */
+bool mark_visited(dev_t dev, ino_t ino)
+{
+    pthread_mutex_lock(&visited_set.mutex);
+
+    // keep the load factor under 1/2
+    if ((visited_set.count + 1) * 2 > visited_set.capacity)
+    {
+        size_t capacity = (visited_set.capacity == 0) ? 1024 : visited_set.capacity * 2;
+        struct VisitedKey *keys = calloc(capacity, sizeof(struct VisitedKey));
+        if (keys == NULL)
+        {
+            // treat as not visited
+            pthread_mutex_unlock(&visited_set.mutex);
+            return true;
+        }
+
+        for (size_t idx = 0; idx < visited_set.capacity; idx++)
+        {
+            struct VisitedKey *key = &visited_set.keys[idx];
+            if (key->dev == 0 && key->ino == 0)
+            {
+                continue;
+            }
+
+            size_t pos = (key->ino * 0x9e3779b97f4a7c15ULL ^ key->dev) & (capacity - 1);
+            while (keys[pos].dev != 0 || keys[pos].ino != 0)
+            {
+                pos = (pos + 1) & (capacity - 1);
+            }
+            keys[pos] = *key;
+        }
+
+        free(visited_set.keys);
+        visited_set.keys = keys;
+        visited_set.capacity = capacity;
+    }
+
+    bool is_new = true;
+    size_t pos = (ino * 0x9e3779b97f4a7c15ULL ^ dev) & (visited_set.capacity - 1);
+    while (visited_set.keys[pos].dev != 0 || visited_set.keys[pos].ino != 0)
+    {
+        if (visited_set.keys[pos].dev == dev && visited_set.keys[pos].ino == ino)
+        {
+            is_new = false;
+            break;
+        }
+        pos = (pos + 1) & (visited_set.capacity - 1);
+    }
+
+    if (is_new)
+    {
+        visited_set.keys[pos].dev = dev;
+        visited_set.keys[pos].ino = ino;
+        visited_set.count++;
+    }
+
+    pthread_mutex_unlock(&visited_set.mutex);
+    return is_new;
+}
+
+struct DirNode *create_node(struct DirNode *parent, const char *name)
+{
+    struct DirNode *node = calloc(1, sizeof(struct DirNode));
+    if (node == NULL)
+    {
+        return NULL;
+    }
+
+    node->name = strdup(name);
+    node->parent = parent;
+    node->fd = -1;
+    return node;
+}
+
+bool add_child(struct DirNode *node, const char *name)
+{
+    if (node->child_count == node->child_capacity)
+    {
+        size_t capacity = (node->child_capacity == 0) ? 8 : node->child_capacity * 2;
+        struct DirNode **children = realloc(node->children, capacity * sizeof(struct DirNode *));
+        if (children == NULL)
+        {
+            return false;
+        }
+        node->children = children;
+        node->child_capacity = capacity;
+    }
+
+    struct DirNode *child = create_node(node, name);
+    if (child == NULL)
+    {
+        return false;
+    }
+
+    node->children[node->child_count] = child;
+    node->child_count++;
+    return true;
+}
+
+void free_node(struct DirNode *node)
+{
+    free(node->name);
+    free(node->list.records);
+    free(node->list.names);
+    free(node->children);
+    free(node->errors.text);
+    free(node);
+}
+
+/**
+ * @brief The child has opened itself, close the fd of the parent if it is
+ * the last one.
+ *
+ * @param node
+ */
+void release_node_fd(struct DirNode *node)
+{
+    if (atomic_fetch_sub(&node->fd_users, 1) == 1)
+    {
+        close(node->fd);
+        node->fd = -1;
+    }
+}
+
+void push_task(int worker_index, struct DirNode *node)
+{
+    atomic_fetch_add(&pending_tasks, 1);
+
+    struct WorkQueue *queue = &work_queues[worker_index];
+    pthread_mutex_lock(&queue->mutex);
+
+    if (queue->tail == queue->capacity)
+    {
+        if (queue->head > 0)
+        {
+            // move the remaining items to the front
+            memmove(queue->items, queue->items + queue->head,
+                    (queue->tail - queue->head) * sizeof(struct DirNode *));
+            queue->tail -= queue->head;
+            queue->head = 0;
+        }
+        else
+        {
+            size_t capacity = (queue->capacity == 0) ? 64 : queue->capacity * 2;
+            struct DirNode **items = realloc(queue->items, capacity * sizeof(struct DirNode *));
+            if (items == NULL)
+            {
+                // out of memory, there is no way to continue
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            queue->items = items;
+            queue->capacity = capacity;
+        }
+    }
+
+    queue->items[queue->tail] = node;
+    queue->tail++;
+    pthread_mutex_unlock(&queue->mutex);
+
+    // wake up an idle worker, check `run_worker()`
+    atomic_fetch_add(&work_generation, 1);
+    if (atomic_load(&idle_workers) > 0)
+    {
+        pthread_mutex_lock(&idle_mutex);
+        pthread_cond_signal(&idle_cond);
+        pthread_mutex_unlock(&idle_mutex);
+    }
+}
+
+struct DirNode *pop_task(int worker_index)
+{
+    struct WorkQueue *queue = &work_queues[worker_index];
+    struct DirNode *node = NULL;
+
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->tail > queue->head)
+    {
+        queue->tail--;
+        node = queue->items[queue->tail];
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    return node;
+}
+
+struct DirNode *steal_task(int worker_index)
+{
+    for (int offset = 1; offset < number_of_workers; offset++)
+    {
+        struct WorkQueue *queue = &work_queues[(worker_index + offset) % number_of_workers];
+        struct DirNode *node = NULL;
+
+        pthread_mutex_lock(&queue->mutex);
+        if (queue->tail > queue->head)
+        {
+            node = queue->items[queue->head];
+            queue->head++;
+        }
+        pthread_mutex_unlock(&queue->mutex);
+
+        if (node != NULL)
+        {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+int handle_walk_entry(void *arg, int dir_fd, const char *name, unsigned char d_type)
+{
+    struct DirNode *node = arg;
+
+    if (!is_du)
+    {
+        // the subdirectories are added after sorting
+        struct ListContext context = {.list = &node->list, .errors = &node->errors};
+        return handle_list_entry(&context, dir_fd, name, d_type);
+    }
+
+    // the size of a subdirectory is counted by itself
+    if (d_type == DT_DIR)
+    {
+        return add_child(node, name) ? 0 : ENOMEM;
+    }
+
+    struct EntryStat entry_stat;
+    int error_number = get_entry_stat(dir_fd, name, &entry_stat);
+    if (error_number != 0)
+    {
+        log_error(&node->errors, name, error_number);
+        return 0;
+    }
+
+    if (S_ISDIR(entry_stat.mode))
+    {
+        return add_child(node, name) ? 0 : ENOMEM;
+    }
+
+    // the file with multiple hard links is counted once
+    if (entry_stat.nlink > 1 && !mark_visited(entry_stat.dev, entry_stat.ino))
+    {
+        return 0;
+    }
+
+    node->blocks += entry_stat.blocks;
+    node->bytes += entry_stat.size;
+    return 0;
+}
+
+int compare_nodes(const void *left, const void *right)
+{
+    return strcmp((*(struct DirNode *const *)left)->name,
+                  (*(struct DirNode *const *)right)->name);
+}
+
+/**
+ * @brief Read a directory of the tree, and push its subdirectories to the
+ * work queue of the worker.
+ *
+ * @param node
+ * @param worker_index
+ * @param dirent_buffer
+ */
+void walk_directory(struct DirNode *node, int worker_index, char *dirent_buffer)
+{
+    // the directory is opened relative to the parent, so the path is never
+    // built, and the symbolic links are not followed.
+    int fd;
+    if (node->parent == NULL)
+    {
+        fd = open(node->name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    else
+    {
+        fd = openat(node->parent->fd, node->name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        int error_number = errno;
+        release_node_fd(node->parent);
+        errno = error_number;
+    }
+
+    if (fd == -1)
+    {
+        log_error(&node->errors, "", errno);
+        return;
+    }
+
+    // a directory can be reached twice by the bind mounts
+    struct stat s;
+    if (fstat(fd, &s) != 0 || !mark_visited(s.st_dev, s.st_ino))
+    {
+        log_error(&node->errors, "", ELOOP);
+        close(fd);
+        return;
+    }
+
+    node->is_listed = true;
+    node->blocks = s.st_blocks;
+    node->bytes = s.st_size;
+
+    int error_number = read_directory(fd, dirent_buffer, handle_walk_entry, node);
+    if (error_number != 0)
+    {
+        log_error(&node->errors, "", error_number);
+    }
+
+    if (is_du)
+    {
+        qsort(node->children, node->child_count, sizeof(struct DirNode *), compare_nodes);
+    }
+    else
+    {
+        // the subdirectories are in the same order as the entries
+        sort_entries(&node->list);
+
+        for (size_t idx = 0; idx < node->list.count; idx++)
+        {
+            const struct EntryRecord *record = &node->list.records[idx];
+            if (S_ISDIR(record->mode) &&
+                !add_child(node, node->list.names + record->name_offset))
+            {
+                log_error(&node->errors, "", ENOMEM);
+                break;
+            }
+        }
+    }
+
+    if (node->child_count == 0)
+    {
+        close(fd);
+        return;
+    }
+
+    // the fd must be ready before any child starts
+    node->fd = fd;
+    atomic_store(&node->fd_users, node->child_count);
+
+    // push in reverse, so that the first child is popped first
+    for (size_t idx = node->child_count; idx > 0; idx--)
+    {
+        push_task(worker_index, node->children[idx - 1]);
+    }
+}
+
+void *run_worker(void *arg)
+{
+    int worker_index = (int)(intptr_t)arg;
+
+    char *dirent_buffer = aligned_alloc(8, DIRENT_BUFFER_SIZE);
+    if (dirent_buffer == NULL)
+    {
+        return NULL;
+    }
+
+    while (true)
+    {
+        uint_fast64_t generation = atomic_load(&work_generation);
+
+        struct DirNode *node = pop_task(worker_index);
+        if (node == NULL)
+        {
+            node = steal_task(worker_index);
+        }
+
+        if (node != NULL)
+        {
+            walk_directory(node, worker_index, dirent_buffer);
+
+            if (atomic_fetch_sub(&pending_tasks, 1) == 1)
+            {
+                // all done
+                pthread_mutex_lock(&idle_mutex);
+                pthread_cond_broadcast(&idle_cond);
+                pthread_mutex_unlock(&idle_mutex);
+            }
+            continue;
+        }
+
+        // sleep until a task is pushed, or all tasks are done.
+        // the generation is checked after `idle_workers` is increased, and
+        // `push_task()` increases the generation before checking `idle_workers`,
+        // so the wake up can not be missed.
+        pthread_mutex_lock(&idle_mutex);
+        atomic_fetch_add(&idle_workers, 1);
+
+        if (atomic_load(&pending_tasks) == 0)
+        {
+            atomic_fetch_sub(&idle_workers, 1);
+            pthread_mutex_unlock(&idle_mutex);
+            break;
+        }
+
+        if (atomic_load(&work_generation) == generation)
+        {
+            pthread_cond_wait(&idle_cond, &idle_mutex);
+        }
+
+        atomic_fetch_sub(&idle_workers, 1);
+        pthread_mutex_unlock(&idle_mutex);
+    }
+
+    free(dirent_buffer);
+    return NULL;
+}
+
+/**
+ * @brief Read the directory trees by multiple threads.
+ *
+ * each worker thread has a work queue of the directories to read, a worker
+ * reads a directory, creates the nodes of the subdirectories and pushes them
+ * into its own queue, the idle workers steal from the others. the whole
+ * trees are kept in memory and printed in order after walking.
+ *
+ * @param roots
+ * @param count
+ */
+void walk_trees(struct DirNode **roots, size_t count)
+{
+    // a directory is kept open until all its subdirectories have been opened
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    number_of_workers = (cpus < 1) ? 1 : (cpus > MAX_WORKERS ? MAX_WORKERS : cpus);
+
+    for (int idx = 0; idx < number_of_workers; idx++)
+    {
+        pthread_mutex_init(&work_queues[idx].mutex, NULL);
+    }
+
+    for (size_t idx = count; idx > 0; idx--)
+    {
+        push_task(0, roots[idx - 1]);
+    }
+
+    // the current thread is the worker 0
+    pthread_t threads[MAX_WORKERS];
+    int number_of_threads = 1;
+    for (; number_of_threads < number_of_workers; number_of_threads++)
+    {
+        if (pthread_create(&threads[number_of_threads], NULL, run_worker,
+                           (void *)(intptr_t)number_of_threads) != 0)
+        {
+            break;
+        }
+    }
+
+    run_worker((void *)0);
+
+    for (int idx = 1; idx < number_of_threads; idx++)
+    {
+        pthread_join(threads[idx], NULL);
+    }
+}
+
+/**
+ * @brief Append the name to the path, the path grows as needed.
+ *
+ * @param path
+ * @param length the current length of the path
+ * @param capacity
+ * @param name
+ * @return size_t the new length
+ */
+size_t append_path(char **path, size_t length, size_t *capacity, const char *name)
+{
+    size_t name_length = strlen(name);
+    bool has_separator = (length > 0 && (*path)[length - 1] != '/');
+    size_t required = length + name_length + 2;
+
+    if (required > *capacity)
+    {
+        size_t new_capacity = (*capacity == 0) ? 1024 : *capacity;
+        while (new_capacity < required)
+        {
+            new_capacity *= 2;
+        }
+
+        char *new_path = realloc(*path, new_capacity);
+        if (new_path == NULL)
+        {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        *path = new_path;
+        *capacity = new_capacity;
+    }
+
+    if (has_separator)
+    {
+        (*path)[length] = '/';
+        length++;
+    }
+
+    memcpy(*path + length, name, name_length + 1);
+    return length + name_length;
+}
+
+/**
+ * @brief Print the tree of `ls -R` in the pre-order, the nodes are freed
+ * after printing.
+ *
+ * @param node
+ * @param path
+ * @param length the length of the path of the parent
+ * @param capacity
+ */
+void print_list_tree(struct DirNode *node, char **path, size_t length, size_t *capacity)
+{
+    size_t node_length = append_path(path, length, capacity, node->name);
+
+    if (node->is_listed)
+    {
+        format_output("%s:\n", *path);
+        print_errors(&node->errors, *path);
+        print_entries(&node->list);
+        write_output("\n", 1);
+    }
+    else
+    {
+        print_errors(&node->errors, *path);
+    }
+
+    for (size_t idx = 0; idx < node->child_count; idx++)
+    {
+        print_list_tree(node->children[idx], path, node_length, capacity);
+    }
+
+    (*path)[length] = '\0';
+    free_node(node);
+}
+
+void print_disk_usage(uint64_t blocks, uint64_t bytes, const char *path)
+{
+    // in KiB by default
+    unsigned long long size = is_apparent_size ? bytes : (blocks + 1) / 2;
+    format_output("%llu\t%s\n", size, path);
+}
+
+/**
+ * @brief Print the tree of `du` in the post-order, the nodes are freed
+ * after printing.
+ *
+ * @param node
+ * @param path
+ * @param length the length of the path of the parent
+ * @param capacity
+ * @param blocks the total of the tree is added to it
+ * @param bytes
+ */
+void print_usage_tree(struct DirNode *node, char **path, size_t length, size_t *capacity,
+                      uint64_t *blocks, uint64_t *bytes)
+{
+    size_t node_length = append_path(path, length, capacity, node->name);
+
+    uint64_t total_blocks = node->blocks;
+    uint64_t total_bytes = node->bytes;
+
+    print_errors(&node->errors, *path);
+
+    for (size_t idx = 0; idx < node->child_count; idx++)
+    {
+        print_usage_tree(node->children[idx], path, node_length, capacity,
+                         &total_blocks, &total_bytes);
+    }
+
+    if (node->is_listed && (!is_summary || node->parent == NULL))
+    {
+        print_disk_usage(total_blocks, total_bytes, *path);
+    }
+
+    *blocks += total_blocks;
+    *bytes += total_bytes;
+
+    (*path)[length] = '\0';
+    free_node(node);
+}
+
+/**
+ * @brief List (`ls -R`) or summarize (`du`) the directory trees.
+ *
+ * @param paths
+ * @param count
+ */
+void walk_and_print(char **paths, int count)
+{
+    struct DirNode **roots = malloc(count * sizeof(struct DirNode *));
+    if (roots == NULL)
+    {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        roots[idx] = create_node(NULL, paths[idx]);
+        if (roots[idx] == NULL)
+        {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    walk_trees(roots, count);
+
+    char *path = NULL;
+    size_t capacity = 0;
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        if (is_du)
+        {
+            uint64_t blocks = 0;
+            uint64_t bytes = 0;
+            print_usage_tree(roots[idx], &path, 0, &capacity, &blocks, &bytes);
+        }
+        else
+        {
+            print_list_tree(roots[idx], &path, 0, &capacity);
+        }
+    }
+
+    free(path);
+    free(roots);
+}
+
+void list(const char *path)
+{
+    struct EntryStat entry_stat;
+    int error_number = get_entry_stat(AT_FDCWD, path, &entry_stat);
+    if (error_number != 0)
+    {
+        if (error_number == ENOENT)
+        {
+            flush_output();
+            fprintf(stderr, "File %s does not exist\n", path);
+            exit_code = EXIT_FAILURE;
+        }
+        else
+        {
+            report_error(path, error_number);
+        }
+        return;
+    }
+
+    if (S_ISDIR(entry_stat.mode))
+    {
+        format_output("%s:\n", path);
+        list_directory(path);
+        write_output("\n", 1);
+    }
+    else
+    {
+        print_item(path, &entry_stat);
+    }
+}
+
+/**
+ * @brief Check whether the path is a directory, the error is reported if
+ * the path does not exist.
+ *
+ * @param path
+ * @param entry_stat
+ * @return int 1 for a directory, 0 for the others, -1 for error
+ */
+int check_directory(const char *path, struct EntryStat *entry_stat)
+{
+    int error_number = get_entry_stat(AT_FDCWD, path, entry_stat);
+    if (error_number != 0)
+    {
+        report_error(path, error_number);
+        return -1;
+    }
+
+    return S_ISDIR(entry_stat->mode) ? 1 : 0;
+}
+
+void print_du_usage(void)
+{
+    char *text =
+        "Usage:\n"
+        "    du [-s] [-b] [file]...\n"
+        "\n"
+        "-s    print the total of each argument only\n"
+        "-b    print the apparent sizes in bytes instead of the disk usage in KiB\n";
+
+    fputs(text, stderr);
+}
+
+int du_main(int argc, char **argv)
+{
+    // usage:
+    // du
+    // du -s dir1 dir2 ...
+
+    is_du = true;
+    program_name = "du";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "sb")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            is_summary = true;
+            break;
+        case 'b':
+            is_apparent_size = true;
+            break;
+        default:
+            print_du_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    char *current[] = {"."};
+    char **paths = (optind == argc) ? current : argv + optind;
+    int count = (optind == argc) ? 1 : argc - optind;
+
+    // the files are printed in place, the directories are walked together
+    char **directories = malloc(count * sizeof(char *));
+    int number_of_directories = 0;
+
+    for (int idx = 0; idx < count; idx++)
+    {
+        struct EntryStat entry_stat;
+        int result = check_directory(paths[idx], &entry_stat);
+        if (result == 1)
+        {
+            directories[number_of_directories] = paths[idx];
+            number_of_directories++;
+        }
+        else if (result == 0)
+        {
+            print_disk_usage(entry_stat.blocks, entry_stat.size, paths[idx]);
+        }
+    }
+
+    if (number_of_directories > 0)
+    {
+        walk_and_print(directories, number_of_directories);
+    }
+
+    free(directories);
+    flush_output();
+    return exit_code;
+}
+
+void print_usage(void)
+{
+    char *text =
+        "Usage:\n"
+        "    ls [-l|-1|-C] [-F] [-S|-t] [-r] [-R] [file]...\n"
+        "\n"
+        "-l    list the type, permissions, size, modification time and name (default)\n"
+        "-1    list the names only, one per line\n"
+        "-C    list the names in columns\n"
+        "-F    append the type indicators (one of /@|=*) to the names,\n"
+        "      list the names only if none of -l and -C is specified\n"
+        "-S    sort by size, the largest first\n"
+        "-t    sort by modification time, the newest first\n"
+        "-r    reverse the order\n"
+        "-R    list the subdirectories recursively\n"
+        "\n"
+        "the entries are sorted by name by default.\n";
+
+    fputs(text, stderr);
+}
+
+int main(int argc, char **argv)
+{
+    if (strcmp(basename(argv[0]), "du") == 0)
+    {
+        return du_main(argc, argv);
+    }
+
+    // usage:
+    // ls
+    // ls file1 file2 ...
+    // ls -1 file1 file2 ...
+    // ls -R dir1 dir2 ...
+
+    bool is_format_specified = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l1CFStrR")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            list_format = FORMAT_LONG;
+            is_format_specified = true;
+            break;
+        case '1':
+            list_format = FORMAT_NAME;
+            is_format_specified = true;
+            break;
+        case 'C':
+            list_format = FORMAT_COLUMNS;
+            is_format_specified = true;
+            break;
+        case 'F':
+            is_classify = true;
+            break;
+        case 'S':
+            sort_order = SORT_SIZE;
+            break;
+        case 't':
+            sort_order = SORT_TIME;
+            break;
+        case 'r':
+            is_reverse = true;
+            break;
+        case 'R':
+            is_recursive = true;
+            break;
+        default:
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (is_classify && !is_format_specified)
+    {
+        list_format = FORMAT_NAME;
+    }
+
+    if (is_recursive)
+    {
+        // the files are listed first, then the directory trees
+        char *current[] = {"."};
+        char **paths = (optind == argc) ? current : argv + optind;
+        int count = (optind == argc) ? 1 : argc - optind;
+
+        char **directories = malloc(count * sizeof(char *));
+        int number_of_directories = 0;
+
+        for (int idx = 0; idx < count; idx++)
+        {
+            struct EntryStat entry_stat;
+            int result = check_directory(paths[idx], &entry_stat);
+            if (result == 1)
+            {
+                directories[number_of_directories] = paths[idx];
+                number_of_directories++;
+            }
+            else if (result == 0)
+            {
+                print_item(paths[idx], &entry_stat);
+            }
+        }
+
+        if (number_of_directories > 0)
+        {
+            walk_and_print(directories, number_of_directories);
+        }
+
+        free(directories);
+    }
+    else if (optind == argc)
+    {
+        list_directory(".");
+    }
+    else
+    {
+        for (int i = optind; i < argc; i++)
+        {
+            list(argv[i]);
+        }
+    }
+
+    flush_output();
+    return exit_code;
+}
@@ -9,9 +9,84 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <stdbool.h>
 #include <sys/mount.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <linux/loop.h>
+
+#include "lib/mountinfo.h"
+
+#define MAX_OPTIONS_LENGTH 1024
+#define FSTAB_FILEPATH "/etc/fstab"
+#define MAX_FSTAB_ENTRIES 64
+#define LOOP_CONTROL_FILEPATH "/dev/loop-control"
+#define MAX_LOOP_ATTEMPTS 8
+
+// the options which are converted into the mount flags, the others
+// (e.g. `size=64M`, `mode=1777` and `huge=within_size` of tmpfs) are
+// passed to the filesystem as the data.
+//
+// check `man 8 mount` and `man 2 mount`
+struct MountFlag
+{
+    const char *name;
+    unsigned long flag;
+    bool is_clear; // clear the flag instead of set
+};
+
+const struct MountFlag MOUNT_FLAGS[] = {
+    {"defaults", 0, false},
+    {"ro", MS_RDONLY, false},
+    {"rw", MS_RDONLY, true},
+    {"nosuid", MS_NOSUID, false},
+    {"suid", MS_NOSUID, true},
+    {"nodev", MS_NODEV, false},
+    {"dev", MS_NODEV, true},
+    {"noexec", MS_NOEXEC, false},
+    {"exec", MS_NOEXEC, true},
+    {"sync", MS_SYNCHRONOUS, false},
+    {"async", MS_SYNCHRONOUS, true},
+    {"dirsync", MS_DIRSYNC, false},
+    {"noatime", MS_NOATIME, false},
+    {"atime", MS_NOATIME, true},
+    {"nodiratime", MS_NODIRATIME, false},
+    {"diratime", MS_NODIRATIME, true},
+    {"relatime", MS_RELATIME, false},
+    {"norelatime", MS_RELATIME, true},
+    {"strictatime", MS_STRICTATIME, false},
+    {"lazytime", MS_LAZYTIME, false},
+    {"silent", MS_SILENT, false},
+    {"remount", MS_REMOUNT, false},
+    {"bind", MS_BIND, false},
+    {"rbind", MS_BIND | MS_REC, false},
+    {"auto", 0, false},   // fstab only
+    {"noauto", 0, false}, // fstab only
+    {"loop", MS_RDONLY, false},
+    {NULL, 0, false}};
+
+// an entry of `/etc/fstab`, e.g.
+//
+//     # device  mountpoint  type   options                 dump  pass
+//     proc      /proc       proc   nosuid,nodev,noexec     0     0
+//     tmpfs     /tmp        tmpfs  size=50%,mode=1777      0     0
+//
+// the `dump` and `pass` fields are ignored.
+struct FstabEntry
+{
+    char *device;
+    char *mount_point;
+    char *type;
+    char *options;
+
+    int level;        // the number of the entries which must be mounted before this one
+    bool is_mounted;  // it had been mounted before `mount -a`
+    int result;       // EXIT_SUCCESS or EXIT_FAILURE
+};
 
 int list_mounts(void)
 {
@@ -37,34 +112,590 @@ int list_mounts(void)
     return EXIT_SUCCESS;
 }
 
+/**
+ * @brief Split the comma separated options into the mount flags and
+ * the filesystem specific data.
+ *
+ * @param options e.g. "noatime,nosuid,size=64M,huge=within_size"
+ * @param mount_flags
+ * @param data the buffer for the data, e.g. "size=64M,huge=within_size"
+ * @param data_len
+ * @return bool false if the options are too long
+ */
+bool parse_options(const char *options,
+                   unsigned long *mount_flags,
+                   char *data,
+                   size_t data_len)
+{
+    char buf[MAX_OPTIONS_LENGTH];
+    if (strlen(options) >= sizeof(buf))
+    {
+        return false;
+    }
+
+    strcpy(buf, options);
+    data[0] = '\0';
+    size_t data_pos = 0;
+
+    char *saveptr;
+    for (char *option = strtok_r(buf, ",", &saveptr);
+         option != NULL;
+         option = strtok_r(NULL, ",", &saveptr))
+    {
+        const struct MountFlag *item = MOUNT_FLAGS;
+        while (item->name != NULL && strcmp(item->name, option) != 0)
+        {
+            item++;
+        }
+
+        if (item->name != NULL)
+        {
+            if (item->is_clear)
+            {
+                *mount_flags &= ~item->flag;
+            }
+            else
+            {
+                *mount_flags |= item->flag;
+            }
+            continue;
+        }
+
+        int written = snprintf(data + data_pos, data_len - data_pos,
+                               "%s%s", data_pos == 0 ? "" : ",", option);
+        if (written < 0 || (size_t)written >= data_len - data_pos)
+        {
+            return false;
+        }
+
+        data_pos += written;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Check whether the option is in the comma separated options.
+ *
+ * @param options
+ * @param name
+ * @return bool
+ */
+bool has_option(const char *options, const char *name)
+{
+    size_t len = strlen(name);
+    const char *ptr = options;
+
+    while ((ptr = strstr(ptr, name)) != NULL)
+    {
+        if ((ptr == options || ptr[-1] == ',') &&
+            (ptr[len] == ',' || ptr[len] == '\0'))
+        {
+            return true;
+        }
+        ptr += len;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Detect the filesystem type of the image file by the magic number.
+ *
+ * @param filepath
+ * @return const char* "squashfs", "erofs", or NULL if unknown
+ */
+const char *detect_image_type(const char *filepath)
+{
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    // check `fs/squashfs/squashfs_fs.h` and `fs/erofs/erofs_fs.h` of the kernel,
+    // both are little endian.
+    const uint32_t SQUASHFS_MAGIC = 0x73717368; // "hsqs"
+    const uint32_t EROFS_MAGIC = 0xe0f5e1e2;
+    const off_t EROFS_MAGIC_OFFSET = 1024;
+
+    const char *type = NULL;
+    uint8_t buf[4];
+
+    if (pread(fd, buf, sizeof(buf), 0) == sizeof(buf) &&
+        (buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24) == SQUASHFS_MAGIC)
+    {
+        type = "squashfs";
+    }
+    else if (pread(fd, buf, sizeof(buf), EROFS_MAGIC_OFFSET) == sizeof(buf) &&
+             (buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24) == EROFS_MAGIC)
+    {
+        type = "erofs";
+    }
+
+    close(fd);
+    return type;
+}
+
+/**
+ * @brief Attach the image file to a free loop device, read-only.
+ *
+ * the loop device is detached automatically when it is unmounted
+ * (LO_FLAGS_AUTOCLEAR), or when the returned fd is closed without mounting.
+ *
+ * @param filepath the image file
+ * @param loop_device the buffer for the path of the loop device, e.g. "/dev/loop0"
+ * @param loop_device_len
+ * @return int the fd of the loop device, or -1 if failed
+ */
+int setup_loop_device(const char *filepath, char *loop_device, size_t loop_device_len)
+{
+    int file_fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (file_fd == -1)
+    {
+        fprintf(stderr, "mount: %s: %s\n", filepath, strerror(errno));
+        return -1;
+    }
+
+    int control_fd = open(LOOP_CONTROL_FILEPATH, O_RDWR | O_CLOEXEC);
+    if (control_fd == -1)
+    {
+        fprintf(stderr, "mount: %s: %s\n", LOOP_CONTROL_FILEPATH, strerror(errno));
+        close(file_fd);
+        return -1;
+    }
+
+    int loop_fd = -1;
+
+    // the free device may be taken by another process between
+    // LOOP_CTL_GET_FREE and the configuration, try again in that case.
+    for (int attempt = 0; attempt < MAX_LOOP_ATTEMPTS && loop_fd == -1; attempt++)
+    {
+        int number = ioctl(control_fd, LOOP_CTL_GET_FREE);
+        if (number == -1)
+        {
+            perror("mount: LOOP_CTL_GET_FREE");
+            break;
+        }
+
+        snprintf(loop_device, loop_device_len, "/dev/loop%d", number);
+        int fd = open(loop_device, O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            fprintf(stderr, "mount: %s: %s\n", loop_device, strerror(errno));
+            break;
+        }
+
+        // the direct I/O avoids caching the compressed blocks twice (in the
+        // page cache of both the image file and the loop device), the kernel
+        // disables it silently if the backing filesystem does not support it.
+        struct loop_config config = {0};
+        config.fd = file_fd;
+        config.info.lo_flags = LO_FLAGS_READ_ONLY | LO_FLAGS_AUTOCLEAR | LO_FLAGS_DIRECT_IO;
+        strncpy((char *)config.info.lo_file_name, filepath, LO_NAME_SIZE - 1);
+
+        // LOOP_CONFIGURE (Linux 5.8) attaches the file and sets the status
+        // in one call.
+        if (ioctl(fd, LOOP_CONFIGURE, &config) == 0)
+        {
+            loop_fd = fd;
+        }
+        else if (errno == EBUSY)
+        {
+            close(fd);
+        }
+        else if (errno == EINVAL || errno == ENOTTY)
+        {
+            // the older kernel, fall back to LOOP_SET_FD and LOOP_SET_STATUS64
+            if (ioctl(fd, LOOP_SET_FD, file_fd) == 0)
+            {
+                if (ioctl(fd, LOOP_SET_STATUS64, &config.info) == 0)
+                {
+                    loop_fd = fd;
+                }
+                else
+                {
+                    perror("mount: LOOP_SET_STATUS64");
+                    ioctl(fd, LOOP_CLR_FD, 0);
+                    close(fd);
+                    break;
+                }
+            }
+            else if (errno == EBUSY)
+            {
+                close(fd);
+            }
+            else
+            {
+                perror("mount: LOOP_SET_FD");
+                close(fd);
+                break;
+            }
+        }
+        else
+        {
+            perror("mount: LOOP_CONFIGURE");
+            close(fd);
+            break;
+        }
+    }
+
+    close(control_fd);
+
+    // the loop device holds its own reference of the file
+    close(file_fd);
+    return loop_fd;
+}
+
 int mount_device(const char *type,
                  const char *device,
-                 const char *mount_point)
+                 const char *mount_point,
+                 const char *options)
 {
     unsigned long mount_flags = 0;
-    const char *opts = NULL;
+    char data[MAX_OPTIONS_LENGTH] = {0};
+
+    if (options != NULL &&
+        !parse_options(options, &mount_flags, data, sizeof(data)))
+    {
+        fprintf(stderr, "mount: options are too long\n");
+        return EXIT_FAILURE;
+    }
+
+    // the image file is mounted read-only through a loop device,
+    // the type is detected from the image if it is omitted.
+    bool is_loop = (options != NULL && has_option(options, "loop"));
+    if (is_loop && (type == NULL || strcmp(type, "auto") == 0))
+    {
+        type = detect_image_type(device);
+    }
+
+    // the type is ignored by bind and remount
+    if (type == NULL && (mount_flags & (MS_BIND | MS_REMOUNT)) == 0)
+    {
+        fprintf(stderr, "mount: the filesystem type is required\n");
+        return EXIT_FAILURE;
+    }
+
+    char loop_device[32];
+    int loop_fd = -1;
 
-    if (mount(device, mount_point, type, mount_flags, opts) == 0)
+    if (is_loop)
+    {
+        loop_fd = setup_loop_device(device, loop_device, sizeof(loop_device));
+        if (loop_fd == -1)
+        {
+            return EXIT_FAILURE;
+        }
+
+        device = loop_device;
+    }
+
+    int exit_code = EXIT_SUCCESS;
+
+    if (mount(device, mount_point, type, mount_flags, data[0] == '\0' ? NULL : data) == 0)
     {
         printf("Mount point %s created successfully.\n", mount_point);
-        return EXIT_SUCCESS;
     }
     else
     {
-        perror("mount");
+        fprintf(stderr, "mount: %s: %s\n", mount_point, strerror(errno));
+        exit_code = EXIT_FAILURE;
+    }
+
+    if (loop_fd != -1)
+    {
+        // the loop device is detached here if the mount failed
+        close(loop_fd);
+    }
+
+    return exit_code;
+}
+
+/**
+ * @brief Read the entries of `/etc/fstab`, the entries with the option
+ * `noauto` are skipped.
+ *
+ * @param entries
+ * @param max_entries
+ * @return int the number of entries, or -1 if the file can not be opened
+ */
+int read_fstab(struct FstabEntry *entries, int max_entries)
+{
+    FILE *file = fopen(FSTAB_FILEPATH, "r");
+    if (file == NULL)
+    {
+        perror("fopen");
+        return -1;
+    }
+
+    int count = 0;
+    char *line = NULL;
+    size_t len = 0;
+
+    while (getline(&line, &len, file) != -1)
+    {
+        const char *DELIMITERS = " \t\n";
+        char *saveptr;
+        char *device = strtok_r(line, DELIMITERS, &saveptr);
+        if (device == NULL || device[0] == '#')
+        {
+            continue;
+        }
+
+        char *mount_point = strtok_r(NULL, DELIMITERS, &saveptr);
+        char *type = strtok_r(NULL, DELIMITERS, &saveptr);
+        char *options = strtok_r(NULL, DELIMITERS, &saveptr);
+        if (mount_point == NULL || type == NULL)
+        {
+            fprintf(stderr, "mount: %s: invalid line for \"%s\"\n", FSTAB_FILEPATH, device);
+            continue;
+        }
+
+        if (options == NULL)
+        {
+            options = "defaults";
+        }
+
+        if (has_option(options, "noauto"))
+        {
+            continue;
+        }
+
+        if (count == max_entries)
+        {
+            fprintf(stderr, "mount: %s: too many entries\n", FSTAB_FILEPATH);
+            break;
+        }
+
+        struct FstabEntry *entry = &entries[count];
+        entry->device = strdup(device);
+        entry->mount_point = strdup(mount_point);
+        entry->type = strdup(type);
+        entry->options = strdup(options);
+        entry->level = 0;
+        entry->is_mounted = false;
+        entry->result = EXIT_SUCCESS;
+        count++;
+    }
+
+    free(line);
+    fclose(file);
+    return count;
+}
+
+/**
+ * @brief Check whether the entry must be mounted after the other entry.
+ *
+ * @param entry
+ * @param other
+ * @param is_other_earlier the other entry is listed before the entry
+ * @return bool
+ */
+bool is_depend_on(const struct FstabEntry *entry,
+                  const struct FstabEntry *other,
+                  bool is_other_earlier)
+{
+    // the parent directory, e.g. `/sys/fs/cgroup` depends on `/sys`, the
+    // same mount point is checked below
+    if (strcmp(other->mount_point, entry->mount_point) != 0 &&
+        is_path_under(other->mount_point, entry->mount_point))
+    {
+        return true;
+    }
+
+    // stacked over the same mount point
+    if (is_other_earlier && strcmp(other->mount_point, entry->mount_point) == 0)
+    {
+        return true;
+    }
+
+    // the image file and the loop devices must be available
+    if (has_option(entry->options, "loop") &&
+        (is_path_under(other->mount_point, entry->device) || strcmp(other->mount_point, "/dev") == 0))
+    {
+        return true;
+    }
+
+    return false;
+}
+
+void *mount_entry_thread(void *arg)
+{
+    struct FstabEntry *entry = arg;
+    entry->result = mount_device(entry->type, entry->device,
+                                 entry->mount_point, entry->options);
+    return NULL;
+}
+
+/**
+ * @brief Mount all filesystems listed in `/etc/fstab`.
+ *
+ * an entry must be mounted after the entries it depends on (check
+ * `is_depend_on()`). the level of an entry is the length of the longest
+ * dependency chain before it, and the entries of the same level are
+ * mounted concurrently, one thread per entry.
+ *
+ * the entries which have been mounted are skipped.
+ *
+ * @return int
+ */
+int mount_all(void)
+{
+    struct FstabEntry entries[MAX_FSTAB_ENTRIES];
+    int count = read_fstab(entries, MAX_FSTAB_ENTRIES);
+    if (count == -1)
+    {
         return EXIT_FAILURE;
     }
+
+    // the table is empty if `/proc` has not been mounted yet
+    struct MountTable table;
+    read_mountinfo(&table);
+
+    for (int i = 0; i < count; i++)
+    {
+        // the entry which is mounted over the same mount point is never skipped
+        bool is_stacked = false;
+        for (int j = 0; j < i; j++)
+        {
+            if (strcmp(entries[j].mount_point, entries[i].mount_point) == 0)
+            {
+                is_stacked = true;
+            }
+        }
+
+        entries[i].is_mounted = !is_stacked && find_mount(&table, entries[i].mount_point) != -1;
+    }
+
+    free_mountinfo(&table);
+
+    // the longest chain is at most `count` entries, so the levels are
+    // stable after `count` rounds.
+    int max_level = 0;
+    for (int round = 0; round < count; round++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            for (int j = 0; j < count; j++)
+            {
+                if (i != j &&
+                    is_depend_on(&entries[i], &entries[j], j < i) &&
+                    entries[i].level < entries[j].level + 1)
+                {
+                    entries[i].level = entries[j].level + 1;
+                }
+            }
+
+            if (entries[i].level > max_level)
+            {
+                max_level = entries[i].level;
+            }
+        }
+    }
+
+    int exit_code = EXIT_SUCCESS;
+
+    for (int level = 0; level <= max_level; level++)
+    {
+        pthread_t threads[MAX_FSTAB_ENTRIES];
+        bool is_started[MAX_FSTAB_ENTRIES] = {false};
+
+        for (int i = 0; i < count; i++)
+        {
+            struct FstabEntry *entry = &entries[i];
+            if (entry->level != level)
+            {
+                continue;
+            }
+
+            // do not mount over the failed parent, the lower filesystem
+            // would be shadowed when the parent is mounted later.
+            bool is_dependency_failed = false;
+            for (int j = 0; j < count; j++)
+            {
+                if (i != j &&
+                    entries[j].result != EXIT_SUCCESS &&
+                    is_depend_on(entry, &entries[j], false))
+                {
+                    is_dependency_failed = true;
+                }
+            }
+
+            if (is_dependency_failed)
+            {
+                fprintf(stderr, "mount: %s: skipped, the dependency failed to mount\n", entry->mount_point);
+                entry->result = EXIT_FAILURE;
+                continue;
+            }
+
+            if (entry->is_mounted)
+            {
+                continue;
+            }
+
+            if (pthread_create(&threads[i], NULL, mount_entry_thread, entry) == 0)
+            {
+                is_started[i] = true;
+            }
+            else
+            {
+                // mount in the current thread instead
+                mount_entry_thread(entry);
+            }
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (is_started[i])
+            {
+                pthread_join(threads[i], NULL);
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (entries[i].result != EXIT_SUCCESS)
+        {
+            exit_code = EXIT_FAILURE;
+        }
+
+        free(entries[i].device);
+        free(entries[i].mount_point);
+        free(entries[i].type);
+        free(entries[i].options);
+    }
+
+    return exit_code;
 }
 
 void print_usage(void)
 {
     char *text =
         "Usage:\n"
-        "    mount -t type device mountpoint\n"
+        "    mount -t type [-o options] device mountpoint\n"
+        "    mount -o remount[,options] mountpoint\n"
+        "    mount -o bind olddir newdir\n"
+        "    mount -a\n"
+        "    mount [-t type] -o loop image mountpoint\n"
         "\n"
         "e.g.\n"
         "    mount -t proc proc /proc\n"
         "    mount -t tmpfs none /var/tmp\n"
+        "    mount -t tmpfs -o size=64M,mode=1777,noatime,huge=within_size none /tmp\n"
+        "    mount -o remount,ro /mnt\n"
+        "    mount -o loop /payload.sqfs /opt\n"
+        "\n"
+        "-a    mount all filesystems listed in /etc/fstab, except those with\n"
+        "      the option noauto or already mounted\n"
+        "\n"
+        "Options:\n"
+        "    ro, rw, nosuid, nodev, noexec, sync, dirsync, noatime, nodiratime,\n"
+        "    relatime, strictatime, lazytime, remount, bind, rbind, defaults,\n"
+        "    loop (attach the image file to a loop device and mount it read-only,\n"
+        "    squashfs and erofs images are detected if the type is omitted),\n"
+        "    the others are passed to the filesystem, e.g. size=, mode=, huge=\n"
         "\n"
         "Run without parameters to list all mount points\n";
 
@@ -77,11 +708,51 @@ int main(int argc, char **argv)
     {
         return list_mounts();
     }
-    else if (argc == 5)
+
+    // usage:
+    //
+    // mount -t type device mountpoint
+    // mount -t type -o options device mountpoint
+    // mount -o remount,options mountpoint
+    // mount -a
+
+    char *type = NULL;
+    char *options = NULL;
+    bool is_all = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "at:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            is_all = true;
+            break;
+        case 't':
+            type = optarg;
+            break;
+        case 'o':
+            options = optarg;
+            break;
+        default:
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    int remain = argc - optind;
+    if (is_all && remain == 0)
+    {
+        return mount_all();
+    }
+    else if (remain == 2)
+    {
+        return mount_device(type, argv[optind], argv[optind + 1], options);
+    }
+    else if (remain == 1 && options != NULL && strstr(options, "remount") != NULL)
     {
-        return mount_device(argv[2],
-                            argv[3],
-                            argv[4]);
+        // the device is ignored by remount
+        return mount_device(type, "none", argv[optind], options);
     }
     else
     {
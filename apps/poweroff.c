@@ -8,22 +8,83 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <libgen.h>
+#include <signal.h>
 #include <unistd.h>
 #include <sys/reboot.h>
 
+// the program is also linked as `reboot` and `halt`.
+//
+// by default the program asks `init` to shut down the system, `init` stops
+// the services and processes, and unmounts the filesystems before rebooting,
+// the conventions of the signals are:
+//
+// - halt:     SIGUSR1
+// - poweroff: SIGUSR2
+// - reboot:   SIGTERM
+//
+// with `-f`, the system is rebooted immediately without asking `init`.
+
+void print_usage(char *command)
+{
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "    %s [-f]\n", command);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "-f    %s immediately, without stopping the services\n", command);
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 1)
+    char *command = basename(argv[0]);
+
+    int signal = SIGUSR2;
+    int reboot_command = RB_POWER_OFF;
+
+    if (strcmp(command, "reboot") == 0)
     {
-        fputs("Does not support parameters.\n", stderr);
-        return EXIT_FAILURE;
+        signal = SIGTERM;
+        reboot_command = RB_AUTOBOOT;
+    }
+    else if (strcmp(command, "halt") == 0)
+    {
+        signal = SIGUSR1;
+        reboot_command = RB_HALT_SYSTEM;
     }
 
     // usage:
     //
     // poweroff
+    // poweroff -f
+
+    bool is_forced = false;
+
+    if (argc == 2 && strcmp(argv[1], "-f") == 0)
+    {
+        is_forced = true;
+    }
+    else if (argc != 1)
+    {
+        print_usage(command);
+        return EXIT_FAILURE;
+    }
+
+    if (is_forced)
+    {
+        sync();
+        reboot(reboot_command);
+
+        // `reboot()` returns only when error occurred.
+        perror("reboot");
+        return EXIT_FAILURE;
+    }
+
+    if (kill(1, signal) != 0)
+    {
+        perror("kill");
+        return EXIT_FAILURE;
+    }
 
-    sync();
-    reboot(RB_POWER_OFF);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
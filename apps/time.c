@@ -6,82 +6,1038 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 
+// enable the GNU extensions, e.g. `cpu_set_t`
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/perf_event.h>
 #include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
-int main(int argc, char **argv)
+#include "lib/schedutil.h"
+
+#define DROP_CACHES_FILEPATH "/proc/sys/vm/drop_caches"
+
+// the result of running the command once
+struct Measurement
+{
+    struct timespec real; // CLOCK_MONOTONIC, it does not jump when the clock is set
+    struct rusage usage;  // of the child process (and its waited descendants)
+    int status;           // the wait status
+};
+
+struct Statistics
+{
+    double min;
+    double max;
+    double mean;
+    double median;
+    double p95;
+    double p99;
+    double stddev; // the sample standard deviation
+};
+
+enum ReportFormat
+{
+    REPORT_TEXT,
+    REPORT_CSV,
+    REPORT_JSON
+};
+
+// the long options without the short form
+enum
+{
+    OPTION_CSV = 256,
+    OPTION_JSON
+};
+
+// a `perf_event_open` counter of the command
+struct Counter
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+    int fd;
+    int error_number;  // of `perf_event_open`, 0 if it is opened
+    bool is_user_only; // the kernel is excluded by `perf_event_paranoid`
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running; // less than `time_enabled` if the PMU is multiplexed
+};
+
+// the software events are always available, the hardware events
+// depend on the PMU (e.g. the SBI PMU extension on RISC-V).
+struct Counter counters[] = {
+    {.name = "task-clock", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_TASK_CLOCK},
+    {.name = "context-switches", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {.name = "cpu-migrations", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_CPU_MIGRATIONS},
+    {.name = "page-faults", .type = PERF_TYPE_SOFTWARE, .config = PERF_COUNT_SW_PAGE_FAULTS},
+    {.name = "cycles", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_CPU_CYCLES},
+    {.name = "instructions", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_INSTRUCTIONS},
+    {.name = "cache-misses", .type = PERF_TYPE_HARDWARE, .config = PERF_COUNT_HW_CACHE_MISSES},
+};
+
+#define COUNTER_COUNT (sizeof(counters) / sizeof(counters[0]))
+
+bool is_drop_caches = false;
+bool is_pinned = false;
+cpu_set_t child_cpus; // the CPUs the command runs on, if `is_pinned`
+bool is_counting = false;
+
+// the default report
+const char *DEFAULT_FORMAT =
+    "real    %e seconds\n"
+    "user    %U seconds\n"
+    "sys     %S seconds\n"
+    "cpu     %P\n"
+    "maxrss  %M KB\n"
+    "faults  %R minor, %F major\n"
+    "ctxsw   %w voluntary, %c involuntary\n"
+    "blockio %I in, %O out";
+
+// POSIX `time -p`
+const char *PORTABLE_FORMAT =
+    "real %e\n"
+    "user %U\n"
+    "sys %S";
+
+void print_usage(void)
 {
-    if (argc == 1)
+    char *text =
+        "Usage:\n"
+        "    time [-p] [-f format] [-o file [-a]] [-d] [-c cpus] [-e] command [args]...\n"
+        "    time -n runs [-w warmup] [--csv|--json] [-o file [-a]] [-d] [-c cpus] command [args]...\n"
+        "\n"
+        "-p    print the POSIX format, i.e. the real, user and sys time only\n"
+        "-f    the format of the report, the same as GNU time:\n"
+        "      %e real seconds            %E real [hours:]minutes:seconds\n"
+        "      %U user seconds            %S system seconds\n"
+        "      %P CPU percentage          %M maximum resident set size (KB)\n"
+        "      %R minor page faults       %F major page faults\n"
+        "      %w voluntary switches      %c involuntary switches\n"
+        "      %I filesystem inputs       %O filesystem outputs\n"
+        "      %W swaps                   %k signals delivered\n"
+        "      %r socket messages in      %s socket messages out\n"
+        "      %x exit status             %C command line\n"
+        "      %Z page size (bytes)       %% a '%'\n"
+        "      and the escapes \\n, \\t and \\\\\n"
+        "-o    write the report into the file instead of stderr\n"
+        "-a    append to the file instead of overwriting it\n"
+        "-d, --drop-caches\n"
+        "      drop the page cache, dentries and inodes before each run, so every\n"
+        "      run starts cold (requires root)\n"
+        "-c, --cpu cpus\n"
+        "      run the command on the CPUs, e.g. \"1\" or \"2-3\"\n"
+        "-e, --events\n"
+        "      count the events of the command (and its children) by perf_event,\n"
+        "      task-clock, context-switches, cpu-migrations, page-faults, and\n"
+        "      cycles, instructions and cache-misses if the PMU supports them.\n"
+        "      \":u\" marks the counter which excludes the kernel because of\n"
+        "      /proc/sys/kernel/perf_event_paranoid\n"
+        "\n"
+        "-n, --runs runs\n"
+        "      run the command repeatedly, and report the min, max, mean, median,\n"
+        "      p95, p99 and the standard deviation of the real, user and sys time,\n"
+        "      it stops at the first run which fails\n"
+        "-w, --warmup warmup\n"
+        "      the runs before the measured runs, they are not counted\n"
+        "--csv, --json\n"
+        "      print the statistics in CSV or JSON (with all samples) instead of the table\n"
+        "\n"
+        "the exit status is the one of the command, 128 + N if it is killed by\n"
+        "the signal N, 126 if it can not be executed, or 127 if it is not found.\n"
+        "\n"
+        "e.g.\n"
+        "    time sort -o /tmp/sorted /tmp/huge.txt\n"
+        "    time -f \"%e %M %w %c\" -o /tmp/usage.txt make\n"
+        "    time -e gzip -9 /tmp/huge.txt\n"
+        "    time -n 20 -w 3 -c 1 --json -o /tmp/sort.json sort /tmp/huge.txt\n";
+
+    fputs(text, stderr);
+}
+
+double get_seconds(const struct timespec *ts)
+{
+    return ts->tv_sec + ts->tv_nsec / 1e9;
+}
+
+double get_timeval_seconds(const struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+/**
+ * @brief Get the exit status of the command, as the shell does.
+ */
+int get_exit_code(int status)
+{
+    if (WIFSIGNALED(status))
     {
-        return EXIT_SUCCESS;
+        return 128 + WTERMSIG(status);
     }
+    return WEXITSTATUS(status);
+}
 
-    // argv
-    //     0    1       2    3        N
-    //     time program arg1 arg2 ... NULL
-    //
-    // execvp argv
-    //     0       1    2        N
-    //     program arg1 arg2 ... NULL
+long perf_event_open(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return syscall(SYS_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
 
-    char *file = argv[1];
-    char **child_argv = argv + 1;
+/**
+ * @brief Open the counters of the process, they are enabled when the
+ * process calls `exec`, and they follow its children.
+ *
+ * the failed counters are marked by the `error_number`.
+ *
+ * @param pid
+ */
+void open_counters(pid_t pid)
+{
+    for (size_t idx = 0; idx < COUNTER_COUNT; idx++)
+    {
+        struct Counter *counter = &counters[idx];
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter->type;
+        attr.config = counter->config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = 1;
+        attr.enable_on_exec = 1;
+        attr.inherit = 1;
+
+        counter->is_user_only = false;
+        counter->fd = perf_event_open(&attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+
+        if (counter->fd == -1 && (errno == EACCES || errno == EPERM))
+        {
+            // `perf_event_paranoid` >= 2 allows the user space events only
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            counter->is_user_only = true;
+            counter->fd = perf_event_open(&attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        }
+
+        counter->error_number = (counter->fd == -1) ? errno : 0;
+    }
+}
+
+/**
+ * @brief Read and close the counters.
+ */
+void read_counters(void)
+{
+    for (size_t idx = 0; idx < COUNTER_COUNT; idx++)
+    {
+        struct Counter *counter = &counters[idx];
+        if (counter->fd == -1)
+        {
+            continue;
+        }
 
-    struct timeval start;
-    gettimeofday(&start, NULL);
+        // value, time_enabled, time_running
+        uint64_t values[3];
+        if (read(counter->fd, values, sizeof(values)) == sizeof(values))
+        {
+            counter->value = values[0];
+            counter->time_enabled = values[1];
+            counter->time_running = values[2];
+        }
+        else
+        {
+            counter->error_number = errno;
+        }
+
+        close(counter->fd);
+        counter->fd = -1;
+    }
+}
+
+/**
+ * @brief Get the value of the counter, it is scaled up if the counter
+ * was multiplexed.
+ *
+ * @return double -1 if it is not counted
+ */
+double get_counter_value(const struct Counter *counter)
+{
+    if (counter->error_number != 0 || counter->time_running == 0)
+    {
+        return -1;
+    }
+    return (double)counter->value * counter->time_enabled / counter->time_running;
+}
+
+/**
+ * @brief Print the counters as `perf stat` does.
+ *
+ * @param output
+ * @param real the real time in seconds
+ */
+void print_counters(FILE *output, double real)
+{
+    double cycles = -1;
+
+    for (size_t idx = 0; idx < COUNTER_COUNT; idx++)
+    {
+        const struct Counter *counter = &counters[idx];
+
+        char label[32];
+        snprintf(label, sizeof(label), "%s%s", counter->name, counter->is_user_only ? ":u" : "");
+
+        if (counter->error_number != 0)
+        {
+            // ENOENT, EOPNOTSUPP or ENODEV if the PMU has not the event
+            bool is_unsupported = (counter->error_number == ENOENT ||
+                                   counter->error_number == EOPNOTSUPP ||
+                                   counter->error_number == ENODEV);
+            fprintf(output, "%-20s%18s\n", label,
+                    is_unsupported ? "<not supported>" : strerror(counter->error_number));
+            continue;
+        }
+
+        double value = get_counter_value(counter);
+        if (value < 0)
+        {
+            fprintf(output, "%-20s%18s\n", label, "<not counted>");
+            continue;
+        }
+
+        if (counter->type == PERF_TYPE_SOFTWARE && counter->config == PERF_COUNT_SW_TASK_CLOCK)
+        {
+            // in nanoseconds
+            fprintf(output, "%-20s%13.3f msec", label, value / 1e6);
+            if (real > 0)
+            {
+                fprintf(output, "  # %.2f CPUs utilized", value / 1e9 / real);
+            }
+        }
+        else
+        {
+            fprintf(output, "%-20s%18.0f", label, value);
+
+            if (counter->type == PERF_TYPE_HARDWARE && counter->config == PERF_COUNT_HW_CPU_CYCLES)
+            {
+                cycles = value;
+            }
+            else if (counter->type == PERF_TYPE_HARDWARE &&
+                     counter->config == PERF_COUNT_HW_INSTRUCTIONS && cycles > 0)
+            {
+                fprintf(output, "  # %.2f insn per cycle", value / cycles);
+            }
+        }
+
+        if (counter->time_running < counter->time_enabled)
+        {
+            fprintf(output, "  (%.1f%%)", 100.0 * counter->time_running / counter->time_enabled);
+        }
+        fputc('\n', output);
+    }
+}
+
+/**
+ * @brief Run the command and wait for it.
+ *
+ * @param argv the command and its arguments
+ * @param measurement
+ * @return bool false if failed to fork
+ */
+bool run_command(char **argv, struct Measurement *measurement)
+{
+    // the child waits until the counters are opened, it reads
+    // the end of file when the parent closes the write end.
+    int sync_fds[2];
+    if (is_counting && pipe(sync_fds) == -1)
+    {
+        perror("pipe");
+        return false;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
 
     pid_t pid = fork();
 
     if (pid == -1)
     {
         perror("fork");
-        exit(EXIT_FAILURE);
+        if (is_counting)
+        {
+            close(sync_fds[0]);
+            close(sync_fds[1]);
+        }
+        return false;
     }
     else if (pid == 0)
     {
         // Child process
-        execvp(file, child_argv);
-        perror("execvp");
-        exit(EXIT_FAILURE);
+
+        // the ignored signals are inherited by `execvp`, restore them
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+
+        if (is_counting)
+        {
+            close(sync_fds[1]);
+            char byte;
+            while (read(sync_fds[0], &byte, 1) == -1 && errno == EINTR)
+            {
+                // retry
+            }
+            close(sync_fds[0]);
+        }
+
+        if (is_pinned && sched_setaffinity(0, sizeof(child_cpus), &child_cpus) != 0)
+        {
+            perror("time: sched_setaffinity");
+            _exit(126);
+        }
+
+        execvp(argv[0], argv);
+        int error_number = errno;
+        fprintf(stderr, "time: cannot run %s: %s\n", argv[0], strerror(error_number));
+        _exit(error_number == ENOENT ? 127 : 126);
+    }
+
+    // Parent process
+
+    if (is_counting)
+    {
+        close(sync_fds[0]);
+        open_counters(pid);
+        close(sync_fds[1]);
+    }
+
+    // `wait4` returns the usage of this child only, unlike
+    // `getrusage(RUSAGE_CHILDREN)` which sums all waited children.
+    while (wait4(pid, &measurement->status, 0, &measurement->usage) == -1)
+    {
+        if (errno != EINTR)
+        {
+            perror("wait4");
+            return false;
+        }
+    }
+
+    // - real time: from `program start` to `program exit`
+    // - user_time: program in userspace comsuming
+    // - system_time: program in kernel comsuming
+    //
+    // real time = user time + system time + I/O waiting + other etc.
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    measurement->real.tv_sec = end.tv_sec - start.tv_sec;
+    measurement->real.tv_nsec = end.tv_nsec - start.tv_nsec;
+    if (measurement->real.tv_nsec < 0)
+    {
+        measurement->real.tv_sec--;
+        measurement->real.tv_nsec += 1000000000;
+    }
+
+    if (is_counting)
+    {
+        read_counters();
+    }
+
+    return true;
+}
+
+/**
+ * @brief Print the report by the format (check `print_usage()`), a newline
+ * is appended.
+ *
+ * @param output
+ * @param format
+ * @param measurement
+ * @param argv the command and its arguments
+ */
+void print_report(FILE *output, const char *format, const struct Measurement *measurement, char **argv)
+{
+    const struct rusage *usage = &measurement->usage;
+    double real = get_seconds(&measurement->real);
+    double user = get_timeval_seconds(&usage->ru_utime);
+    double sys = get_timeval_seconds(&usage->ru_stime);
+
+    for (const char *ptr = format; *ptr != '\0'; ptr++)
+    {
+        if (*ptr == '\\' && ptr[1] != '\0')
+        {
+            ptr++;
+            switch (*ptr)
+            {
+            case 'n':
+                fputc('\n', output);
+                break;
+            case 't':
+                fputc('\t', output);
+                break;
+            case '\\':
+                fputc('\\', output);
+                break;
+            default:
+                fputc('\\', output);
+                fputc(*ptr, output);
+                break;
+            }
+            continue;
+        }
+
+        if (*ptr != '%' || ptr[1] == '\0')
+        {
+            fputc(*ptr, output);
+            continue;
+        }
+
+        ptr++;
+        switch (*ptr)
+        {
+        case '%':
+            fputc('%', output);
+            break;
+        case 'e':
+            fprintf(output, "%.6f", real);
+            break;
+        case 'E':
+        {
+            long seconds = measurement->real.tv_sec;
+            long centiseconds = measurement->real.tv_nsec / 10000000;
+            if (seconds >= 3600)
+            {
+                fprintf(output, "%ld:%02ld:%02ld", seconds / 3600, seconds % 3600 / 60, seconds % 60);
+            }
+            else
+            {
+                fprintf(output, "%ld:%02ld.%02ld", seconds / 60, seconds % 60, centiseconds);
+            }
+            break;
+        }
+        case 'U':
+            fprintf(output, "%.6f", user);
+            break;
+        case 'S':
+            fprintf(output, "%.6f", sys);
+            break;
+        case 'P':
+            if (real > 0)
+            {
+                fprintf(output, "%.0f%%", (user + sys) * 100 / real);
+            }
+            else
+            {
+                fputs("?%", output);
+            }
+            break;
+        case 'M':
+            // in kilobytes on Linux
+            fprintf(output, "%ld", usage->ru_maxrss);
+            break;
+        case 'R':
+            fprintf(output, "%ld", usage->ru_minflt);
+            break;
+        case 'F':
+            fprintf(output, "%ld", usage->ru_majflt);
+            break;
+        case 'w':
+            fprintf(output, "%ld", usage->ru_nvcsw);
+            break;
+        case 'c':
+            fprintf(output, "%ld", usage->ru_nivcsw);
+            break;
+        case 'I':
+            fprintf(output, "%ld", usage->ru_inblock);
+            break;
+        case 'O':
+            fprintf(output, "%ld", usage->ru_oublock);
+            break;
+        case 'W':
+            fprintf(output, "%ld", usage->ru_nswap);
+            break;
+        case 'k':
+            fprintf(output, "%ld", usage->ru_nsignals);
+            break;
+        case 'r':
+            fprintf(output, "%ld", usage->ru_msgrcv);
+            break;
+        case 's':
+            fprintf(output, "%ld", usage->ru_msgsnd);
+            break;
+        case 'x':
+            fprintf(output, "%d", get_exit_code(measurement->status));
+            break;
+        case 'Z':
+            fprintf(output, "%ld", sysconf(_SC_PAGESIZE));
+            break;
+        case 'C':
+            for (char **arg = argv; *arg != NULL; arg++)
+            {
+                fprintf(output, (arg == argv) ? "%s" : " %s", *arg);
+            }
+            break;
+        default:
+            // unknown, print as it is
+            fputc('?', output);
+            fputc(*ptr, output);
+            break;
+        }
     }
-    else
+
+    fputc('\n', output);
+}
+
+/**
+ * @brief Parse the number of runs, the text must be a decimal number.
+ *
+ * @param text
+ * @param minimum
+ * @param value
+ * @return bool
+ */
+bool parse_count(const char *text, int minimum, int *value)
+{
+    char *end;
+    errno = 0;
+    long number = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno != 0 || number < minimum || number > INT_MAX)
     {
-        // Parent process
+        return false;
+    }
 
-        // Wait for child process to exit
-        int status;
-        waitpid(pid, &status, WUNTRACED);
+    *value = number;
+    return true;
+}
 
-        // the child process usage were appended to the parent process.
-        // check _The Linux Programming Interface_ sesstion 26.1.1
+/**
+ * @brief Drop the clean page cache, dentries and inodes.
+ *
+ * @return bool
+ */
+bool drop_caches(void)
+{
+    // the dirty pages can not be dropped, write them first
+    sync();
 
-        struct rusage usage;
-        if (getrusage(RUSAGE_CHILDREN, &usage) == -1)
+    int fd = open(DROP_CACHES_FILEPATH, O_WRONLY);
+    if (fd == -1 || write(fd, "3\n", 2) != 2)
+    {
+        fprintf(stderr, "time: %s: %s\n", DROP_CACHES_FILEPATH, strerror(errno));
+        if (fd != -1)
         {
-            perror("getrusage");
-            exit(EXIT_FAILURE);
+            close(fd);
         }
+        return false;
+    }
 
-        // - real time: from `program start` to `program exit`
-        // - user_time: program in userspace comsuming
-        // - system_time: program in kernel comsuming
-        //
-        // real time = user time + system time + I/O waiting + other etc.
+    close(fd);
+    return true;
+}
 
-        struct timeval end;
-        gettimeofday(&end, NULL);
+int compare_doubles(const void *left, const void *right)
+{
+    double a = *(const double *)left;
+    double b = *(const double *)right;
+    return (a > b) - (a < b);
+}
 
-        long int real_time_us = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+/**
+ * @brief Get the percentile by the linear interpolation between the
+ * closest ranks.
+ *
+ * @param sorted
+ * @param count
+ * @param percent 0 to 100
+ * @return double
+ */
+double get_percentile(const double *sorted, int count, double percent)
+{
+    double position = (count - 1) * percent / 100;
+    int lower = (int)position;
+    if (lower + 1 >= count)
+    {
+        return sorted[count - 1];
+    }
+    return sorted[lower] + (sorted[lower + 1] - sorted[lower]) * (position - lower);
+}
+
+/**
+ * @brief Compute the statistics of the samples.
+ *
+ * @return bool false if failed to allocate memory
+ */
+bool compute_statistics(const double *samples, int count, struct Statistics *stats)
+{
+    double *sorted = malloc(count * sizeof(double));
+    if (sorted == NULL)
+    {
+        perror("malloc");
+        return false;
+    }
+
+    memcpy(sorted, samples, count * sizeof(double));
+    qsort(sorted, count, sizeof(double), compare_doubles);
+
+    double sum = 0;
+    for (int idx = 0; idx < count; idx++)
+    {
+        sum += sorted[idx];
+    }
+
+    stats->min = sorted[0];
+    stats->max = sorted[count - 1];
+    stats->mean = sum / count;
+    stats->median = get_percentile(sorted, count, 50);
+    stats->p95 = get_percentile(sorted, count, 95);
+    stats->p99 = get_percentile(sorted, count, 99);
+
+    double squares = 0;
+    for (int idx = 0; idx < count; idx++)
+    {
+        double difference = sorted[idx] - stats->mean;
+        squares += difference * difference;
+    }
+    stats->stddev = (count > 1) ? sqrt(squares / (count - 1)) : 0;
+
+    free(sorted);
+    return true;
+}
+
+/**
+ * @brief Print the text escaped for a JSON string, without the quotes.
+ */
+void print_json_escaped(FILE *output, const char *text)
+{
+    for (const char *ptr = text; *ptr != '\0'; ptr++)
+    {
+        if (*ptr == '"' || *ptr == '\\')
+        {
+            fputc('\\', output);
+            fputc(*ptr, output);
+        }
+        else if ((unsigned char)*ptr < 0x20)
+        {
+            fprintf(output, "\\u%04x", *ptr);
+        }
+        else
+        {
+            fputc(*ptr, output);
+        }
+    }
+}
+
+/**
+ * @brief Print the statistics of the real, user and sys time.
+ *
+ * @param output
+ * @param report_format
+ * @param samples the real, user and sys time of each run, i.e. 3 * runs
+ * @param runs
+ * @param warmup
+ * @param argv the command and its arguments
+ * @return bool false if failed to allocate memory
+ */
+bool print_statistics(FILE *output, enum ReportFormat report_format, const double *samples,
+                      int runs, int warmup, char **argv)
+{
+    const char *NAMES[] = {"real", "user", "sys"};
+    struct Statistics stats[3];
+    for (int idx = 0; idx < 3; idx++)
+    {
+        if (!compute_statistics(samples + idx * runs, runs, &stats[idx]))
+        {
+            return false;
+        }
+    }
+
+    if (report_format == REPORT_CSV)
+    {
+        fputs("time,min,max,mean,median,p95,p99,stddev\n", output);
+        for (int idx = 0; idx < 3; idx++)
+        {
+            fprintf(output, "%s,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n", NAMES[idx],
+                    stats[idx].min, stats[idx].max, stats[idx].mean, stats[idx].median,
+                    stats[idx].p95, stats[idx].p99, stats[idx].stddev);
+        }
+        return true;
+    }
+
+    if (report_format == REPORT_JSON)
+    {
+        fputs("{\n  \"command\": \"", output);
+
+        // the command line is joined by spaces as `%C` does
+        for (char **arg = argv; *arg != NULL; arg++)
+        {
+            if (arg != argv)
+            {
+                fputc(' ', output);
+            }
+            print_json_escaped(output, *arg);
+        }
+        fputc('"', output);
+
+        fprintf(output, ",\n  \"runs\": %d,\n  \"warmup\": %d", runs, warmup);
+        for (int idx = 0; idx < 3; idx++)
+        {
+            fprintf(output,
+                    ",\n  \"%s\": {\"min\": %.6f, \"max\": %.6f, \"mean\": %.6f, \"median\": %.6f, "
+                    "\"p95\": %.6f, \"p99\": %.6f, \"stddev\": %.6f, \"samples\": [",
+                    NAMES[idx], stats[idx].min, stats[idx].max, stats[idx].mean, stats[idx].median,
+                    stats[idx].p95, stats[idx].p99, stats[idx].stddev);
+            for (int run = 0; run < runs; run++)
+            {
+                fprintf(output, (run == 0) ? "%.6f" : ", %.6f", samples[idx * runs + run]);
+            }
+            fputs("]}", output);
+        }
+        fputs("\n}\n", output);
+        return true;
+    }
 
-        printf("\n");
-        printf("real    %ld.%06ld seconds\n", real_time_us / 1000000, real_time_us % 1000000);
-        printf("user    %ld.%06ld seconds\n", usage.ru_utime.tv_sec, usage.ru_utime.tv_usec);
-        printf("sys     %ld.%06ld seconds\n", usage.ru_stime.tv_sec, usage.ru_stime.tv_usec);
+    fprintf(output, "runs    %d, warmup %d, in seconds\n", runs, warmup);
+    fprintf(output, "%-8s%12s%12s%12s%12s%12s%12s%12s\n",
+            "", "min", "max", "mean", "median", "p95", "p99", "stddev");
+    for (int idx = 0; idx < 3; idx++)
+    {
+        fprintf(output, "%-8s%12.6f%12.6f%12.6f%12.6f%12.6f%12.6f%12.6f\n", NAMES[idx],
+                stats[idx].min, stats[idx].max, stats[idx].mean, stats[idx].median,
+                stats[idx].p95, stats[idx].p99, stats[idx].stddev);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Run the command repeatedly, and print the statistics.
+ *
+ * @return int the exit status
+ */
+int run_benchmark(char **argv, int runs, int warmup, enum ReportFormat report_format, FILE *output)
+{
+    // the real, user and sys time of each run
+    double *samples = malloc(3 * (size_t)runs * sizeof(double));
+    if (samples == NULL)
+    {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    for (int idx = 0; idx < warmup + runs; idx++)
+    {
+        struct Measurement measurement;
+        if ((is_drop_caches && !drop_caches()) || !run_command(argv, &measurement))
+        {
+            free(samples);
+            return EXIT_FAILURE;
+        }
+
+        if (measurement.status != 0)
+        {
+            if (WIFSIGNALED(measurement.status))
+            {
+                fprintf(stderr, "time: run %d: Command terminated by signal %d\n",
+                        idx + 1, WTERMSIG(measurement.status));
+            }
+            else
+            {
+                fprintf(stderr, "time: run %d: Command exited with non-zero status %d\n",
+                        idx + 1, WEXITSTATUS(measurement.status));
+            }
+            free(samples);
+            return get_exit_code(measurement.status);
+        }
+
+        if (idx >= warmup)
+        {
+            int run = idx - warmup;
+            samples[run] = get_seconds(&measurement.real);
+            samples[runs + run] = get_timeval_seconds(&measurement.usage.ru_utime);
+            samples[2 * runs + run] = get_timeval_seconds(&measurement.usage.ru_stime);
+        }
+    }
+
+    bool is_printed = print_statistics(output, report_format, samples, runs, warmup, argv);
+    free(samples);
+    return is_printed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+    // usage:
+    //
+    // time command args...
+    // time -p command args...
+    // time -f "%e %M" -o /tmp/usage.txt -a command args...
+    // time -n 10 --warmup 2 --drop-caches command args...
+    // time -n 10 -c 1 --json command args...
+
+    const char *format = DEFAULT_FORMAT;
+    const char *output_path = NULL;
+    bool is_default_format = true;
+    bool is_append = false;
+    int runs = 0; // 0 for the single run
+    int warmup = 0;
+    enum ReportFormat report_format = REPORT_TEXT;
+
+    static struct option long_options[] = {
+        {"runs", required_argument, NULL, 'n'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"drop-caches", no_argument, NULL, 'd'},
+        {"cpu", required_argument, NULL, 'c'},
+        {"csv", no_argument, NULL, OPTION_CSV},
+        {"json", no_argument, NULL, OPTION_JSON},
+        {"events", no_argument, NULL, 'e'},
+        {NULL, 0, NULL, 0}};
+
+    // '+': stop at the first non-option, i.e. the command
+    int opt;
+    while ((opt = getopt_long(argc, argv, "+pf:o:an:w:dc:e", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            format = PORTABLE_FORMAT;
+            is_default_format = false;
+            break;
+        case 'f':
+            format = optarg;
+            is_default_format = false;
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'a':
+            is_append = true;
+            break;
+        case 'n':
+            if (!parse_count(optarg, 1, &runs))
+            {
+                fprintf(stderr, "time: invalid number of runs: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            if (!parse_count(optarg, 0, &warmup))
+            {
+                fprintf(stderr, "time: invalid number of warmup runs: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'd':
+            is_drop_caches = true;
+            break;
+        case 'c':
+            if (!parse_cpu_list(optarg, &child_cpus))
+            {
+                fprintf(stderr, "time: invalid CPU list: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            is_pinned = true;
+            break;
+        case 'e':
+            is_counting = true;
+            break;
+        case OPTION_CSV:
+            report_format = REPORT_CSV;
+            break;
+        case OPTION_JSON:
+            report_format = REPORT_JSON;
+            break;
+        default:
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    bool is_benchmark = (runs > 0 || warmup > 0 || report_format != REPORT_TEXT);
+
+    // the format and the counters apply to a single run
+    if (optind == argc || (is_benchmark && (!is_default_format || is_counting)))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    // argv
+    //     0    1       2    3        N
+    //     time program arg1 arg2 ... NULL
+    //
+    // execvp argv
+    //     0       1    2        N
+    //     program arg1 arg2 ... NULL
+    char **child_argv = argv + optind;
+
+    // the report is written to stderr, so it is not mixed with the output
+    // of the command.
+    FILE *output = stderr;
+    if (output_path != NULL)
+    {
+        output = fopen(output_path, is_append ? "a" : "w");
+        if (output == NULL)
+        {
+            fprintf(stderr, "time: %s: %s\n", output_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Ctrl+C and Ctrl+\ terminate the command, and the report is still printed
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+
+    if (is_benchmark)
+    {
+        int exit_code = run_benchmark(child_argv, runs > 0 ? runs : 1, warmup, report_format, output);
+        if (output != stderr)
+        {
+            fclose(output);
+        }
+        return exit_code;
+    }
+
+    struct Measurement measurement;
+    if ((is_drop_caches && !drop_caches()) || !run_command(child_argv, &measurement))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (is_default_format)
+    {
+        if (WIFSIGNALED(measurement.status))
+        {
+            fprintf(output, "Command terminated by signal %d\n", WTERMSIG(measurement.status));
+        }
+        else if (WEXITSTATUS(measurement.status) != 0)
+        {
+            fprintf(output, "Command exited with non-zero status %d\n", WEXITSTATUS(measurement.status));
+        }
+    }
+
+    print_report(output, format, &measurement, child_argv);
+
+    if (is_counting)
+    {
+        print_counters(output, get_seconds(&measurement.real));
+    }
+
+    if (output != stderr)
+    {
+        fclose(output);
     }
 
-    exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+    return get_exit_code(measurement.status);
+}
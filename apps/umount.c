@@ -8,41 +8,230 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+#include <unistd.h>
 #include <sys/mount.h>
 
-int unmount_directory(char *directory)
+#include "lib/mountinfo.h"
+
+// the pseudo filesystems which are kept by `umount -a`
+const char *KEPT_FSTYPES[] = {
+    "proc",
+    "sysfs",
+    "devtmpfs",
+    "devpts",
+    "cgroup",
+    "cgroup2",
+    NULL};
+
+struct UnmountResult
 {
-    if (umount(directory) == 0)
+    int unmounted;
+    int failed;
+};
+
+int umount_flags = 0;
+bool is_verbose = false;
+
+void unmount_one(const char *mount_point, struct UnmountResult *result)
+{
+    if (umount2(mount_point, umount_flags) == 0)
     {
-        printf("Unmount %s successfully.\n", directory);
-        return EXIT_SUCCESS;
+        if (is_verbose)
+        {
+            printf("Unmount %s successfully.\n", mount_point);
+        }
+        result->unmounted++;
     }
     else
     {
-        perror("umount");
-        return EXIT_FAILURE;
+        fprintf(stderr, "umount: %s: %s\n", mount_point, strerror(errno));
+        result->failed++;
+    }
+}
+
+bool is_kept_fstype(const char *fstype)
+{
+    for (const char **item = KEPT_FSTYPES; *item != NULL; item++)
+    {
+        if (strcmp(*item, fstype) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Unmount the directory and all mounts under it, in the reverse
+ * mount order, so that the children are unmounted before their parents.
+ *
+ * @param table
+ * @param directory
+ * @param result
+ */
+void unmount_recursive(const struct MountTable *table,
+                       const char *directory,
+                       struct UnmountResult *result)
+{
+    // the mount points in `mountinfo` are the canonical paths
+    char path[PATH_MAX];
+    if (realpath(directory, path) == NULL)
+    {
+        fprintf(stderr, "umount: %s: %s\n", directory, strerror(errno));
+        result->failed++;
+        return;
+    }
+
+    if (find_mount(table, path) == -1)
+    {
+        fprintf(stderr, "umount: %s: not mounted\n", directory);
+        result->failed++;
+        return;
+    }
+
+    for (int idx = table->count - 1; idx >= 0; idx--)
+    {
+        const char *mount_point = table->entries[idx].mount_point;
+        if (is_path_under(path, mount_point))
+        {
+            unmount_one(mount_point, result);
+        }
+    }
+}
+
+/**
+ * @brief Unmount all filesystems except the root and the pseudo filesystems
+ * (check `KEPT_FSTYPES`), in the reverse mount order.
+ *
+ * @param table
+ * @param result
+ */
+void unmount_all(const struct MountTable *table, struct UnmountResult *result)
+{
+    for (int idx = table->count - 1; idx >= 0; idx--)
+    {
+        const struct MountEntry *entry = &table->entries[idx];
+        if (strcmp(entry->mount_point, "/") == 0 || is_kept_fstype(entry->fstype))
+        {
+            continue;
+        }
+
+        unmount_one(entry->mount_point, result);
     }
 }
 
 void print_usage(void)
 {
-    fputs("Usage:\n", stderr);
-    fputs("    umount directory\n", stderr);
-    fputs("e.g.\n", stderr);
-    fputs("    umount /var/tmp\n", stderr);
+    char *text =
+        "Usage:\n"
+        "    umount [-R] [-l] [-f] [-v] directory...\n"
+        "    umount -a [-l] [-f] [-v]\n"
+        "\n"
+        "-R    unmount the directory and all mounts under it\n"
+        "-a    unmount all filesystems except the root, proc, sysfs, devtmpfs,\n"
+        "      devpts and cgroup\n"
+        "-l    detach the filesystem now, clean up when it is not busy (lazy)\n"
+        "-f    force unmount, e.g. an unreachable NFS\n"
+        "-v    print every unmounted filesystem instead of the summary\n"
+        "\n"
+        "e.g.\n"
+        "    umount /var/tmp\n"
+        "    umount -R -l /mnt/scratch\n";
+
+    fputs(text, stderr);
 }
 
 int main(int argc, char **argv)
 {
-    if (argc == 2)
+    // usage:
+    //
+    // umount directory
+    // umount -R -l directory
+    // umount -a
+
+    bool is_recursive = false;
+    bool is_all = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "Ralfv")) != -1)
     {
-        return unmount_directory(argv[1]);
+        switch (opt)
+        {
+        case 'R':
+            is_recursive = true;
+            break;
+        case 'a':
+            is_all = true;
+            break;
+        case 'l':
+            umount_flags |= MNT_DETACH;
+            break;
+        case 'f':
+            umount_flags |= MNT_FORCE;
+            break;
+        case 'v':
+            is_verbose = true;
+            break;
+        default:
+            print_usage();
+            return EXIT_FAILURE;
+        }
     }
-    else
+
+    if ((is_all && optind != argc) || (!is_all && optind == argc))
     {
         print_usage();
         return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+
+    struct UnmountResult result = {0};
+
+    if (is_all || is_recursive)
+    {
+        // the mount table is read only once for all directories
+        struct MountTable table;
+        if (!read_mountinfo(&table))
+        {
+            perror("umount: " MOUNTINFO_FILEPATH);
+            return EXIT_FAILURE;
+        }
+
+        if (is_all)
+        {
+            unmount_all(&table, &result);
+        }
+        else
+        {
+            for (int idx = optind; idx < argc; idx++)
+            {
+                unmount_recursive(&table, argv[idx], &result);
+            }
+        }
+
+        free_mountinfo(&table);
+    }
+    else
+    {
+        for (int idx = optind; idx < argc; idx++)
+        {
+            unmount_one(argv[idx], &result);
+        }
+    }
+
+    if (!is_verbose)
+    {
+        printf("Unmounted %d filesystem%s", result.unmounted, result.unmounted == 1 ? "" : "s");
+        if (result.failed > 0)
+        {
+            printf(", %d failed", result.failed);
+        }
+        printf(".\n");
+    }
+
+    return (result.failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,152 @@
+#!/bin/bash
+
+# boot the system by `start-qemu-initramfs.sh` several times, and report the
+# boot time.
+#
+# the kernel argument `initbench=1` makes `init` print the boot steps to the
+# serial console and power off the system, check the comments in
+# `apps/init.c`. the times are since the kernel started (CLOCK_BOOTTIME), so
+# the startup of QEMU and the firmware are not included.
+#
+# the steps:
+# - init:    the time to start `init`, i.e. the kernel and the initramfs unpacking.
+# - rc-done: the time to start all services except the interactive shell.
+# - shell:   the time to execute the interactive shell.
+#
+# the result is printed in JSON, e.g.
+#
+#     {
+#       "runs": 10,
+#       "init": {"min": 0.812000, "median": 0.830000, "p95": 0.901000},
+#       "rc-done": {"min": 0.931000, "median": 0.944000, "p95": 0.998000},
+#       "shell": {"min": 0.950000, "median": 0.962000, "p95": 1.020000}
+#     }
+#
+# save a result as the baseline, and check the later builds against it, the
+# script exits with status 1 if the median of any step is slower than the
+# baseline by more than the threshold (percent), and 2 if a boot failed.
+#
+# e.g.
+#
+#     ./bench-qemu-initramfs.sh -n 20 -o baseline.json
+#     ./bench-qemu-initramfs.sh -n 20 -b baseline.json -t 5
+
+set -e
+
+RUNS=10
+OUTPUT=
+BASELINE=
+THRESHOLD=10
+LOG_DIR=bench-logs
+TIMEOUT=300
+STEPS="init rc-done shell"
+
+print_usage() {
+    cat >&2 << "EOF_USAGE"
+Usage:
+    bench-qemu-initramfs.sh [-n runs] [-o output.json] [-b baseline.json] [-t percent]
+                            [-l log_dir] [-w timeout_seconds]
+
+-n    the number of boots, default 10
+-o    write the result into the file, default stdout
+-b    compare the medians with the baseline (the output of a previous run)
+-t    the threshold of the regression in percent, default 10
+-l    the directory of the serial logs, default bench-logs
+-w    the timeout of each boot in seconds, default 300
+
+the environment variables of `start-qemu-initramfs.sh` (e.g. INITRD and
+KERNEL_ARGS) are passed through.
+EOF_USAGE
+}
+
+while getopts "n:o:b:t:l:w:" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        o) OUTPUT=$OPTARG ;;
+        b) BASELINE=$OPTARG ;;
+        t) THRESHOLD=$OPTARG ;;
+        l) LOG_DIR=$OPTARG ;;
+        w) TIMEOUT=$OPTARG ;;
+        *) print_usage; exit 2 ;;
+    esac
+done
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+mkdir -p "$LOG_DIR"
+
+# the times of each step, one line per run
+declare -A TIMES
+
+for ((run = 1; run <= RUNS; run++)); do
+    LOG="$LOG_DIR/run-$run.log"
+
+    # the serial console is the stdio of QEMU (`-nographic`), the monitor
+    # is disabled so the input does not matter.
+    if ! KERNEL_ARGS="$KERNEL_ARGS initbench=1" timeout "$TIMEOUT" \
+        "$SCRIPT_DIR/start-qemu-initramfs.sh" -monitor none < /dev/null > "$LOG" 2>&1; then
+        echo "run $run: QEMU failed or timed out, check $LOG" >&2
+        exit 2
+    fi
+
+    # the console may use "\r\n"
+    for step in $STEPS; do
+        value=$(tr -d '\r' < "$LOG" | sed -n "s/^initbench: $step \([0-9.]*\)$/\1/p" | head -n 1)
+        if [ -z "$value" ]; then
+            echo "run $run: no \"$step\" marker, check $LOG" >&2
+            exit 2
+        fi
+        TIMES[$step]+="$value"$'\n'
+    done
+
+    echo "run $run: $(tr -d '\r' < "$LOG" | sed -n 's/^initbench: //p' | tr '\n' ' ')" >&2
+done
+
+# print "min median p95" of the values (one per line), p95 is the nearest rank
+get_stats() {
+    sort -n | awk '
+        { values[NR] = $1 }
+        END {
+            median = (NR % 2 == 1) ? values[(NR + 1) / 2] : (values[NR / 2] + values[NR / 2 + 1]) / 2
+            rank = int(NR * 0.95 + 0.999999)
+            printf "%.6f %.6f %.6f\n", values[1], median, values[rank]
+        }'
+}
+
+RESULT="{"$'\n'"  \"runs\": $RUNS"
+for step in $STEPS; do
+    read -r min median p95 <<< "$(printf "%s" "${TIMES[$step]}" | get_stats)"
+    RESULT+=","$'\n'"  \"$step\": {\"min\": $min, \"median\": $median, \"p95\": $p95}"
+    MEDIANS[${#MEDIANS[@]}]="$step $median"
+done
+RESULT+=$'\n'"}"
+
+if [ -n "$OUTPUT" ]; then
+    echo "$RESULT" > "$OUTPUT"
+else
+    echo "$RESULT"
+fi
+
+if [ -z "$BASELINE" ]; then
+    exit 0
+fi
+
+# each step is on its own line in the JSON, check the example above
+STATUS=0
+for item in "${MEDIANS[@]}"; do
+    read -r step median <<< "$item"
+    base=$(sed -n "s/.*\"$step\": {.*\"median\": \([0-9.]*\).*/\1/p" "$BASELINE")
+    if [ -z "$base" ]; then
+        echo "$step: not in the baseline $BASELINE" >&2
+        continue
+    fi
+
+    if awk -v now="$median" -v base="$base" -v threshold="$THRESHOLD" \
+        'BEGIN { exit !(now > base * (1 + threshold / 100)) }'; then
+        echo "$step: regression, median $median s, baseline $base s (threshold $THRESHOLD%)" >&2
+        STATUS=1
+    else
+        echo "$step: ok, median $median s, baseline $base s" >&2
+    fi
+done
+
+exit $STATUS
@@ -0,0 +1,59 @@
+#!/bin/bash
+
+# build the applets for the host, and check them against the known results,
+# it catches the regressions of the fast paths (e.g. the SWAR kernels) which
+# depend on the size and the density of the input.
+#
+# e.g.
+#
+#     ./check-applets.sh
+
+set -e
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+gcc -O2 -Wall -pthread -o "$WORK_DIR/applets" \
+    "$SCRIPT_DIR/apps/applets.c" \
+    "$SCRIPT_DIR/apps/lib/checksum.c" \
+    "$SCRIPT_DIR/apps/lib/ioengine.c" \
+    "$SCRIPT_DIR/apps/lib/schedutil.c"
+
+for name in wc grep; do
+    ln -s applets "$WORK_DIR/$name"
+done
+
+FAILURES=0
+
+# check NAME EXPECTED ACTUAL
+check() {
+    if [ "$2" = "$3" ]; then
+        echo "ok      $1"
+    else
+        echo "FAILED  $1: expected \"$2\", got \"$3\""
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+cd "$WORK_DIR"
+
+# the newline-dense input is longer than the SWAR counters can hold
+# without being summed (8 KiB)
+yes '' | head -c 1000000 > newlines.txt
+check "wc -l file" "1000000 newlines.txt" "$(./wc -l newlines.txt)"
+check "wc -l pipe" "1000000" "$(cat newlines.txt | ./wc -l)"
+check "wc -c" "1000000 newlines.txt" "$(./wc -c newlines.txt)"
+
+# the line numbers are counted across the blocks of a pipe
+seq 1 200000 > numbers.txt
+check "grep -n file" "199999:199999" "$(./grep -n 199999 numbers.txt)"
+check "grep -n pipe" "199999:199999" "$(cat numbers.txt | ./grep -n 199999)"
+check "grep -n last" "200000:200000" "$(cat numbers.txt | ./grep -n 200000)"
+check "grep -vn pipe" "200000:200000" "$(cat numbers.txt | ./grep -vn '^1' | tail -n 1)"
+check "grep -c pipe" "200000" "$(cat numbers.txt | ./grep -c '')"
+
+if [ $FAILURES -ne 0 ]; then
+    echo "$FAILURES check(s) failed"
+    exit 1
+fi
@@ -1,18 +1,36 @@
 #!/bin/bash
 set -ex
 
+# the compression of the initramfs: zstd, lz4, xz, gzip or none, check the
+# comments in `tools/mkinitramfs.c`, the kernel must support it.
+COMPRESSION=${COMPRESSION:-zstd}
+
+case $COMPRESSION in
+    zstd) INITRD=${INITRD:-initramfs.cpio.zst} ;;
+    lz4) INITRD=${INITRD:-initramfs.cpio.lz4} ;;
+    xz) INITRD=${INITRD:-initramfs.cpio.xz} ;;
+    gzip) INITRD=${INITRD:-initramfs.cpio.gz} ;;
+    none) INITRD=${INITRD:-initramfs.cpio} ;;
+    *) echo "unsupported compression: $COMPRESSION" >&2; exit 1 ;;
+esac
+
+# the tools run on the host
+pushd tools
+gcc -O2 -Wall -o mkinitramfs mkinitramfs.c
+popd
+
 pushd apps
-riscv64-linux-gnu-gcc -g -Wall -static -o init init.c
-riscv64-linux-gnu-gcc -g -Wall -static -o mount mount.c
-riscv64-linux-gnu-gcc -g -Wall -static -o umount umount.c
+riscv64-linux-gnu-gcc -g -Wall -static -o init init.c lib/schedutil.c lib/mountinfo.c
+riscv64-linux-gnu-gcc -g -Wall -static -pthread -o mount mount.c lib/mountinfo.c
+riscv64-linux-gnu-gcc -g -Wall -static -o umount umount.c lib/mountinfo.c
 riscv64-linux-gnu-gcc -g -Wall -static -o poweroff poweroff.c
 riscv64-linux-gnu-gcc -g -Wall -static -o sh sh.c
 riscv64-linux-gnu-gcc -g -Wall -static -o echo echo.c
 riscv64-linux-gnu-gcc -g -Wall -static -o pwd pwd.c
-riscv64-linux-gnu-gcc -g -Wall -static -o cat cat.c
-riscv64-linux-gnu-gcc -g -Wall -static -o ls ls.c
-riscv64-linux-gnu-gcc -g -Wall -static -o time time.c
-riscv64-linux-gnu-gcc -g -Wall -static -o applets applets.c
+riscv64-linux-gnu-gcc -g -Wall -static -o cat cat.c lib/ioengine.c
+riscv64-linux-gnu-gcc -g -Wall -static -pthread -o ls ls.c
+riscv64-linux-gnu-gcc -g -Wall -static -o time time.c lib/schedutil.c -lm
+riscv64-linux-gnu-gcc -g -Wall -static -pthread -o applets applets.c lib/checksum.c lib/ioengine.c lib/schedutil.c
 popd
 
 mkdir -p initramfs
@@ -34,28 +52,58 @@ mkdir -p dev
 
 echo "Hello, My own Linux system!" > root/hello.txt
 
-cat << "EOF" > etc/rc
-#!/bin/sh
-mount -t proc proc /proc
-mount -t sysfs sysfs /sys
+# the filesystems mounted by `mount -a`, see the comments in `apps/mount.c`.
+# the tmpfs are sized explicitly instead of the default half of the RAM,
+# the access times are not updated, and the large files on `/tmp` are
+# backed by the transparent huge pages (requires CONFIG_TRANSPARENT_HUGEPAGE,
+# remove the `huge=` option if the kernel does not support it).
+cat << "EOF" > etc/fstab
+# device  mountpoint  type      options
+proc      /proc       proc      nosuid,nodev,noexec
+sysfs     /sys        sysfs     nosuid,nodev,noexec
+tmpfs     /run        tmpfs     nosuid,nodev,noexec,noatime,mode=0755,size=16M
+tmpfs     /tmp        tmpfs     nosuid,nodev,noatime,mode=1777,size=50%,huge=within_size
+devtmpfs  /dev        devtmpfs  nosuid
+EOF
 
 # optional
-mount -t tmpfs tmpfs /run
-mount -t tmpfs tmpfs /tmp
-mount -t devtmpfs devtmpfs /dev
+# the large and rarely used files in `../payload` are packed into a compressed
+# read-only image, which is mounted on `/opt` through a loop device by `mount -a`.
+# the kernel decompresses only the blocks being accessed instead of the whole
+# payload at boot (requires CONFIG_BLK_DEV_LOOP and CONFIG_SQUASHFS_ZSTD).
+if [ -d ../payload ] && command -v mksquashfs > /dev/null; then
+    mkdir -p opt
+    mksquashfs ../payload payload.sqfs -comp zstd -all-root -noappend -quiet
+    echo "/payload.sqfs  /opt  squashfs  loop,nosuid,nodev" >> etc/fstab
+fi
 
-# start an interactive shell
-cd /root
-/bin/sh &
+# services started by init, see the comments in `apps/init.c`.
+# the filesystems are mounted concurrently by a single process.
+mkdir -p etc/init.d
+
+cat << "EOF" > etc/init.d/mount.svc
+exec=/sbin/mount -a
 EOF
 
-chmod +x etc/rc
+# start an interactive shell
+# the shell has more CPU time than the other services when the CPUs are busy.
+cat << "EOF" > etc/init.d/shell.svc
+type=simple
+interactive=yes
+restart=always
+after=mount
+cwd=/root
+cpu.weight=1000
+exec=/bin/sh
+EOF
 
 pushd sbin
 cp ../../apps/init init
 cp ../../apps/mount mount
 cp ../../apps/umount umount
 cp ../../apps/poweroff poweroff
+test -L reboot || ln -s poweroff reboot
+test -L halt || ln -s poweroff halt
 popd
 
 pushd bin
@@ -63,6 +111,7 @@ cp ../../apps/sh sh
 cp ../../apps/echo echo
 cp ../../apps/pwd pwd
 cp ../../apps/ls ls
+test -L du || ln -s ls du
 cp ../../apps/cat cat
 popd
 
@@ -72,10 +121,24 @@ cp ../../../apps/applets applets
 test -L tee || ln -s applets tee
 test -L tr || ln -s applets tr
 test -L uname || ln -s applets uname
+test -L bootchart || ln -s applets bootchart
+test -L cgstat || ln -s applets cgstat
+test -L taskset || ln -s applets taskset
+test -L chrt || ln -s applets chrt
+test -L ionice || ln -s applets ionice
+test -L wc || ln -s applets wc
+test -L grep || ln -s applets grep
+test -L sort || ln -s applets sort
+test -L xargs || ln -s applets xargs
+test -L dd || ln -s applets dd
+test -L sha256sum || ln -s applets sha256sum
+test -L crc32c || ln -s applets crc32c
+test -L xxh64 || ln -s applets xxh64
 test -L poweroff || ln -s applets poweroff
 popd
 
-find . | \
-     cpio -o -v --format=newc | \
-     gzip > ../initramfs.cpio.gz
-popd
\ No newline at end of file
+popd
+
+# the archive is reproducible, i.e. the entries are sorted, the owners are
+# root and the times are fixed.
+./tools/mkinitramfs -c "$COMPRESSION" -o "$INITRD" initramfs
\ No newline at end of file
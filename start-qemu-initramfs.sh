@@ -1,8 +1,22 @@
 #!/bin/bash
-qemu-system-riscv64 \
+
+# the default files are in the directory of this script, so it can be
+# run from anywhere (e.g. by `bench-qemu-initramfs.sh`).
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+
+# the archive built by `make-initramfs-cpio.sh`, e.g.
+# `INITRD=initramfs.cpio.lz4 ./start-qemu-initramfs.sh`
+INITRD=${INITRD:-$SCRIPT_DIR/initramfs.cpio.zst}
+
+# the additional kernel arguments, e.g. `KERNEL_ARGS=initbench=1`, and the
+# arguments of this script are passed to QEMU.
+KERNEL_ARGS=${KERNEL_ARGS:-}
+
+exec qemu-system-riscv64 \
     -machine virt \
     -m 1G \
-    -kernel ./linux-6.2.10/arch/riscv/boot/Image \
-    -initrd ./initramfs.cpio.gz \
-    -append "root=/dev/ram rdinit=/sbin/init console=ttyS0" \
-    -nographic
\ No newline at end of file
+    -kernel "$SCRIPT_DIR/linux-6.2.10/arch/riscv/boot/Image" \
+    -initrd "$INITRD" \
+    -append "root=/dev/ram rdinit=/sbin/init console=ttyS0 $KERNEL_ARGS" \
+    -nographic \
+    "$@"
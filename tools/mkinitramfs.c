@@ -0,0 +1,645 @@
+/**
+ * Copyright (c) 2023 Hemashushu <hippospark@gmail.com>, All rights reserved.
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// build the initramfs archive (the "newc" cpio format) from a directory,
+// it runs on the host.
+//
+// unlike `find . | cpio -o --format=newc`, the archive is reproducible:
+//
+// - the entries are sorted by the path, so the parents are always before
+//   their children.
+// - the inode numbers are assigned in order, the owners are root, and the
+//   modification times are fixed (`-t`, or the environment variable
+//   `SOURCE_DATE_EPOCH`, or 0).
+// - the hard links share one inode, and the data is stored once, in the
+//   first link, the kernel links the others to it when unpacking.
+//
+// the archive is compressed by the external program, the kernel must be
+// built with the matching CONFIG_RD_* option:
+//
+// - zstd: good ratio, and fast to decompress (CONFIG_RD_ZSTD).
+// - lz4: the fastest to decompress, the legacy format is required (CONFIG_RD_LZ4).
+// - xz: the best ratio, slow to decompress (CONFIG_RD_XZ).
+// - gzip: the default of the most kernels (CONFIG_RD_GZIP).
+// - none: there is nothing to decompress, but the archive is the largest.
+//
+// which one is the fastest at boot depends on the read speed of the image
+// and the CPU, check the "Unpacking initramfs..." time in `dmesg`.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+
+#define CPIO_BLOCK_SIZE 512
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+struct Entry
+{
+    char *path; // relative to the root directory, e.g. "." and "bin/sh"
+    struct stat stat;
+    uint32_t ino;   // the inode number in the archive
+    uint32_t nlink; // the number of links in the archive
+    bool has_data;  // false for the hard links except the first one
+};
+
+struct EntryList
+{
+    struct Entry *entries;
+    size_t count;
+    size_t capacity;
+};
+
+struct Compressor
+{
+    const char *name;
+    const char *program;
+    const char *args[4];
+    const char *level_format; // e.g. "-%d"
+    int default_level;
+};
+
+const struct Compressor COMPRESSORS[] = {
+    {"zstd", "zstd", {"-q", "-c", NULL}, "-%d", 19},
+    // the kernel supports the legacy format only
+    {"lz4", "lz4", {"-q", "-l", "-c", NULL}, "-%d", 12},
+    // the kernel decoder supports the CRC32 check only, the dictionary
+    // is limited as `usr/Makefile` of the kernel does.
+    {"xz", "xz", {"-q", "-c", "--check=crc32", NULL}, "--lzma2=preset=%d,dict=1MiB", 6},
+    // do not store the name and the time
+    {"gzip", "gzip", {"-n", "-c", NULL}, "-%d", 9},
+    {"none", NULL, {NULL}, NULL, 0},
+};
+
+const char *program_name = "mkinitramfs";
+uint32_t fixed_mtime = 0;
+uint64_t unpacked_size = 0;
+
+bool add_entry(struct EntryList *list, const char *path, const struct stat *s)
+{
+    if (list->count == list->capacity)
+    {
+        size_t new_capacity = (list->capacity == 0) ? 256 : list->capacity * 2;
+        struct Entry *entries = realloc(list->entries, new_capacity * sizeof(struct Entry));
+        if (entries == NULL)
+        {
+            return false;
+        }
+        list->entries = entries;
+        list->capacity = new_capacity;
+    }
+
+    struct Entry *entry = &list->entries[list->count];
+    entry->path = strdup(path);
+    if (entry->path == NULL)
+    {
+        return false;
+    }
+
+    entry->stat = *s;
+    entry->ino = 0;
+    entry->nlink = S_ISDIR(s->st_mode) ? 2 : 1;
+    entry->has_data = true;
+    list->count++;
+    return true;
+}
+
+/**
+ * @brief Collect the entries of the directory recursively.
+ *
+ * @param list
+ * @param root the root directory
+ * @param path the path relative to the root
+ * @return bool
+ */
+bool collect_entries(struct EntryList *list, const char *root, const char *path)
+{
+    char dirpath[PATH_MAX];
+    snprintf(dirpath, sizeof(dirpath), "%s/%s", root, path);
+
+    DIR *dir = opendir(dirpath);
+    if (dir == NULL)
+    {
+        fprintf(stderr, "%s: %s: %s\n", program_name, dirpath, strerror(errno));
+        return false;
+    }
+
+    bool is_ok = true;
+    struct dirent *item;
+    while (is_ok && (item = readdir(dir)) != NULL)
+    {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char child[PATH_MAX];
+        if (strcmp(path, ".") == 0)
+        {
+            snprintf(child, sizeof(child), "%s", item->d_name);
+        }
+        else
+        {
+            snprintf(child, sizeof(child), "%s/%s", path, item->d_name);
+        }
+
+        struct stat s;
+        if (fstatat(dirfd(dir), item->d_name, &s, AT_SYMLINK_NOFOLLOW) != 0)
+        {
+            fprintf(stderr, "%s: %s/%s: %s\n", program_name, root, child, strerror(errno));
+            is_ok = false;
+            break;
+        }
+
+        if (!add_entry(list, child, &s))
+        {
+            perror("add_entry");
+            is_ok = false;
+            break;
+        }
+
+        if (S_ISDIR(s.st_mode))
+        {
+            is_ok = collect_entries(list, root, child);
+        }
+    }
+
+    closedir(dir);
+    return is_ok;
+}
+
+int compare_entry_paths(const void *left, const void *right)
+{
+    return strcmp(((const struct Entry *)left)->path, ((const struct Entry *)right)->path);
+}
+
+int compare_entry_inodes(const void *left, const void *right)
+{
+    const struct Entry *a = *(const struct Entry *const *)left;
+    const struct Entry *b = *(const struct Entry *const *)right;
+
+    if (a->stat.st_dev != b->stat.st_dev)
+    {
+        return (a->stat.st_dev < b->stat.st_dev) ? -1 : 1;
+    }
+
+    if (a->stat.st_ino != b->stat.st_ino)
+    {
+        return (a->stat.st_ino < b->stat.st_ino) ? -1 : 1;
+    }
+
+    // keep the path order, the pointers are in the sorted array
+    return (a < b) ? -1 : (a > b);
+}
+
+/**
+ * @brief Assign the inode numbers in the path order, the hard links (the
+ * regular files with the same device and inode) share the inode number of
+ * the first link, and only the first link stores the data.
+ *
+ * @param list the entries sorted by the path
+ * @return bool
+ */
+bool assign_inodes(struct EntryList *list)
+{
+    struct Entry **links = malloc(list->count * sizeof(struct Entry *));
+    if (links == NULL)
+    {
+        return false;
+    }
+
+    size_t link_count = 0;
+    for (size_t idx = 0; idx < list->count; idx++)
+    {
+        struct Entry *entry = &list->entries[idx];
+        entry->ino = idx + 1;
+
+        if (S_ISREG(entry->stat.st_mode) && entry->stat.st_nlink > 1)
+        {
+            links[link_count++] = entry;
+        }
+    }
+
+    qsort(links, link_count, sizeof(struct Entry *), compare_entry_inodes);
+
+    size_t start = 0;
+    while (start < link_count)
+    {
+        size_t end = start + 1;
+        while (end < link_count &&
+               links[end]->stat.st_dev == links[start]->stat.st_dev &&
+               links[end]->stat.st_ino == links[start]->stat.st_ino)
+        {
+            end++;
+        }
+
+        for (size_t idx = start; idx < end; idx++)
+        {
+            links[idx]->ino = links[start]->ino;
+            links[idx]->nlink = end - start;
+            links[idx]->has_data = (idx == start);
+        }
+
+        start = end;
+    }
+
+    free(links);
+    return true;
+}
+
+bool write_bytes(FILE *output, const void *data, size_t length)
+{
+    unpacked_size += length;
+    return fwrite(data, 1, length, output) == length;
+}
+
+bool write_padding(FILE *output, size_t alignment)
+{
+    static const char zeros[CPIO_BLOCK_SIZE] = {0};
+    size_t remainder = unpacked_size % alignment;
+    return (remainder == 0) || write_bytes(output, zeros, alignment - remainder);
+}
+
+/**
+ * @brief Write the header and the name of an entry, the data follows.
+ *
+ * @return bool
+ */
+bool write_header(FILE *output, const char *name, uint32_t ino, uint32_t mode, uint32_t nlink,
+                  uint32_t mtime, uint32_t file_size, dev_t rdev)
+{
+    size_t name_size = strlen(name) + 1; // includes the '\0'
+
+    // the "newc" format, all numbers are 8 hex digits, i.e.
+    // magic, ino, mode, uid, gid, nlink, mtime, filesize, devmajor, devminor,
+    // rdevmajor, rdevminor, namesize and check.
+    char header[128];
+    snprintf(header, sizeof(header),
+             "070701%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X",
+             ino, mode, 0, 0, nlink, mtime, file_size, 0, 0,
+             major(rdev), minor(rdev), (uint32_t)name_size, 0);
+
+    return write_bytes(output, header, 110) &&
+           write_bytes(output, name, name_size) &&
+           write_padding(output, 4);
+}
+
+bool write_file_data(FILE *output, const char *root, const struct Entry *entry)
+{
+    char filepath[PATH_MAX];
+    snprintf(filepath, sizeof(filepath), "%s/%s", root, entry->path);
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd == -1)
+    {
+        fprintf(stderr, "%s: %s: %s\n", program_name, filepath, strerror(errno));
+        return false;
+    }
+
+    static char buffer[COPY_BUFFER_SIZE];
+    off_t remaining = entry->stat.st_size;
+
+    while (remaining > 0)
+    {
+        ssize_t nread = read(fd, buffer, (remaining > COPY_BUFFER_SIZE) ? COPY_BUFFER_SIZE : remaining);
+        if (nread <= 0)
+        {
+            if (nread == -1 && errno == EINTR)
+            {
+                continue;
+            }
+
+            fprintf(stderr, "%s: %s: %s\n", program_name, filepath,
+                    nread == 0 ? "the file shrank while reading" : strerror(errno));
+            close(fd);
+            return false;
+        }
+
+        if (!write_bytes(output, buffer, nread))
+        {
+            close(fd);
+            return false;
+        }
+        remaining -= nread;
+    }
+
+    close(fd);
+    return true;
+}
+
+bool write_entry(FILE *output, const char *root, const struct Entry *entry)
+{
+    const struct stat *s = &entry->stat;
+    uint32_t mode = s->st_mode;
+    dev_t rdev = (S_ISCHR(mode) || S_ISBLK(mode)) ? s->st_rdev : 0;
+
+    if (S_ISLNK(mode))
+    {
+        char filepath[PATH_MAX];
+        snprintf(filepath, sizeof(filepath), "%s/%s", root, entry->path);
+
+        char target[PATH_MAX];
+        ssize_t length = readlink(filepath, target, sizeof(target));
+        if (length == -1)
+        {
+            fprintf(stderr, "%s: %s: %s\n", program_name, filepath, strerror(errno));
+            return false;
+        }
+
+        return write_header(output, entry->path, entry->ino, mode, 1, fixed_mtime, length, 0) &&
+               write_bytes(output, target, length) &&
+               write_padding(output, 4);
+    }
+
+    uint32_t file_size = (S_ISREG(mode) && entry->has_data) ? s->st_size : 0;
+    if (S_ISREG(mode) && s->st_size > UINT32_MAX)
+    {
+        fprintf(stderr, "%s: %s: the file is too large for cpio\n", program_name, entry->path);
+        return false;
+    }
+
+    if (!write_header(output, entry->path, entry->ino, mode, entry->nlink, fixed_mtime, file_size, rdev))
+    {
+        return false;
+    }
+
+    if (file_size > 0)
+    {
+        return write_file_data(output, root, entry) && write_padding(output, 4);
+    }
+
+    return true;
+}
+
+bool write_archive(FILE *output, const char *root, const struct EntryList *list)
+{
+    for (size_t idx = 0; idx < list->count; idx++)
+    {
+        if (!write_entry(output, root, &list->entries[idx]))
+        {
+            return false;
+        }
+    }
+
+    // the archive ends with the trailer, and it is padded to the block size
+    return write_header(output, "TRAILER!!!", 0, 0, 1, 0, 0, 0) &&
+           write_padding(output, CPIO_BLOCK_SIZE);
+}
+
+/**
+ * @brief Start the compressor, its output is the output file.
+ *
+ * @param compressor
+ * @param level -1 for the default
+ * @param output_fd
+ * @param pid the process id of the compressor
+ * @return int the fd to write the archive, or -1 if failed
+ */
+int start_compressor(const struct Compressor *compressor, int level, int output_fd, pid_t *pid)
+{
+    char level_arg[64];
+    snprintf(level_arg, sizeof(level_arg), compressor->level_format,
+             level >= 0 ? level : compressor->default_level);
+
+    const char *args[8];
+    int count = 0;
+    args[count++] = compressor->program;
+    for (int idx = 0; compressor->args[idx] != NULL; idx++)
+    {
+        args[count++] = compressor->args[idx];
+    }
+    args[count++] = level_arg;
+    args[count] = NULL;
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("pipe");
+        return -1;
+    }
+
+    *pid = fork();
+    if (*pid == -1)
+    {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (*pid == 0)
+    {
+        dup2(fds[0], STDIN_FILENO);
+        dup2(output_fd, STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        close(output_fd);
+
+        execvp(args[0], (char *const *)args);
+        fprintf(stderr, "%s: %s: %s\n", program_name, args[0], strerror(errno));
+        _exit(127);
+    }
+
+    close(fds[0]);
+    return fds[1];
+}
+
+void print_usage(void)
+{
+    char *text =
+        "Usage:\n"
+        "    mkinitramfs [-c zstd|lz4|xz|gzip|none] [-l level] [-t mtime] -o output directory\n"
+        "\n"
+        "-c    the compression, default zstd\n"
+        "-l    the compression level, default 19 (zstd), 12 (lz4), 6 (xz) and 9 (gzip)\n"
+        "-t    the modification time of all entries (seconds since the epoch),\n"
+        "      default $SOURCE_DATE_EPOCH or 0\n"
+        "-o    the output file\n"
+        "\n"
+        "e.g.\n"
+        "    mkinitramfs -c lz4 -o initramfs.cpio.lz4 initramfs\n"
+        "    mkinitramfs -c none -o initramfs.cpio initramfs\n";
+
+    fputs(text, stderr);
+}
+
+int main(int argc, char **argv)
+{
+    // usage:
+    //
+    // mkinitramfs -o initramfs.cpio.zst initramfs
+    // mkinitramfs -c gzip -l 6 -t 1680000000 -o initramfs.cpio.gz initramfs
+
+    const struct Compressor *compressor = &COMPRESSORS[0];
+    const char *output_path = NULL;
+    int level = -1;
+
+    const char *epoch = getenv("SOURCE_DATE_EPOCH");
+    if (epoch != NULL)
+    {
+        fixed_mtime = strtoul(epoch, NULL, 10);
+    }
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:l:t:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+        {
+            compressor = NULL;
+            for (size_t idx = 0; idx < sizeof(COMPRESSORS) / sizeof(COMPRESSORS[0]); idx++)
+            {
+                if (strcmp(COMPRESSORS[idx].name, optarg) == 0)
+                {
+                    compressor = &COMPRESSORS[idx];
+                }
+            }
+
+            if (compressor == NULL)
+            {
+                fprintf(stderr, "%s: unsupported compression: %s\n", program_name, optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        }
+        case 'l':
+            level = atoi(optarg);
+            break;
+        case 't':
+            fixed_mtime = strtoul(optarg, NULL, 10);
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        default:
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (output_path == NULL || optind != argc - 1)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    const char *root = argv[optind];
+
+    struct stat root_stat;
+    if (stat(root, &root_stat) != 0 || !S_ISDIR(root_stat.st_mode))
+    {
+        fprintf(stderr, "%s: %s: not a directory\n", program_name, root);
+        return EXIT_FAILURE;
+    }
+
+    // the root directory itself is the entry ".", as `find .` outputs
+    struct EntryList list = {0};
+    if (!add_entry(&list, ".", &root_stat) || !collect_entries(&list, root, "."))
+    {
+        return EXIT_FAILURE;
+    }
+
+    qsort(list.entries, list.count, sizeof(struct Entry), compare_entry_paths);
+
+    if (!assign_inodes(&list))
+    {
+        perror("assign_inodes");
+        return EXIT_FAILURE;
+    }
+
+    int output_fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd == -1)
+    {
+        fprintf(stderr, "%s: %s: %s\n", program_name, output_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // the failure of the compressor is reported by the exit status
+    signal(SIGPIPE, SIG_IGN);
+
+    // the output fd is kept open to get the packed size at last
+    pid_t pid = -1;
+    int archive_fd = dup(output_fd);
+    if (compressor->program != NULL)
+    {
+        close(archive_fd);
+        archive_fd = start_compressor(compressor, level, output_fd, &pid);
+        if (archive_fd == -1)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *output = fdopen(archive_fd, "w");
+    if (output == NULL)
+    {
+        perror("fdopen");
+        return EXIT_FAILURE;
+    }
+
+    bool is_ok = write_archive(output, root, &list);
+    if (fclose(output) != 0 && is_ok)
+    {
+        fprintf(stderr, "%s: failed to write the archive: %s\n", program_name, strerror(errno));
+        is_ok = false;
+    }
+
+    if (pid != -1)
+    {
+        int status;
+        while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+        {
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "%s: %s failed\n", program_name, compressor->program);
+            is_ok = false;
+        }
+    }
+
+    struct stat output_stat;
+    if (fstat(output_fd, &output_stat) != 0)
+    {
+        output_stat.st_size = 0;
+    }
+    close(output_fd);
+
+    if (!is_ok)
+    {
+        unlink(output_path);
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stderr, "%s: %zu entries, unpacked %llu bytes, packed %llu bytes (%.1f%%, %s)\n",
+            output_path, list.count,
+            (unsigned long long)unpacked_size, (unsigned long long)output_stat.st_size,
+            unpacked_size > 0 ? output_stat.st_size * 100.0 / unpacked_size : 0.0,
+            compressor->name);
+
+    for (size_t idx = 0; idx < list.count; idx++)
+    {
+        free(list.entries[idx].path);
+    }
+    free(list.entries);
+
+    return EXIT_SUCCESS;
+}